@@ -0,0 +1,25 @@
+QT       += core concurrent
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = BatchProcess
+
+# 命令行程序, 不需要显示器. 按解码 -> 处理 -> 编码三级流水线批量处理图像, 见batchpipeline.h
+SOURCES += \
+    batchpipeline.cpp \
+    main.cpp
+
+HEADERS += \
+    batchpipeline.h \
+    boundedqueue.h
+
+# Default rules for deployment.
+qnx: target.path = /tmp/$${TARGET}/bin
+else: unix:!android: target.path = /opt/$${TARGET}/bin
+!isEmpty(target.path): INSTALLS += target
+
+# VisionLibrary, GlobalTools和OpenCV
+include(../VisionLibrary/visionlibrary.pri)
+# 不需要界面: 不链接widgets. VisionLibrary用到QImage, 所以gui(不需要显示器)仍要链接
+QT -= widgets
@@ -0,0 +1,303 @@
+﻿#include "batchpipeline.h"
+#include <algorithm>
+#include <atomic>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QFuture>
+#include <QJsonArray>
+#include <QThreadPool>
+#include <QtConcurrent>
+#include "BatchProcess/boundedqueue.h"
+#include "CommonLibrary/GlobalTools/globaltools.h"
+#include "VisionLibrary/imagefile.h"
+#include "VisionLibrary/visionlibrary.h"
+
+constexpr double NS_PER_MS = 1e6;
+
+// 解析threshold[:kSize[:minDiff[:light|dark|both]]]的参数
+static bool parseThresholdArguments(const QStringList &fields, int &kSize, int &minDiff,
+                                    VisionLibrary::ThresholdPolarity &polarity)
+{
+    bool ok = true;
+    if (fields.size() > 1) {
+        kSize = fields.at(1).toInt(&ok);
+        if (!ok || kSize <= 0) {
+            return false;
+        }
+    }
+    if (fields.size() > 2) {
+        minDiff = fields.at(2).toInt(&ok);
+        if (!ok) {
+            return false;
+        }
+    }
+    if (fields.size() > 3) {
+        const QString polarityName = fields.at(3).toLower();
+        if ("light" == polarityName) {
+            polarity = VisionLibrary::ThresholdPolarity::Light;
+        } else if ("dark" == polarityName) {
+            polarity = VisionLibrary::ThresholdPolarity::Dark;
+        } else if ("both" == polarityName) {
+            polarity = VisionLibrary::ThresholdPolarity::Both;
+        } else {
+            return false;
+        }
+    }
+    return fields.size() <= 4;
+}
+
+QVector<BatchOperation> parseOperationChain(const QString &chain, QString &errorMessage)
+{
+    QVector<BatchOperation> operations;
+    for (const QString &token : chain.split(',', Qt::SkipEmptyParts)) {
+        BatchOperation operation;
+        operation.name = token.trimmed();
+        const QStringList fields = operation.name.split(':');
+        const QString type = fields.first().toLower();
+        if ("gray" == type && 1 == fields.size()) {
+            operation.apply = [](cv::Mat &mat, QVariantHash &) {
+                if (3 == mat.channels()) {
+                    cv::cvtColor(mat, mat, cv::COLOR_BGR2GRAY);
+                } else if (4 == mat.channels()) {
+                    cv::cvtColor(mat, mat, cv::COLOR_BGRA2GRAY);
+                }
+            };
+        } else if ("threshold" == type) {
+            int kSize = 3;
+            int minDiff = 5;
+            VisionLibrary::ThresholdPolarity polarity = VisionLibrary::ThresholdPolarity::Light;
+            if (!parseThresholdArguments(fields, kSize, minDiff, polarity)) {
+                errorMessage = QString("Invalid threshold arguments: %1").arg(operation.name);
+                return QVector<BatchOperation>();
+            }
+            operation.apply = [=](cv::Mat &mat, QVariantHash &) {
+                mat = VisionLibrary::threshold(mat, kSize, minDiff, polarity);
+            };
+        } else if ("otsu" == type && 1 == fields.size()) {
+            operation.apply = [](cv::Mat &mat, QVariantHash &) {
+                mat = VisionLibrary::otsuThreshold(mat);
+            };
+        } else if ("contours" == type && 1 == fields.size()) {
+            operation.apply = [](cv::Mat &mat, QVariantHash &result) {
+                // 每个处理线程复用一份, 处理每张图时不再为每个轮廓分配内存
+                thread_local VisionLibrary::ContourSet contours;
+                VisionLibrary::findSimpleExternalContours(mat, contours);
+                result.insert("contours", int(contours.size()));
+                cv::Mat drawing = cv::Mat::zeros(mat.size(), CV_8UC1);
+                contours.draw(drawing, VisionLibrary::SCALAR_WHITE);
+                mat = drawing;
+            };
+        } else {
+            errorMessage = QString("Unknown operation: %1").arg(operation.name);
+            return QVector<BatchOperation>();
+        }
+        operations.append(operation);
+    }
+    if (operations.isEmpty()) {
+        errorMessage = "Empty operation chain";
+    }
+    return operations;
+}
+
+BatchPipeline::BatchPipeline(const Options &options) : _options(options)
+{
+}
+
+QJsonObject BatchPipeline::run()
+{
+    const int fileCount = _options.files.size();
+    _finished.assign(size_t(fileCount), Item());
+    if (!_options.outputDir.isEmpty()) {
+        QDir().mkpath(_options.outputDir);
+    }
+
+    BoundedQueue<Item> decoded(_options.queueCapacity);
+    BoundedQueue<Item> processed(_options.queueCapacity);
+    std::atomic_int nextIndex(0);
+
+    // 每个线程在整个运行期间都占着, 所以线程池要容纳所有级的线程
+    QThreadPool threadPool;
+    threadPool.setMaxThreadCount(_options.decodeThreads + _options.processThreads + _options.encodeThreads);
+    const auto startStage = [&threadPool](const int threadCount, const std::function<void()> &work) {
+        QVector<QFuture<void>> futures;
+        for (int i = 0; i < threadCount; ++i) {
+            futures.append(QtConcurrent::run(&threadPool, work));
+        }
+        return futures;
+    };
+    const auto waitStage = [](QVector<QFuture<void>> &futures) {
+        for (QFuture<void> &future : futures) {
+            future.waitForFinished();
+        }
+    };
+
+    QElapsedTimer timer;
+    timer.start();
+    QVector<QFuture<void>> decoders = startStage(_options.decodeThreads, [&]() {
+        for (int index = nextIndex++; index < fileCount; index = nextIndex++) {
+            Item item;
+            item.index = index;
+            decode(item);
+            decoded.push(std::move(item));
+        }
+    });
+    QVector<QFuture<void>> processors = startStage(_options.processThreads, [&]() {
+        Item item;
+        while (decoded.pop(item)) {
+            process(item);
+            processed.push(std::move(item));
+        }
+    });
+    QVector<QFuture<void>> encoders = startStage(_options.encodeThreads, [&]() {
+        Item item;
+        while (processed.pop(item)) {
+            encode(item);
+            // 只保留结果, 图像在这里释放
+            item.mat.release();
+            const int index = item.index;
+            _finished[size_t(index)] = std::move(item);
+        }
+    });
+    // 上一级的线程都结束了, 下一级取空队列后才能结束
+    waitStage(decoders);
+    decoded.close();
+    waitStage(processors);
+    processed.close();
+    waitStage(encoders);
+    return summary(timer.nsecsElapsed());
+}
+
+int BatchPipeline::failedCount() const
+{
+    return int(std::count_if(_finished.begin(), _finished.end(), [](const Item &item) {
+        return !item.error.isEmpty();
+    }));
+}
+
+void BatchPipeline::decode(Item &item) const
+{
+    QElapsedTimer timer;
+    timer.start();
+    try {
+        // 保留原始的位深和通道数, 由操作链决定怎么转换
+        item.mat = VisionLibrary::readImage(_options.files.at(item.index), cv::IMREAD_UNCHANGED);
+        if (item.mat.empty()) {
+            item.error = "Decode failed";
+        }
+    } catch (const cv::Exception &e) {
+        item.error = QString("Decode failed: %1").arg(e.what());
+    }
+    item.decodeNs = timer.nsecsElapsed();
+}
+
+void BatchPipeline::process(Item &item) const
+{
+    if (!item.error.isEmpty()) {
+        return;
+    }
+    QElapsedTimer timer;
+    timer.start();
+    for (const BatchOperation &operation : _options.operations) {
+        try {
+            operation.apply(item.mat, item.result);
+        } catch (const cv::Exception &e) {
+            item.error = QString("%1 failed: %2").arg(operation.name, e.what());
+            break;
+        }
+    }
+    item.processNs = timer.nsecsElapsed();
+}
+
+void BatchPipeline::encode(Item &item) const
+{
+    if (!item.error.isEmpty() || _options.outputDir.isEmpty()) {
+        return;
+    }
+    QElapsedTimer timer;
+    timer.start();
+    const QString baseName = QFileInfo(_options.files.at(item.index)).completeBaseName();
+    item.outputPath = QDir(_options.outputDir).filePath(baseName + "." + _options.outputSuffix);
+    try {
+        if (!cv::imwrite(utf8_to_gbk(item.outputPath), item.mat)) {
+            item.error = "Encode failed";
+        }
+    } catch (const cv::Exception &e) {
+        item.error = QString("Encode failed: %1").arg(e.what());
+    }
+    item.encodeNs = timer.nsecsElapsed();
+}
+
+QJsonObject BatchPipeline::summary(const qint64 elapsedNs) const
+{
+    // 一级的耗时. 只统计真正执行了这一级的文件
+    struct StageTiming {
+        qint64 totalNs = 0;
+        qint64 maxNs = 0;
+        int count = 0;
+
+        void add(const qint64 ns)
+        {
+            if (ns > 0) {
+                totalNs += ns;
+                maxNs = qMax(maxNs, ns);
+                ++count;
+            }
+        }
+        QJsonObject toJson(const int threadCount) const
+        {
+            QJsonObject json;
+            json.insert("threads", threadCount);
+            json.insert("count", count);
+            json.insert("totalMs", totalNs / NS_PER_MS);
+            json.insert("meanMs", count > 0 ? totalNs / NS_PER_MS / count : 0.0);
+            json.insert("maxMs", maxNs / NS_PER_MS);
+            return json;
+        }
+    };
+    StageTiming decodeTiming;
+    StageTiming processTiming;
+    StageTiming encodeTiming;
+
+    QJsonArray files;
+    for (const Item &item : _finished) {
+        decodeTiming.add(item.decodeNs);
+        processTiming.add(item.processNs);
+        encodeTiming.add(item.encodeNs);
+
+        QJsonObject file = QJsonObject::fromVariantHash(item.result);
+        file.insert("input", _options.files.at(item.index));
+        if (!item.outputPath.isEmpty()) {
+            file.insert("output", item.outputPath);
+        }
+        file.insert("decodeMs", item.decodeNs / NS_PER_MS);
+        file.insert("processMs", item.processNs / NS_PER_MS);
+        file.insert("encodeMs", item.encodeNs / NS_PER_MS);
+        if (!item.error.isEmpty()) {
+            file.insert("error", item.error);
+        }
+        files.append(file);
+    }
+
+    QStringList operationNames;
+    for (const BatchOperation &operation : _options.operations) {
+        operationNames.append(operation.name);
+    }
+    const double elapsedSeconds = elapsedNs / 1e9;
+    QJsonObject stages;
+    stages.insert("decode", decodeTiming.toJson(_options.decodeThreads));
+    stages.insert("process", processTiming.toJson(_options.processThreads));
+    stages.insert("encode", encodeTiming.toJson(_options.encodeThreads));
+
+    QJsonObject json;
+    json.insert("version", VERSION);
+    json.insert("operations", QJsonArray::fromStringList(operationNames));
+    json.insert("imageCount", int(_finished.size()));
+    json.insert("failedCount", failedCount());
+    json.insert("queueCapacity", _options.queueCapacity);
+    json.insert("elapsedSeconds", elapsedSeconds);
+    json.insert("imagesPerSecond", elapsedSeconds > 0.0 ? _finished.size() / elapsedSeconds : 0.0);
+    json.insert("stages", stages);
+    json.insert("files", files);
+    return json;
+}
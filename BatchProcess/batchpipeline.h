@@ -0,0 +1,80 @@
+﻿#pragma once
+
+#include <functional>
+#include <vector>
+#include <QJsonObject>
+#include <QStringList>
+#include <QVariantHash>
+#include <QVector>
+#include <opencv2/opencv.hpp>
+
+// 操作链中的一步
+struct BatchOperation {
+    QString name; // 命令行中的写法, 比如"threshold:31:5:dark"
+    // 处理图像, 需要汇总的结果(比如轮廓数)写进result
+    std::function<void(cv::Mat &mat, QVariantHash &result)> apply;
+};
+
+/*!
+ * \brief parseOperationChain 解析逗号分隔的操作链, 比如"gray,threshold:31:5:dark,contours"
+ * \param chain 支持的操作:
+ * - gray: 转换成灰度图
+ * - threshold[:kSize[:minDiff[:light|dark|both]]]: VisionLibrary::threshold, 默认3:5:light
+ * - otsu: VisionLibrary::otsuThreshold
+ * - contours: VisionLibrary::findSimpleExternalContours, 结果记录轮廓数, 图像换成轮廓图(黑底白线)
+ * \param errorMessage 失败的原因
+ * \return 失败时返回空
+ */
+QVector<BatchOperation> parseOperationChain(const QString &chain, QString &errorMessage);
+
+/*!
+ * \brief The BatchPipeline class 把一批文件依次经过解码 -> 处理 -> 编码三级流水线
+ * \note 每一级有自己的线程, 级与级之间是有界队列, 所以读盘, 计算和写盘互相重叠, 内存占用有上限.
+ * 某个文件在任一级失败都只记录错误, 不影响其他文件
+ */
+class BatchPipeline
+{
+public:
+    struct Options {
+        QStringList files;
+        QVector<BatchOperation> operations;
+        QString outputDir; // 为空时不写结果图
+        QString outputSuffix = "png"; // 决定编码格式
+        int decodeThreads = 2;
+        int processThreads = 1;
+        int encodeThreads = 2;
+        int queueCapacity = 8; // 每个队列的容量
+    };
+
+    explicit BatchPipeline(const Options &options);
+
+    /*!
+     * \brief run 处理所有文件, 阻塞直到完成
+     * \return 汇总: 吞吐量, 各级耗时和每个文件的结果
+     */
+    QJsonObject run();
+
+    int failedCount() const;
+
+private:
+    // 在流水线中传递的一个文件
+    struct Item {
+        int index = -1; // 在_options.files中的下标
+        cv::Mat mat;
+        QVariantHash result;
+        QString outputPath;
+        QString error; // 不为空表示已经失败, 之后的级直接跳过
+        qint64 decodeNs = 0;
+        qint64 processNs = 0;
+        qint64 encodeNs = 0;
+    };
+
+    void decode(Item &item) const;
+    void process(Item &item) const;
+    void encode(Item &item) const;
+
+    QJsonObject summary(const qint64 elapsedNs) const;
+
+    const Options _options;
+    std::vector<Item> _finished; // 按下标存放, 编码线程各写各的元素
+};
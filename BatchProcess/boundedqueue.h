@@ -0,0 +1,69 @@
+﻿#pragma once
+
+#include <deque>
+#include <utility>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QWaitCondition>
+
+/*!
+ * \brief The BoundedQueue class 有容量上限的阻塞队列, 用于流水线相邻两级之间传递数据
+ * \note 队列满时生产者阻塞, 所以慢的一级会让快的一级停下来, 同时在途的图像数不超过各级容量与线程数之和.
+ * 所有生产者结束后调用close(), 消费者取空队列后pop()返回false
+ */
+template <typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(const int capacity) : _capacity(qMax(1, capacity))
+    {
+    }
+
+    // 队列满时阻塞. 队列已关闭时丢弃item, 返回false
+    bool push(T item)
+    {
+        QMutexLocker locker(&_mutex);
+        while (int(_items.size()) >= _capacity && !_closed) {
+            _notFull.wait(&_mutex);
+        }
+        if (_closed) {
+            return false;
+        }
+        _items.push_back(std::move(item));
+        _notEmpty.wakeOne();
+        return true;
+    }
+
+    // 队列空时阻塞. 队列已关闭并且已经取空时返回false
+    bool pop(T &item)
+    {
+        QMutexLocker locker(&_mutex);
+        while (_items.empty() && !_closed) {
+            _notEmpty.wait(&_mutex);
+        }
+        if (_items.empty()) {
+            return false;
+        }
+        item = std::move(_items.front());
+        _items.pop_front();
+        _notFull.wakeOne();
+        return true;
+    }
+
+    // 不再有数据. 唤醒所有等待的线程
+    void close()
+    {
+        QMutexLocker locker(&_mutex);
+        _closed = true;
+        _notEmpty.wakeAll();
+        _notFull.wakeAll();
+    }
+
+private:
+    const int _capacity;
+    QMutex _mutex;
+    QWaitCondition _notEmpty;
+    QWaitCondition _notFull;
+    std::deque<T> _items;
+    bool _closed = false;
+};
@@ -0,0 +1,129 @@
+﻿#include <QCollator>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonObject>
+#include <QTextStream>
+#include <QThread>
+#include <algorithm>
+#include "BatchProcess/batchpipeline.h"
+#include "CommonLibrary/GlobalTools/globaltools.h"
+
+// 展开输入的通配符. 通配符只能出现在文件名中, 比如D:/images/*.png; 同一目录下的文件按自然顺序排列
+static QStringList expandInputs(const QStringList &patterns)
+{
+    QCollator collator;
+    collator.setNumericMode(true);
+    QStringList files;
+    for (const QString &pattern : patterns) {
+        const QFileInfo patternInfo(pattern);
+        const QDir dir = patternInfo.dir();
+        QStringList names = dir.entryList(QStringList() << patternInfo.fileName(), QDir::Files | QDir::Readable);
+        std::sort(names.begin(), names.end(), collator);
+        for (const QString &name : names) {
+            files.append(dir.filePath(name));
+        }
+    }
+    files.removeDuplicates();
+    return files;
+}
+
+// 读取正整数选项, 没有指定时返回defaultValue, 不合法时返回0
+static int positiveValue(const QCommandLineParser &parser, const QCommandLineOption &option, const int defaultValue)
+{
+    if (!parser.isSet(option)) {
+        return defaultValue;
+    }
+    bool ok = false;
+    const int value = parser.value(option).toInt(&ok);
+    return ok && value > 0 ? value : 0;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("BatchProcess");
+    QCoreApplication::setApplicationVersion(VERSION);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Run a VisionLibrary operation chain over image files without a display.\n"
+                                     "Operations: gray, threshold[:kSize[:minDiff[:light|dark|both]]], otsu, contours");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    const QCommandLineOption inputOption(QStringList() << "i" << "input",
+                                         "Input files, wildcards allowed in the file name. Can be repeated.", "glob");
+    const QCommandLineOption chainOption(QStringList() << "c" << "chain",
+                                         "Comma separated operation chain.", "operations", "gray,otsu,contours");
+    const QCommandLineOption outputOption(QStringList() << "o" << "output",
+                                          "Directory for the result images. Nothing is written if omitted.", "dir");
+    const QCommandLineOption formatOption(QStringList() << "f" << "format",
+                                          "Suffix of the result images, which selects the encoder.", "suffix", "png");
+    const QCommandLineOption threadsOption(QStringList() << "j" << "threads",
+                                           "Number of processing threads.", "n");
+    const QCommandLineOption ioThreadsOption("io-threads", "Number of decoding threads and of encoding threads.", "n", "2");
+    const QCommandLineOption queueOption("queue", "Capacity of the queues between stages.", "n");
+    const QCommandLineOption summaryOption(QStringList() << "s" << "summary",
+                                           "Path of the JSON summary. Defaults to summary.json in the output directory.", "file");
+    parser.addOptions({inputOption, chainOption, outputOption, formatOption, threadsOption, ioThreadsOption, queueOption, summaryOption});
+    parser.process(a);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    if (!parser.isSet(inputOption)) {
+        err << "No input given" << Qt::endl;
+        parser.showHelp(1);
+    }
+
+    BatchPipeline::Options options;
+    options.files = expandInputs(parser.values(inputOption));
+    if (options.files.isEmpty()) {
+        err << "No file matches " << parser.values(inputOption).join(' ') << Qt::endl;
+        return 1;
+    }
+    QString errorMessage;
+    options.operations = parseOperationChain(parser.value(chainOption), errorMessage);
+    if (options.operations.isEmpty()) {
+        err << errorMessage << Qt::endl;
+        return 1;
+    }
+    options.outputDir = parser.value(outputOption);
+    options.outputSuffix = parser.value(formatOption);
+    options.processThreads = positiveValue(parser, threadsOption, QThread::idealThreadCount());
+    options.decodeThreads = positiveValue(parser, ioThreadsOption, 2);
+    options.encodeThreads = options.decodeThreads;
+    options.queueCapacity = positiveValue(parser, queueOption, 2 * options.processThreads);
+    if (0 == options.processThreads || 0 == options.decodeThreads || 0 == options.queueCapacity) {
+        err << "Thread counts and queue capacity must be positive integers" << Qt::endl;
+        return 1;
+    }
+
+    BatchPipeline pipeline(options);
+    const QJsonObject summary = pipeline.run();
+
+    QString summaryPath = parser.value(summaryOption);
+    if (summaryPath.isEmpty()) {
+        summaryPath = QDir(options.outputDir.isEmpty() ? QDir::currentPath() : options.outputDir).filePath("summary.json");
+    }
+    if (!WriteFile(summaryPath, QString::fromUtf8(GenerateJson(summary)))) {
+        err << "Write summary failed: " << summaryPath << Qt::endl;
+    }
+
+    out << QString("%1 images, %2 failed, %3 s, %4 images/s")
+        .arg(summary.value("imageCount").toInt())
+        .arg(pipeline.failedCount())
+        .arg(summary.value("elapsedSeconds").toDouble(), 0, 'f', 3)
+        .arg(summary.value("imagesPerSecond").toDouble(), 0, 'f', 2) << Qt::endl;
+    const QJsonObject stages = summary.value("stages").toObject();
+    for (const QString &stage : QStringList{"decode", "process", "encode"}) {
+        const QJsonObject timing = stages.value(stage).toObject();
+        out << QString("%1: %2 threads, total %3 ms, mean %4 ms, max %5 ms")
+            .arg(stage, -8)
+            .arg(timing.value("threads").toInt())
+            .arg(timing.value("totalMs").toDouble(), 0, 'f', 1)
+            .arg(timing.value("meanMs").toDouble(), 0, 'f', 2)
+            .arg(timing.value("maxMs").toDouble(), 0, 'f', 2) << Qt::endl;
+    }
+    out << "Summary: " << summaryPath << Qt::endl;
+    return 0 == pipeline.failedCount() ? 0 : 2;
+}
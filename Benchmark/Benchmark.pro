@@ -0,0 +1,23 @@
+QT       += core concurrent
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = Benchmark
+
+# VisionLibrary和GlobalTools(包括文件读写)的微基准测试, 结果写成JSON. 用法见Benchmark --help
+SOURCES += \
+    benchmarkharness.cpp \
+    fileiobenchmarks.cpp \
+    globaltoolsbenchmarks.cpp \
+    main.cpp \
+    visionbenchmarks.cpp
+
+HEADERS += \
+    benchmarkharness.h \
+    fileiobenchmarks.h \
+    globaltoolsbenchmarks.h \
+    visionbenchmarks.h
+
+# VisionLibrary, GlobalTools和OpenCV
+include(../VisionLibrary/visionlibrary.pri)
@@ -0,0 +1,195 @@
+﻿#include "benchmarkharness.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <new>
+#include <numeric>
+#include <vector>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QSysInfo>
+#include <QTextStream>
+#include <QThread>
+#include <opencv2/opencv.hpp>
+#include "CommonLibrary/GlobalTools/globaltools.h"
+
+// 所有线程的分配次数和字节数
+static std::atomic<qint64> g_heapAllocations(0);
+static std::atomic<qint64> g_matAllocations(0);
+static std::atomic<qint64> g_matBytes(0);
+
+// 替换全局的operator new/delete以统计堆分配. 数组和nothrow版本默认转调这两个
+void *operator new(std::size_t size)
+{
+    g_heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *const p = std::malloc(0 == size ? 1 : size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+/*!
+ * \brief The CountingMatAllocator class 统计cv::Mat分配的分配器, 分配和释放都交给原来的默认分配器
+ * \note 分配出的UMatData记录的是原来的分配器, 所以释放不经过这里
+ */
+class CountingMatAllocator : public cv::MatAllocator
+{
+public:
+    explicit CountingMatAllocator(cv::MatAllocator *base) : _base(base)
+    {
+    }
+
+    cv::UMatData *allocate(int dims, const int *sizes, int type, void *data, size_t *step,
+                           cv::AccessFlag flags, cv::UMatUsageFlags usageFlags) const override
+    {
+        cv::UMatData *const u = _base->allocate(dims, sizes, type, data, step, flags, usageFlags);
+        if (nullptr != u && nullptr == data) {
+            g_matAllocations.fetch_add(1, std::memory_order_relaxed);
+            g_matBytes.fetch_add(qint64(u->size), std::memory_order_relaxed);
+        }
+        return u;
+    }
+
+    bool allocate(cv::UMatData *data, cv::AccessFlag accessFlags, cv::UMatUsageFlags usageFlags) const override
+    {
+        return _base->allocate(data, accessFlags, usageFlags);
+    }
+
+    void deallocate(cv::UMatData *u) const override
+    {
+        _base->deallocate(u);
+    }
+
+private:
+    cv::MatAllocator *const _base;
+};
+
+// 某个时刻的分配计数
+struct AllocationCounters {
+    qint64 heapAllocations = g_heapAllocations.load();
+    qint64 matAllocations = g_matAllocations.load();
+    qint64 matBytes = g_matBytes.load();
+};
+
+// 有序样本的百分位数
+static qint64 percentile(const std::vector<qint64> &sortedSamples, const double fraction)
+{
+    const size_t rank = size_t(std::ceil(fraction * sortedSamples.size()));
+    return sortedSamples[qBound(size_t(1), rank, sortedSamples.size()) - 1];
+}
+
+BenchmarkHarness::BenchmarkHarness(const Options &options) : _options(options)
+{
+    // 故意不析构, 程序退出时仍可能有Mat要释放
+    static CountingMatAllocator *const allocator = new CountingMatAllocator(cv::Mat::getDefaultAllocator());
+    cv::Mat::setDefaultAllocator(allocator);
+}
+
+bool BenchmarkHarness::isSelected(const QString &name) const
+{
+    return _options.filter.pattern().isEmpty() || _options.filter.match(name).hasMatch();
+}
+
+void BenchmarkHarness::run(const QString &name, const QJsonObject &parameters, const qint64 pixelCount,
+                           const std::function<void()> &work)
+{
+    if (!isSelected(name)) {
+        return;
+    }
+    // 预热: 填充缓存, 建立查找表和线程池
+    work();
+
+    std::vector<qint64> samples;
+    const AllocationCounters before;
+    QElapsedTimer total;
+    total.start();
+    QElapsedTimer timer;
+    while (int(samples.size()) < _options.maxIterations
+           && (int(samples.size()) < _options.minIterations || total.nsecsElapsed() < _options.minTime * 1e9)) {
+        timer.start();
+        work();
+        samples.push_back(timer.nsecsElapsed());
+    }
+    const AllocationCounters after;
+
+    const double iterations = double(samples.size());
+    const double meanNs = std::accumulate(samples.begin(), samples.end(), 0.0) / iterations;
+    std::sort(samples.begin(), samples.end());
+    const qint64 medianNs = percentile(samples, 0.5);
+
+    QJsonObject result;
+    result.insert("name", name);
+    result.insert("parameters", parameters);
+    result.insert("iterations", int(samples.size()));
+    result.insert("meanNs", meanNs);
+    result.insert("medianNs", double(medianNs));
+    result.insert("minNs", double(samples.front()));
+    result.insert("p99Ns", double(percentile(samples, 0.99)));
+    result.insert("callsPerSecond", 1e9 / meanNs);
+    if (pixelCount > 0) {
+        result.insert("pixels", double(pixelCount));
+        result.insert("megapixelsPerSecond", pixelCount * 1e3 / qMax<qint64>(1, medianNs));
+    }
+    if (parameters.contains("bytes")) {
+        result.insert("megabytesPerSecond", parameters.value("bytes").toDouble() * 1e3 / qMax<qint64>(1, medianNs));
+    }
+    result.insert("heapAllocationsPerCall", (after.heapAllocations - before.heapAllocations) / iterations);
+    result.insert("matAllocationsPerCall", (after.matAllocations - before.matAllocations) / iterations);
+    result.insert("matBytesPerCall", (after.matBytes - before.matBytes) / iterations);
+    _results.append(result);
+
+    QTextStream(stdout) << QString("%1 %2 us %3 MPix/s %4 mat allocs %5 heap allocs")
+                        .arg(name, -48)
+                        .arg(medianNs / 1e3, 12, 'f', 1)
+                        .arg(result.value("megapixelsPerSecond").toDouble(), 10, 'f', 1)
+                        .arg(result.value("matAllocationsPerCall").toDouble(), 8, 'f', 1)
+                        .arg(result.value("heapAllocationsPerCall").toDouble(), 8, 'f', 1) << Qt::endl;
+}
+
+void BenchmarkHarness::check(const QString &name, const bool passed, const QString &detail)
+{
+    if (passed) {
+        QTextStream(stdout) << QString("%1 passed").arg(name, -48) << Qt::endl;
+        return;
+    }
+    qCritical().noquote() << "Check failed:" << name << detail;
+    QJsonObject failure;
+    failure.insert("name", name);
+    failure.insert("detail", detail);
+    _failures.append(failure);
+}
+
+bool BenchmarkHarness::hasFailures() const
+{
+    return !_failures.isEmpty();
+}
+
+QJsonObject BenchmarkHarness::toJson() const
+{
+    QJsonObject context;
+    context.insert("version", VERSION);
+    context.insert("qt", QString(qVersion()));
+    context.insert("opencv", QString(CV_VERSION));
+    context.insert("cpu", QSysInfo::currentCpuArchitecture());
+    context.insert("os", QSysInfo::prettyProductName());
+    context.insert("idealThreadCount", QThread::idealThreadCount());
+    context.insert("opencvThreads", cv::getNumThreads());
+    context.insert("simd", QString::fromStdString(cv::getCPUFeaturesLine()));
+
+    QJsonObject json;
+    json.insert("context", context);
+    json.insert("results", _results);
+    json.insert("failures", _failures);
+    return json;
+}
@@ -0,0 +1,62 @@
+﻿#pragma once
+
+#include <functional>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QRegularExpression>
+#include <QString>
+#include <QVector>
+
+/*!
+ * \brief The BenchmarkHarness class 简单的微基准测试框架
+ * \note
+ * - 每个用例先预热一次, 再重复调用直到累计时间达到minTime或次数达到maxIterations, 记录每次调用的耗时;
+ * - 同时统计每次调用的分配次数: cv::Mat的分配(替换了OpenCV的默认分配器)和operator new(替换了全局的operator new),
+ *   两者都包含OpenCV工作线程中的分配. OpenCV是动态库时, 库内部的operator new不经过这里, 所以堆分配只算本程序代码中的;
+ * - 结果是JSON, 便于在两次提交之间比较;
+ * - check()记录正确性检查, 有失败时程序以非0退出
+ */
+class BenchmarkHarness
+{
+public:
+    struct Options {
+        double minTime = 0.5; // 每个用例至少运行的秒数
+        int minIterations = 3;
+        int maxIterations = 10000;
+        QRegularExpression filter; // 只运行名字匹配的用例, 为空时全部运行
+    };
+
+    explicit BenchmarkHarness(const Options &options);
+
+    // 用例是否被选中. 生成输入的代价较大时, 先判断再生成
+    bool isSelected(const QString &name) const;
+
+    /*!
+     * \brief run 运行一个用例
+     * \param name 唯一的名字, 比如"threshold/8UC1/1920x1080/k31"
+     * \param parameters 原样写入结果, 便于筛选和作图. 有"bytes"(每次调用处理的字节数)时还计算MB/s
+     * \param pixelCount 每次调用处理的像素数, 用于计算MPix/s. 不适用时传0
+     * \param work 被测的调用
+     */
+    void run(const QString &name, const QJsonObject &parameters, const qint64 pixelCount,
+             const std::function<void()> &work);
+
+    /*!
+     * \brief check 记录一项正确性检查. 失败时用qCritical输出, 并写入结果的"failures", 程序最后以非0退出
+     * \param name 唯一的名字, 比如"check/findSimpleExternalContoursParallel/8UC1/VGA"
+     * \param passed
+     * \param detail 失败时的说明
+     * \note 不经过过滤, 调用者先用isSelected(name)判断是否要检查
+     */
+    void check(const QString &name, const bool passed, const QString &detail = QString());
+    // 有没有失败的检查
+    bool hasFailures() const;
+
+    // 所有用例的结果, 失败的检查和运行环境
+    QJsonObject toJson() const;
+
+private:
+    const Options _options;
+    QJsonArray _results;
+    QJsonArray _failures;
+};
@@ -0,0 +1,183 @@
+﻿#include "fileiobenchmarks.h"
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <QTemporaryDir>
+#include "CommonLibrary/GlobalTools/fileio.h"
+#include "CommonLibrary/GlobalTools/globaltools.h"
+
+// 逐条追加的记录数. AppendFile每条都要打开文件, 所以比文件小得多
+constexpr int APPEND_RECORDS = 10000;
+// 文件超过这么多字节时跳过经过QString的用例(ReadFile(QString), WriteFile).
+// Qt 5的QString最多约2^30个字符, 再考虑到转换时的临时内存, 留一半的余量
+constexpr qint64 MAX_QSTRING_FILE_BYTES = 512 * 1024 * 1024;
+
+// 大约bytes字节的文本, 每行是一条结果记录
+static QByteArray makeRecords(const qint64 bytes)
+{
+    QByteArray records;
+    records.reserve(int(qMin<qint64>(bytes + 128, INT_MAX)));
+    for (qint64 i = 0; records.size() < bytes; ++i) {
+        records += "record," + QByteArray::number(i) + ",x=" + QByteArray::number(i % 4096)
+                   + ",y=" + QByteArray::number(i % 3072) + ",score=" + QByteArray::number((i % 1000) / 1000.0) + "\n";
+    }
+    return records;
+}
+
+// 行数
+static qint64 countLines(const std::string_view &text)
+{
+    qint64 lines = 0;
+    const char *p = text.data();
+    const char *const end = p + text.size();
+    while (const void *found = std::memchr(p, '\n', size_t(end - p))) {
+        ++lines;
+        p = static_cast<const char *>(found) + 1;
+    }
+    return lines;
+}
+
+void runFileIoBenchmarks(BenchmarkHarness &harness, const qint64 fileBytes)
+{
+    if (fileBytes <= 0) {
+        return;
+    }
+    const QString sizeName = QString("%1MB").arg(fileBytes / (1024 * 1024));
+    const QString appendName = QString("%1records").arg(APPEND_RECORDS);
+    // 文件超过QString的限制时, 写入用例另在这个大小上运行一对. makeRecords会略超过fileBytes, 所以等于时也算
+    const QString cappedSizeName = QString("%1MB").arg(MAX_QSTRING_FILE_BYTES / (1024 * 1024));
+    QStringList caseNames = {
+        "read/ReadFile/QString/" + sizeName, "read/ReadFile/QByteArray/" + sizeName,
+        "read/MappedFile/" + sizeName, "read/LineReader/" + sizeName,
+        "write/WriteFile/" + sizeName, "write/BufferedFileWriter/" + sizeName,
+        "append/AppendFile/" + appendName, "append/BufferedFileWriter/" + appendName,
+    };
+    if (fileBytes >= MAX_QSTRING_FILE_BYTES) {
+        caseNames << "write/WriteFile/" + cappedSizeName << "write/BufferedFileWriter/" + cappedSizeName;
+    }
+    // 生成测试文件的代价较大, 没有选中的用例时跳过
+    if (std::none_of(caseNames.begin(), caseNames.end(), [&harness](const QString &name) {
+        return harness.isSelected(name);
+    })) {
+        return;
+    }
+    QTemporaryDir dir;
+    if (!dir.isValid()) {
+        qWarning() << "Cannot create a temporary directory" << dir.errorString();
+        return;
+    }
+    // QByteArray最大2GB
+    const QByteArray records = makeRecords(qMin<qint64>(fileBytes, INT_MAX - 1024));
+    const qint64 lines = countLines(std::string_view(records.constData(), size_t(records.size())));
+    const QString readPath = dir.filePath("read/records.txt");
+    {
+        BufferedFileWriter::Options options;
+        options.text = false;
+        BufferedFileWriter writer(readPath, options);
+        writer.write(records);
+        if (!writer.commit()) {
+            return;
+        }
+    }
+    QJsonObject parameters;
+    parameters.insert("bytes", records.size());
+    parameters.insert("lines", lines);
+
+    const bool fitsInQString = records.size() <= MAX_QSTRING_FILE_BYTES;
+    if (!fitsInQString) {
+        qInfo().noquote() << QString("Skipping the QString file cases: %1 bytes exceeds the QString limit of %2 bytes. "
+                                     "WriteFile and BufferedFileWriter are also compared at %3")
+                          .arg(records.size()).arg(MAX_QSTRING_FILE_BYTES).arg(cappedSizeName);
+    }
+
+    // 读取并数行数
+    if (fitsInQString) {
+        parameters.insert("method", "ReadFile(QString)");
+        harness.run("read/ReadFile/QString/" + sizeName, parameters, 0, [&]() {
+            QString content;
+            ReadFile(content, readPath);
+            content.count('\n');
+        });
+    }
+    parameters.insert("method", "ReadFile(QByteArray)");
+    harness.run("read/ReadFile/QByteArray/" + sizeName, parameters, 0, [&]() {
+        const QByteArray content = ReadFile(readPath);
+        countLines(std::string_view(content.constData(), size_t(content.size())));
+    });
+    parameters.insert("method", "MappedFile");
+    harness.run("read/MappedFile/" + sizeName, parameters, 0, [&]() {
+        const MappedFile file(readPath);
+        countLines(file.view());
+    });
+    parameters.insert("method", "LineReader");
+    harness.run("read/LineReader/" + sizeName, parameters, 0, [&]() {
+        LineReader reader(readPath);
+        std::string_view line;
+        while (reader.readLine(line)) {
+        }
+    });
+
+    // 写入整个文件. WriteFile跳过时, 另在它能处理的最大大小上比较WriteFile与BufferedFileWriter
+    const QString writePath = dir.filePath("write/records.txt");
+    const auto runWriteCases = [&](const QByteArray &content, const QString &contentSizeName, const bool withWriteFile) {
+        QJsonObject writeParameters;
+        writeParameters.insert("bytes", content.size());
+        writeParameters.insert("lines", countLines(std::string_view(content.constData(), size_t(content.size()))));
+        if (withWriteFile && harness.isSelected("write/WriteFile/" + contentSizeName)) {
+            const QString text = QString::fromUtf8(content);
+            writeParameters.insert("method", "WriteFile");
+            harness.run("write/WriteFile/" + contentSizeName, writeParameters, 0, [&]() {
+                WriteFile(writePath, text);
+            });
+        }
+        writeParameters.insert("method", "BufferedFileWriter");
+        harness.run("write/BufferedFileWriter/" + contentSizeName, writeParameters, 0, [&]() {
+            // 逐行写入, 就像边生成边写
+            BufferedFileWriter writer(writePath);
+            const char *p = content.constData();
+            const char *const end = p + content.size();
+            while (p < end) {
+                const char *const lineEnd = static_cast<const char *>(std::memchr(p, '\n', size_t(end - p))) + 1;
+                writer.write(std::string_view(p, size_t(lineEnd - p)));
+                p = lineEnd;
+            }
+            writer.commit();
+        });
+    };
+    runWriteCases(records, sizeName, fitsInQString);
+    if (!fitsInQString && (harness.isSelected("write/WriteFile/" + cappedSizeName)
+                           || harness.isSelected("write/BufferedFileWriter/" + cappedSizeName))) {
+        // 在行边界截断, 保证每行以换行结尾
+        const int cappedBytes = records.lastIndexOf('\n', int(MAX_QSTRING_FILE_BYTES) - 1) + 1;
+        runWriteCases(records.left(cappedBytes), cappedSizeName, true);
+    }
+
+    // 逐条追加
+    QStringList appendRecords;
+    qint64 appendBytes = 0;
+    for (int i = 0; i < APPEND_RECORDS; ++i) {
+        appendRecords << QString("record,%1,x=%2,y=%3\n").arg(i).arg(i % 4096).arg(i % 3072);
+        appendBytes += appendRecords.back().size();
+    }
+    const QString appendPath = dir.filePath("append/records.txt");
+    QJsonObject appendParameters;
+    appendParameters.insert("bytes", appendBytes);
+    appendParameters.insert("records", APPEND_RECORDS);
+    appendParameters.insert("method", "AppendFile");
+    harness.run("append/AppendFile/" + appendName, appendParameters, 0, [&]() {
+        QFile::remove(appendPath);
+        for (const QString &record : appendRecords) {
+            AppendFile(appendPath, record);
+        }
+    });
+    appendParameters.insert("method", "BufferedFileWriter(Append)");
+    harness.run("append/BufferedFileWriter/" + appendName, appendParameters, 0, [&]() {
+        QFile::remove(appendPath);
+        BufferedFileWriter::Options options;
+        options.mode = BufferedFileWriter::Mode::Append;
+        BufferedFileWriter writer(appendPath, options);
+        for (const QString &record : appendRecords) {
+            writer.write(record);
+        }
+    });
+}
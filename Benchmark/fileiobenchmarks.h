@@ -0,0 +1,12 @@
+﻿#pragma once
+
+#include "Benchmark/benchmarkharness.h"
+
+/*!
+ * \brief runFileIoBenchmarks 运行文件读写的基准测试: 比较ReadFile与MappedFile, LineReader的读取,
+ * WriteFile与BufferedFileWriter的写入, 以及逐条AppendFile与BufferedFileWriter(Append)的追加
+ * \param harness
+ * \param fileBytes 测试文件的大小, 为0时跳过. 超过512MB时跳过经过QString的用例(ReadFile(QString), WriteFile),
+ * 并另在512MB上比较WriteFile与BufferedFileWriter的写入
+ */
+void runFileIoBenchmarks(BenchmarkHarness &harness, const qint64 fileBytes);
@@ -0,0 +1,328 @@
+﻿#include "globaltoolsbenchmarks.h"
+#include "CommonLibrary/GlobalTools/globaltools.h"
+#include "CommonLibrary/GlobalTools/jsonreader.h"
+#include "CommonLibrary/GlobalTools/jsonwriter.h"
+#include <QBuffer>
+#include <QTemporaryFile>
+
+// 缓存之前的CaptureContents: 每次调用都构造模式并编译
+static QStringList uncachedCaptureContents(const QString &text, const DataExchangFormat &text_format, const QString &key)
+{
+    const QRegularExpression regular_expression(MakePattern(text_format, key));
+    QRegularExpressionMatchIterator it = regular_expression.globalMatch(text);
+    QStringList contents;
+    while (it.hasNext()) {
+        contents << it.next().captured(1);
+    }
+    return contents;
+}
+
+// CaptureMultipleContents(document)与对每个关键字调用CaptureContents(expectedDocument)的结果是否相同
+static bool sameAsCaptureContents(const QString &document, const QString &expectedDocument,
+                                  const DataExchangFormat &text_format, const QStringList &keys)
+{
+    const QHash<QString, QStringList> multiple = CaptureMultipleContents(document, text_format, keys);
+    for (const QString &key : keys) {
+        if (multiple.value(key) != CaptureContents(expectedDocument, text_format, key)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// records条记录, 每条记录有keys中的所有关键字, 值是"<关键字>_<记录号>"
+static QString makeDocument(const DataExchangFormat &text_format, const QStringList &keys, const int records)
+{
+    QString document;
+    if (DataExchangFormat::JSON == text_format) {
+        document = "{\"device\": \"camera\", \"results\": [\n";
+        for (int i = 0; i < records; ++i) {
+            document += "  {";
+            for (const QString &key : keys) {
+                document += QString("\"%1\": \"%1_%2\", \"score\": 0.5, ").arg(key).arg(i);
+            }
+            document += "\"index\": " + QString::number(i) + "},\n";
+        }
+        document += "]}\n";
+    } else {
+        document = "<?xml version=\"1.0\"?>\n<recipe name=\"benchmark\">\n";
+        for (int i = 0; i < records; ++i) {
+            document += "  <step>\n";
+            for (const QString &key : keys) {
+                document += QString("    <%1 unit=\"mm\"> %1_%2 </%1>\n").arg(key).arg(i);
+            }
+            document += "  </step>\n";
+        }
+        document += "</recipe>\n";
+    }
+    return document;
+}
+
+// contours个轮廓, 每个轮廓pointsPerContour个点, 格式与导出的轮廓结果相同
+static QByteArray makeContoursJson(const int contours, const int pointsPerContour)
+{
+    QByteArray json = "{\"image\":\"benchmark.png\",\"contours\":[";
+    for (int i = 0; i < contours; ++i) {
+        json += (0 == i ? "" : ",");
+        json += "{\"id\":" + QByteArray::number(i) + ",\"area\":" + QByteArray::number(i * 0.25) + ",\"points\":[";
+        for (int j = 0; j < pointsPerContour; ++j) {
+            json += (0 == j ? "[" : ",[") + QByteArray::number((i * 7 + j) % 4096) + "," + QByteArray::number((i * 13 + j) % 3072) + "]";
+        }
+        json += "]}";
+    }
+    json += "]}";
+    return json;
+}
+
+// 用ParseJson读出所有轮廓的点, 返回点的坐标个数
+static qint64 parseContoursByTree(const QString &json)
+{
+    qint64 coordinates = 0;
+    const QVariantList contours = ParseJson(json).value("contours").toList();
+    for (const QVariant &contour : contours) {
+        const QVariantList points = contour.toHash().value("points").toList();
+        for (const QVariant &point : points) {
+            for (const QVariant &coordinate : point.toList()) {
+                coordinates += coordinate.toInt() >= 0 ? 1 : 0;
+            }
+        }
+    }
+    return coordinates;
+}
+
+// 用JsonReader读出所有轮廓的点(复用points), 返回点的坐标个数, 出错返回-1
+static qint64 parseContoursByReader(const QByteArray &json, std::vector<int> &points)
+{
+    qint64 coordinates = 0;
+    JsonReader reader(json);
+    if (JsonReader::Token::BeginObject != reader.next()) {
+        return -1;
+    }
+    while (reader.nextKey()) {
+        if (!reader.isKey("contours") || JsonReader::Token::BeginArray != reader.next()) {
+            reader.skipValue();
+            continue;
+        }
+        while (JsonReader::Token::BeginObject == reader.next()) {
+            while (reader.nextKey()) {
+                if (reader.isKey("points")) {
+                    points.clear();
+                    reader.readNumberArray(points, true);
+                    coordinates += qint64(points.size());
+                } else {
+                    reader.skipValue();
+                }
+            }
+        }
+    }
+    return reader.hasError() ? -1 : coordinates;
+}
+
+// 要导出的轮廓, 每个轮廓的点展平成x, y, ...
+struct ExportedContour {
+    int id;
+    double area;
+    std::vector<int> points;
+};
+
+static std::vector<ExportedContour> makeExportedContours(const int contours, const int pointsPerContour)
+{
+    std::vector<ExportedContour> result(size_t(contours));
+    for (int i = 0; i < contours; ++i) {
+        result[size_t(i)].id = i;
+        result[size_t(i)].area = i * 0.25 + 1.0 / 3;
+        for (int j = 0; j < pointsPerContour; ++j) {
+            result[size_t(i)].points.push_back((i * 7 + j) % 4096);
+            result[size_t(i)].points.push_back((i * 13 + j) % 3072);
+        }
+    }
+    return result;
+}
+
+// 先建QJsonObject再用GenerateJson生成, 写入device
+static void exportContoursByTree(const std::vector<ExportedContour> &contours, QIODevice *device)
+{
+    QJsonArray contourArray;
+    for (const ExportedContour &contour : contours) {
+        QJsonArray points;
+        for (size_t i = 0; i < contour.points.size(); i += 2) {
+            points.append(QJsonArray{contour.points[i], contour.points[i + 1]});
+        }
+        QJsonObject contourObject;
+        contourObject.insert("id", contour.id);
+        contourObject.insert("area", contour.area);
+        contourObject.insert("points", points);
+        contourArray.append(contourObject);
+    }
+    QJsonObject root;
+    root.insert("image", "benchmark.png");
+    root.insert("contours", contourArray);
+    device->write(GenerateJson(root));
+}
+
+// 用JsonWriter边生成边写入device. 键按升序写, 与QJsonObject的顺序相同
+static void exportContoursByWriter(const std::vector<ExportedContour> &contours, QIODevice *device,
+                                   const JsonWriter::Options &options)
+{
+    JsonWriter writer(device, options);
+    writer.beginObject();
+    writer.key("contours").beginArray();
+    for (const ExportedContour &contour : contours) {
+        writer.beginObject();
+        writer.key("area").value(contour.area);
+        writer.key("id").value(contour.id);
+        writer.key("points").beginArray();
+        for (size_t i = 0; i < contour.points.size(); i += 2) {
+            writer.numberArray(contour.points.data() + i, 2);
+        }
+        writer.endArray();
+        writer.endObject();
+    }
+    writer.endArray();
+    writer.key("image").value("benchmark.png");
+    writer.endObject();
+    writer.flush();
+}
+
+/*!
+ * \brief checkEmptyXmlElements 有空元素<key/>的xml. 这是CaptureMultipleContents与CaptureContents的区别之一:
+ * 前者跳过空元素, 后者的正则表达式会从<key/>一直匹配到下一个</key>. 所以与去掉空元素之后的CaptureContents比较
+ */
+static void checkEmptyXmlElements(BenchmarkHarness &harness)
+{
+    const QString name = "check/CaptureMultipleContents/xml/emptyElements";
+    if (!harness.isSelected(name)) {
+        return;
+    }
+    const QStringList keys = {"width", "height", "depth"};
+    const QString document = "<recipe>\n"
+                             "  <step><width/><height>3</height></step>\n"
+                             "  <step><width unit=\"mm\"/><width> 5 </width><height/></step>\n"
+                             "  <depth>7</depth><depth />\n"
+                             "</recipe>\n";
+    QString withoutEmptyElements = document;
+    withoutEmptyElements.remove(QRegularExpression(R"(<(width|height|depth)\b[^>]*/>)"));
+    harness.check(name, sameAsCaptureContents(document, withoutEmptyElements, DataExchangFormat::XML, keys),
+                  "differs from CaptureContents on the document without empty elements");
+}
+
+void runGlobalToolsBenchmarks(BenchmarkHarness &harness)
+{
+    checkEmptyXmlElements(harness);
+
+    const int KEY_COUNTS[] = {5, 20};
+    const int RECORD_COUNTS[] = {1, 1000};
+    for (const DataExchangFormat text_format : {DataExchangFormat::JSON, DataExchangFormat::XML}) {
+        const QString formatName = DataExchangFormat::JSON == text_format ? "json" : "xml";
+        for (const int keyCount : KEY_COUNTS) {
+            QStringList keys;
+            // 补零, 避免一个关键字是另一个的前缀(xml的正则表达式<key[^>]*>会匹配以key开头的标签名)
+            for (int i = 0; i < keyCount; ++i) {
+                keys << QString("parameter%1").arg(i, 2, 10, QChar('0'));
+            }
+            for (const int records : RECORD_COUNTS) {
+                const QString document = makeDocument(text_format, keys, records);
+                const QString caseSuffix = QString("%1/%2keys/%3records").arg(formatName).arg(keyCount).arg(records);
+
+                // 一次遍历的结果要与逐个关键字的结果相同
+                const QString checkName = "check/CaptureMultipleContents/" + caseSuffix;
+                if (harness.isSelected(checkName)) {
+                    harness.check(checkName, sameAsCaptureContents(document, document, text_format, keys),
+                                  "differs from CaptureContents");
+                }
+                QJsonObject parameters;
+                parameters.insert("format", formatName);
+                parameters.insert("keys", keyCount);
+                parameters.insert("records", records);
+                parameters.insert("documentChars", document.size());
+
+                parameters.insert("method", "uncachedRegex");
+                harness.run("CaptureContents/uncached/" + caseSuffix, parameters, 0, [&]() {
+                    for (const QString &key : keys) {
+                        uncachedCaptureContents(document, text_format, key);
+                    }
+                });
+                parameters.insert("method", "cachedRegex");
+                harness.run("CaptureContents/cached/" + caseSuffix, parameters, 0, [&]() {
+                    for (const QString &key : keys) {
+                        CaptureContents(document, text_format, key);
+                    }
+                });
+                parameters.insert("method", "singlePass");
+                harness.run("CaptureMultipleContents/" + caseSuffix, parameters, 0, [&]() {
+                    CaptureMultipleContents(document, text_format, keys);
+                });
+            }
+        }
+    }
+
+    // 大的轮廓结果: 建树(ParseJson)与拉取式读取(JsonReader)
+    const int CONTOUR_COUNTS[] = {1000, 10000};
+    constexpr int POINTS_PER_CONTOUR = 64;
+    for (const int contours : CONTOUR_COUNTS) {
+        const QByteArray json = makeContoursJson(contours, POINTS_PER_CONTOUR);
+        // ParseJson的参数是QString, 转换不计入时间
+        const QString text = QString::fromUtf8(json);
+        std::vector<int> points;
+        const QString caseSuffix = QString("contours/%1x%2points").arg(contours).arg(POINTS_PER_CONTOUR);
+        QJsonObject parameters;
+        parameters.insert("contours", contours);
+        parameters.insert("pointsPerContour", POINTS_PER_CONTOUR);
+        parameters.insert("documentBytes", json.size());
+        parameters.insert("consistent", parseContoursByTree(text) == parseContoursByReader(json, points));
+
+        parameters.insert("method", "ParseJson");
+        harness.run("ParseJson/" + caseSuffix, parameters, 0, [&]() {
+            parseContoursByTree(text);
+        });
+        parameters.insert("method", "JsonReader");
+        harness.run("JsonReader/" + caseSuffix, parameters, 0, [&]() {
+            parseContoursByReader(json, points);
+        });
+    }
+
+    // 导出大的轮廓结果: 建树(GenerateJson)与流式写入(JsonWriter), 都写入临时文件
+    for (const int contours : CONTOUR_COUNTS) {
+        const std::vector<ExportedContour> exported = makeExportedContours(contours, POINTS_PER_CONTOUR);
+        QBuffer treeBuffer;
+        treeBuffer.open(QIODevice::WriteOnly);
+        exportContoursByTree(exported, &treeBuffer);
+        QBuffer writerBuffer;
+        writerBuffer.open(QIODevice::WriteOnly);
+        exportContoursByWriter(exported, &writerBuffer, JsonWriter::Options());
+        QTemporaryFile file;
+        if (!file.open()) {
+            qWarning() << "Cannot create a temporary file" << file.errorString();
+            break;
+        }
+        const auto rewind = [&file]() {
+            file.resize(0);
+            file.seek(0);
+        };
+        const QString caseSuffix = QString("contours/%1x%2points").arg(contours).arg(POINTS_PER_CONTOUR);
+        QJsonObject parameters;
+        parameters.insert("contours", contours);
+        parameters.insert("pointsPerContour", POINTS_PER_CONTOUR);
+        parameters.insert("documentBytes", treeBuffer.data().size());
+        // 输出要与QJsonDocument::Compact逐字节相同
+        parameters.insert("identical", treeBuffer.data() == writerBuffer.data());
+
+        parameters.insert("method", "GenerateJson");
+        harness.run("GenerateJson/" + caseSuffix, parameters, 0, [&]() {
+            rewind();
+            exportContoursByTree(exported, &file);
+        });
+        JsonWriter::Options options;
+        parameters.insert("method", "JsonWriter");
+        harness.run("JsonWriter/" + caseSuffix, parameters, 0, [&]() {
+            rewind();
+            exportContoursByWriter(exported, &file, options);
+        });
+        options.backgroundFlush = true;
+        parameters.insert("method", "JsonWriter/backgroundFlush");
+        harness.run("JsonWriter/backgroundFlush/" + caseSuffix, parameters, 0, [&]() {
+            rewind();
+            exportContoursByWriter(exported, &file, options);
+        });
+    }
+}
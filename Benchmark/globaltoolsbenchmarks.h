@@ -0,0 +1,13 @@
+﻿#pragma once
+
+#include "Benchmark/benchmarkharness.h"
+
+/*!
+ * \brief runGlobalToolsBenchmarks 运行GlobalTools的基准测试: 从json/xml文本中提取多个关键字的内容,
+ * 比较每次都编译正则表达式(缓存之前的CaptureContents), 缓存编译结果的CaptureContents, 以及一次遍历的CaptureMultipleContents,
+ * 并检查后者与CaptureContents的结果相同(包括有空元素<key/>的xml);
+ * 读取大的轮廓结果, 比较建树的ParseJson与拉取式的JsonReader;
+ * 导出大的轮廓结果, 比较建树的GenerateJson与流式的JsonWriter
+ * \param harness
+ */
+void runGlobalToolsBenchmarks(BenchmarkHarness &harness);
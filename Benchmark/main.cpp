@@ -0,0 +1,58 @@
+﻿#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QTextStream>
+#include <opencv2/opencv.hpp>
+#include "Benchmark/benchmarkharness.h"
+#include "Benchmark/fileiobenchmarks.h"
+#include "Benchmark/globaltoolsbenchmarks.h"
+#include "Benchmark/visionbenchmarks.h"
+#include "CommonLibrary/GlobalTools/globaltools.h"
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("Benchmark");
+    QCoreApplication::setApplicationVersion(VERSION);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Microbenchmarks for VisionLibrary and GlobalTools. Results are written as JSON so that commits can be compared.");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    const QCommandLineOption outputOption(QStringList() << "o" << "output", "Path of the JSON results.", "file", "benchmark.json");
+    const QCommandLineOption filterOption(QStringList() << "f" << "filter",
+                                          "Only run cases whose name matches this regular expression, e.g. \"threshold/8UC1\".", "regex");
+    const QCommandLineOption minTimeOption("min-time", "Minimum running time of each case in seconds.", "seconds", "0.5");
+    const QCommandLineOption maxMegapixelsOption("max-megapixels", "Skip image sizes larger than this.", "megapixels", "100");
+    const QCommandLineOption fileMegabytesOption("file-megabytes", "Size of the file used by the file I/O cases. 0 skips them. "
+                                                "Cases that go through QString are skipped above 512 MB (QString limit); "
+                                                "the writes are then also compared at 512 MB.", "megabytes", "1024");
+    const QCommandLineOption threadsOption(QStringList() << "j" << "threads", "Number of OpenCV threads. Defaults to OpenCV's choice.", "n");
+    const QCommandLineOption labelOption("label", "Free text stored in the results, e.g. a commit hash.", "text");
+    parser.addOptions({outputOption, filterOption, minTimeOption, maxMegapixelsOption, fileMegabytesOption, threadsOption, labelOption});
+    parser.process(a);
+
+    if (parser.isSet(threadsOption)) {
+        cv::setNumThreads(parser.value(threadsOption).toInt());
+    }
+    BenchmarkHarness::Options options;
+    options.minTime = parser.value(minTimeOption).toDouble();
+    options.filter = QRegularExpression(parser.value(filterOption));
+    if (!options.filter.isValid()) {
+        QTextStream(stderr) << "Invalid filter: " << options.filter.errorString() << Qt::endl;
+        return 1;
+    }
+    BenchmarkHarness harness(options);
+    runVisionBenchmarks(harness, parser.value(maxMegapixelsOption).toDouble());
+    runGlobalToolsBenchmarks(harness);
+    runFileIoBenchmarks(harness, parser.value(fileMegabytesOption).toLongLong() * 1024 * 1024);
+
+    QJsonObject results = harness.toJson();
+    results.insert("label", parser.value(labelOption));
+    const QString outputPath = parser.value(outputOption);
+    if (!WriteFile(outputPath, QString::fromUtf8(GenerateJson(results)))) {
+        return 1;
+    }
+    QTextStream(stdout) << "Results: " << outputPath << Qt::endl;
+    // 正确性检查失败时以非0退出, 便于脚本发现
+    return harness.hasFailures() ? 2 : 0;
+}
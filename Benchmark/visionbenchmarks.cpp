@@ -0,0 +1,548 @@
+﻿#include "visionbenchmarks.h"
+#include <algorithm>
+#include <map>
+#include <QFile>
+#include <QTemporaryDir>
+#include "VisionLibrary/imagefile.h"
+#include "VisionLibrary/visionlibrary.h"
+
+// 一种尺寸的测试图像
+struct SizeCase {
+    const char *name;
+    cv::Size size;
+};
+
+static const SizeCase SIZES[] = {
+    {"VGA", cv::Size(640, 480)},
+    {"1080p", cv::Size(1920, 1080)},
+    {"5MP", cv::Size(2592, 1944)},
+    {"20MP", cv::Size(5472, 3648)},
+    {"100MP", cv::Size(10000, 10000)},
+};
+
+// 比如"8UC1", 同OpenCV的类型名去掉"CV_"
+static QString typeName(const int type)
+{
+    static const char *const DEPTH_NAMES[] = {"8U", "8S", "16U", "16S", "32S", "32F", "64F", "16F"};
+    return QString("%1C%2").arg(DEPTH_NAMES[CV_MAT_DEPTH(type)]).arg(CV_MAT_CN(type));
+}
+
+// 8位单通道的图像转换成type: 16U乘257, 浮点除以255(各类型的惯例范围); 多通道时每个通道相同
+static cv::Mat convertTo(const cv::Mat &gray, const int type)
+{
+    cv::Mat converted;
+    switch (CV_MAT_DEPTH(type)) {
+    case CV_16U:
+        gray.convertTo(converted, CV_16U, 257.0);
+        break;
+    case CV_32F:
+    case CV_64F:
+        gray.convertTo(converted, CV_MAT_DEPTH(type), 1.0 / 255.0);
+        break;
+    default:
+        gray.convertTo(converted, CV_MAT_DEPTH(type));
+        break;
+    }
+    if (CV_MAT_CN(type) > 1) {
+        const std::vector<cv::Mat> channels(size_t(CV_MAT_CN(type)), converted);
+        cv::merge(channels, converted);
+    }
+    return converted;
+}
+
+/*!
+ * \brief The SyntheticImages class 按需生成并缓存合成的输入图像, 同样的参数总是生成同样的图像
+ * \note 换尺寸时clear(), 避免同时持有多幅100MP的图像
+ */
+class SyntheticImages
+{
+public:
+    // 均匀噪声
+    const cv::Mat &noise(const cv::Size &size, const int type)
+    {
+        return cached(QString("noise/%1").arg(type), [&]() {
+            cv::Mat gray(size, CV_8UC1);
+            cv::RNG rng(1);
+            rng.fill(gray, cv::RNG::UNIFORM, 0, 256);
+            return convertTo(gray, type);
+        });
+    }
+
+    // 不均匀光照下的亮点和暗点, 用于阈值分割
+    const cv::Mat &scene(const cv::Size &size, const int type)
+    {
+        return cached(QString("scene/%1").arg(type), [&]() {
+            const cv::Mat &base = scene8U(size);
+            return CV_8UC1 == type ? base : convertTo(base, type);
+        });
+    }
+
+    // 黑底上的白色实心圆(会有相互重叠的), 用于轮廓提取
+    const cv::Mat &blobs(const cv::Size &size)
+    {
+        return cached("blobs", [&]() {
+            cv::Mat mask = cv::Mat::zeros(size, CV_8UC1);
+            cv::RNG rng(3);
+            const int count = int(size.area() / 4000);
+            for (int i = 0; i < count; ++i) {
+                const cv::Point center(rng.uniform(0, size.width), rng.uniform(0, size.height));
+                cv::circle(mask, center, rng.uniform(2, 20), VisionLibrary::SCALAR_WHITE, cv::FILLED);
+            }
+            return mask;
+        });
+    }
+
+    // 同心的圆环, 圆环的洞里有实心圆, 再加上blobs. 用于检查分块提取轮廓时跨接缝的连通域和洞里的轮廓
+    const cv::Mat &rings(const cv::Size &size)
+    {
+        return cached("rings", [&]() {
+            cv::Mat mask = blobs(size).clone();
+            cv::RNG rng(4);
+            const int count = int(size.area() / 40000);
+            for (int i = 0; i < count; ++i) {
+                const cv::Point center(rng.uniform(0, size.width), rng.uniform(0, size.height));
+                const int radius = rng.uniform(20, 400);
+                cv::circle(mask, center, radius, VisionLibrary::SCALAR_WHITE, rng.uniform(1, 4));
+                cv::circle(mask, center, radius / 2, VisionLibrary::SCALAR_WHITE, cv::FILLED);
+            }
+            return mask;
+        });
+    }
+
+    void clear()
+    {
+        _images.clear();
+    }
+
+private:
+    const cv::Mat &scene8U(const cv::Size &size)
+    {
+        return cached("scene8U", [&]() {
+            // 水平方向的亮度渐变
+            cv::Mat ramp(1, size.width, CV_8UC1);
+            for (int j = 0; j < size.width; ++j) {
+                ramp.at<uchar>(0, j) = cv::saturate_cast<uchar>(60 + 120.0 * j / size.width);
+            }
+            cv::Mat scene;
+            cv::repeat(ramp, size.height, 1, scene);
+            cv::RNG rng(2);
+            const int count = int(size.area() / 2000);
+            for (int i = 0; i < count; ++i) {
+                const cv::Point center(rng.uniform(0, size.width), rng.uniform(0, size.height));
+                const int delta = rng.uniform(0, 2) ? 40 : -40;
+                const int value = scene.at<uchar>(center) + delta;
+                cv::circle(scene, center, rng.uniform(1, 6), cv::Scalar::all(value), cv::FILLED);
+            }
+            cv::Mat noise(size, CV_8SC1);
+            rng.fill(noise, cv::RNG::NORMAL, 0, 4);
+            cv::add(scene, noise, scene, cv::noArray(), CV_8U);
+            return scene;
+        });
+    }
+
+    const cv::Mat &cached(const QString &key, const std::function<cv::Mat()> &generate)
+    {
+        auto it = _images.find(key);
+        if (_images.end() == it) {
+            it = _images.emplace(key, generate()).first;
+        }
+        return it->second;
+    }
+
+    std::map<QString, cv::Mat> _images;
+};
+
+static QJsonObject parametersOf(const QString &function, const cv::Mat &mat)
+{
+    QJsonObject parameters;
+    parameters.insert("function", function);
+    parameters.insert("width", mat.cols);
+    parameters.insert("height", mat.rows);
+    parameters.insert("type", typeName(mat.type()));
+    parameters.insert("channels", mat.channels());
+    return parameters;
+}
+
+static bool writeBytes(const QString &filePath, const QByteArray &bytes)
+{
+    QFile file(filePath);
+    return file.open(QIODevice::WriteOnly) && file.write(bytes) == bytes.size();
+}
+
+// 1.0版本的NPY文件, shape是头中原样的元组, 比如"(3, 5)"
+static QByteArray makeNpy(const QString &descr, const QString &shape, const QByteArray &data)
+{
+    QByteArray header = QString("{'descr': '%1', 'fortran_order': False, 'shape': %2, }").arg(descr, shape).toLatin1();
+    // 头的总长度对齐到64字节, 以换行结尾
+    while ((10 + header.size() + 1) % 64 != 0) {
+        header += ' ';
+    }
+    header += '\n';
+    QByteArray npy("\x93NUMPY\x01\x00", 8);
+    npy += char(header.size() & 0xff);
+    npy += char(header.size() >> 8);
+    return npy + header + data;
+}
+
+static bool sameMat(const cv::Mat &lhs, const cv::Mat &rhs)
+{
+    return lhs.size == rhs.size && lhs.type() == rhs.type() && 0 == cv::norm(lhs, rhs, cv::NORM_INF);
+}
+
+/*!
+ * \brief mismatchedBandRows 用每种分块行数(0表示自动)分块并行提取轮廓, 返回结果与expected(单线程的结果)不同的分块行数
+ */
+static QStringList mismatchedBandRows(const cv::Mat &mask, const cv::Point &offset,
+                                      const std::vector<std::vector<cv::Point>> &expected,
+                                      const std::initializer_list<int> &bandRowsList)
+{
+    QStringList mismatches;
+    for (const int bandRows : bandRowsList) {
+        if (VisionLibrary::findSimpleExternalContoursParallel(mask, offset, bandRows) != expected) {
+            mismatches.append(QString::number(bandRows));
+        }
+    }
+    return mismatches;
+}
+
+/*!
+ * \brief checkParallelContours 在小的随机掩膜上, 用很小的(包括1行和奇数行)分块检查findSimpleExternalContoursParallel.
+ * 掩膜中有噪声, 跨过很多接缝的圆环, 圆环洞里的实心圆, 以及正好落在块的第一行/最后一行的横线
+ */
+static void checkParallelContours(BenchmarkHarness &harness)
+{
+    const QString name = "check/findSimpleExternalContoursParallel/8UC1/smallBands";
+    if (!harness.isSelected(name)) {
+        return;
+    }
+    QStringList failures;
+    for (int seed = 0; seed < 20; ++seed) {
+        cv::RNG rng(uint64(seed));
+        cv::Mat mask(97 + seed, 131, CV_8UC1);
+        rng.fill(mask, cv::RNG::UNIFORM, 0, 256);
+        cv::threshold(mask, mask, 200 - seed * 5, 255, cv::THRESH_BINARY);
+        for (int i = 0; i < 6; ++i) {
+            const cv::Point center(rng.uniform(0, mask.cols), rng.uniform(0, mask.rows));
+            const int radius = rng.uniform(8, 40);
+            cv::circle(mask, center, radius + 3, VisionLibrary::SCALAR_BLACK, cv::FILLED);
+            cv::circle(mask, center, radius, VisionLibrary::SCALAR_WHITE, rng.uniform(1, 3));
+            cv::circle(mask, center, radius / 3, VisionLibrary::SCALAR_WHITE, cv::FILLED);
+        }
+        const int seamRow = 17 * rng.uniform(1, mask.rows / 17);
+        cv::line(mask, cv::Point(3, seamRow - 1), cv::Point(mask.cols - 4, seamRow - 1), VisionLibrary::SCALAR_WHITE);
+        cv::line(mask, cv::Point(20, seamRow), cv::Point(mask.cols - 20, seamRow), VisionLibrary::SCALAR_WHITE);
+        const cv::Point offset(-5, 9);
+        const QStringList mismatches = mismatchedBandRows(mask, offset, VisionLibrary::findSimpleExternalContours(mask, offset),
+                                                          {1, 2, 3, 5, 8, 16, 17, 33});
+        if (!mismatches.isEmpty()) {
+            failures.append(QString("seed %1: bandRows %2").arg(seed).arg(mismatches.join(", ")));
+        }
+    }
+    harness.check(name, failures.isEmpty(), "differs from findSimpleExternalContours: " + failures.join("; "));
+}
+
+// VisionLibrary::threshold对CV_8UC1以外的类型的做法: cv::blur估计背景, 再比较有符号的差
+static cv::Mat blurThreshold(const cv::Mat &src, const int kSize, const int minDiff,
+                             const VisionLibrary::ThresholdPolarity polarity)
+{
+    cv::Mat background;
+    cv::blur(src, background, cv::Size(kSize, kSize));
+    cv::Mat diff;
+    cv::subtract(src, background, diff, cv::noArray(), CV_32F);
+    switch (polarity) {
+    case VisionLibrary::ThresholdPolarity::Dark:
+        return diff <= -minDiff;
+    case VisionLibrary::ThresholdPolarity::Both:
+        return cv::abs(diff) >= minDiff;
+    default:
+        return diff >= minDiff;
+    }
+}
+
+/*!
+ * \brief checkThreshold CV_8UC1一次遍历的动态阈值与cv::blur的做法逐像素相同. 每种极性一项检查,
+ * 覆盖奇数大小的图像, 不同的kSize(包括比图像还大的)和minDiff(包括负数和超过255的)
+ */
+static void checkThreshold(BenchmarkHarness &harness)
+{
+    const std::pair<VisionLibrary::ThresholdPolarity, QString> polarities[] = {
+        {VisionLibrary::ThresholdPolarity::Light, "Light"},
+        {VisionLibrary::ThresholdPolarity::Dark, "Dark"},
+        {VisionLibrary::ThresholdPolarity::Both, "Both"},
+    };
+    SyntheticImages images;
+    const cv::Size size(641, 479);
+    const cv::Mat *const sources[] = {&images.scene(size, CV_8UC1), &images.noise(size, CV_8UC1)};
+    for (const auto &polarity : polarities) {
+        const QString name = "check/threshold/8UC1/" + polarity.second;
+        if (!harness.isSelected(name)) {
+            continue;
+        }
+        QStringList failures;
+        for (const cv::Mat *const src : sources) {
+            for (const int kSize : {1, 3, 5, 31, 101, 701}) {
+                for (const int minDiff : {-300, -5, 0, 1, 5, 40, 255, 300}) {
+                    const cv::Mat expected = blurThreshold(*src, kSize, minDiff, polarity.first);
+                    const cv::Mat actual = VisionLibrary::threshold(*src, kSize, minDiff, polarity.first);
+                    if (0 != cv::countNonZero(actual != expected)) {
+                        failures.append(QString("k%1/minDiff%2").arg(kSize).arg(minDiff));
+                    }
+                }
+            }
+        }
+        harness.check(name, failures.isEmpty(), "differs from cv::blur: " + failures.join(", "));
+    }
+}
+
+/*!
+ * \brief checkImageFiles mapImageFile/readImage的正确性检查: 8位和16位PGM(16位要交换字节序拷贝,
+ * 映射由mapImageFile解除), NPY, 以及shape中有非整数维或空字段的NPY要被拒绝
+ */
+static void checkImageFiles(BenchmarkHarness &harness)
+{
+    const QString prefix = "check/mapImageFile/";
+    const QStringList names = {prefix + "pgm8", prefix + "pgm16", prefix + "npy", prefix + "npyInvalidShape"};
+    if (std::none_of(names.begin(), names.end(), [&harness](const QString &name) {
+        return harness.isSelected(name);
+    })) {
+        return;
+    }
+    QTemporaryDir dir;
+    cv::Mat expected8(3, 5, CV_8UC1);
+    cv::Mat expected16(3, 5, CV_16UC1);
+    cv::RNG rng(6);
+    rng.fill(expected8, cv::RNG::UNIFORM, 0, 256);
+    rng.fill(expected16, cv::RNG::UNIFORM, 0, 65536);
+
+    if (harness.isSelected(prefix + "pgm8")) {
+        const QString path = dir.filePath("gray8.pgm");
+        const QByteArray pgm = QByteArray("P5\n# comment\n5 3\n255\n") + QByteArray(reinterpret_cast<const char *>(expected8.data), 15);
+        harness.check(prefix + "pgm8", writeBytes(path, pgm) && sameMat(VisionLibrary::readImage(path, cv::IMREAD_UNCHANGED), expected8));
+    }
+    if (harness.isSelected(prefix + "pgm16")) {
+        const QString path = dir.filePath("gray16.pgm");
+        QByteArray pgm("P5\n5 3\n65535\n");
+        for (int i = 0; i < expected16.rows; ++i) {
+            for (int j = 0; j < expected16.cols; ++j) {
+                const ushort value = expected16.at<ushort>(i, j);
+                pgm += char(value >> 8);
+                pgm += char(value & 0xff);
+            }
+        }
+        bool passed = writeBytes(path, pgm);
+        // 多次导入, 每次的映射都要只解除一次
+        for (int i = 0; i < 3 && passed; ++i) {
+            passed = sameMat(VisionLibrary::readImage(path, cv::IMREAD_UNCHANGED), expected16);
+        }
+        harness.check(prefix + "pgm16", passed);
+    }
+    if (harness.isSelected(prefix + "npy")) {
+        const QString path = dir.filePath("gray16.npy");
+        const QByteArray data(reinterpret_cast<const char *>(expected16.data), int(expected16.total() * expected16.elemSize()));
+        harness.check(prefix + "npy", writeBytes(path, makeNpy("<u2", "(3, 5)", data))
+                      && sameMat(VisionLibrary::readImage(path, cv::IMREAD_UNCHANGED), expected16));
+    }
+    if (harness.isSelected(prefix + "npyInvalidShape")) {
+        const QByteArray data(reinterpret_cast<const char *>(expected8.data), 15);
+        const QStringList shapes = {"(3, x, 5)", "(3,,5)", "(3, 5,)", "(,3, 5)"};
+        QStringList accepted;
+        for (const QString &shape : shapes) {
+            // 每个用例一个文件, 不覆盖可能还在映射中的文件
+            const QString path = dir.filePath(QString("invalid%1.npy").arg(shapes.indexOf(shape)));
+            if (!writeBytes(path, makeNpy("|u1", shape, data)) || !VisionLibrary::readImage(path, cv::IMREAD_UNCHANGED).empty()) {
+                accepted.append(shape);
+            }
+        }
+        harness.check(prefix + "npyInvalidShape", accepted.isEmpty(), "malformed shapes were accepted: " + accepted.join(" "));
+    }
+}
+
+void runVisionBenchmarks(BenchmarkHarness &harness, const double maxMegapixels)
+{
+    checkImageFiles(harness);
+    checkParallelContours(harness);
+    checkThreshold(harness);
+
+    // toPremultiImage支持的类型
+    const int CONVERSION_TYPES[] = {CV_8UC1, CV_8UC3, CV_8UC4, CV_16UC1, CV_16UC3, CV_32FC1};
+    const int THRESHOLD_TYPES[] = {CV_8UC1, CV_8UC3, CV_16UC1, CV_32FC1};
+    const int THRESHOLD_KSIZES[] = {3, 31, 101};
+
+    // 分块并行提取轮廓的线程数: 1, 2, 4, ...直到CPU核数
+    const int defaultThreads = cv::getNumThreads();
+    std::vector<int> threadCounts;
+    for (int threads = 1; threads < cv::getNumberOfCPUs(); threads *= 2) {
+        threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(cv::getNumberOfCPUs());
+
+    SyntheticImages images;
+    for (const SizeCase &sizeCase : SIZES) {
+        if (sizeCase.size.area() > maxMegapixels * 1e6) {
+            continue;
+        }
+        images.clear();
+        const qint64 pixels = sizeCase.size.area();
+        const auto caseName = [&sizeCase](const QString &function, const int type, const QString &suffix = QString()) {
+            return QString("%1/%2/%3%4").arg(function, typeName(type), sizeCase.name, suffix);
+        };
+
+        for (const int type : CONVERSION_TYPES) {
+            QString name = caseName("toPremultiImage", type);
+            if (harness.isSelected(name)) {
+                const cv::Mat &src = images.noise(sizeCase.size, type);
+                harness.run(name, parametersOf("toPremultiImage", src), pixels, [&src]() {
+                    VisionLibrary::toPremultiImage(src);
+                });
+            }
+            name = caseName("toDisplayImage", type);
+            if (harness.isSelected(name)) {
+                const cv::Mat &src = images.noise(sizeCase.size, type);
+                harness.run(name, parametersOf("toDisplayImage", src), pixels, [&src]() {
+                    VisionLibrary::toDisplayImage(src);
+                });
+            }
+            // 不透明的4通道: 逐像素检查alpha之后零拷贝, 与调用者声明不透明直接零拷贝的对比
+            if (CV_8UC4 == type) {
+                const QString checkedName = caseName("toDisplayImage", type, "/opaque/checked");
+                const QString declaredName = caseName("toDisplayImage", type, "/opaque/declared");
+                if (harness.isSelected(checkedName) || harness.isSelected(declaredName)) {
+                    cv::Mat opaque = images.noise(sizeCase.size, type).clone();
+                    cv::insertChannel(cv::Mat(sizeCase.size, CV_8UC1, cv::Scalar(255)), opaque, 3);
+                    if (harness.isSelected(checkedName)) {
+                        harness.run(checkedName, parametersOf("toDisplayImage", opaque), pixels, [&opaque]() {
+                            VisionLibrary::toDisplayImage(opaque);
+                        });
+                    }
+                    if (harness.isSelected(declaredName)) {
+                        harness.run(declaredName, parametersOf("toDisplayImage", opaque), pixels, [&opaque]() {
+                            VisionLibrary::toDisplayImage(opaque, true, true);
+                        });
+                    }
+                }
+            }
+            // 窗宽窗位映射, 以及走gamma查找表的路径
+            for (const double gamma : {1.0, 2.2}) {
+                name = caseName("toPremultiImage", type, QString("/mapping/gamma%1").arg(gamma));
+                if (harness.isSelected(name)) {
+                    const cv::Mat &src = images.noise(sizeCase.size, type);
+                    const double range = CV_32F == src.depth() ? 1.0 : CV_16U == src.depth() ? 65535.0 : 255.0;
+                    const VisionLibrary::DisplayMapping mapping = VisionLibrary::DisplayMapping::fromRange(0.2 * range, 0.8 * range, gamma);
+                    QJsonObject parameters = parametersOf("toPremultiImage", src);
+                    parameters.insert("gamma", gamma);
+                    harness.run(name, parameters, pixels, [&src, mapping]() {
+                        VisionLibrary::toPremultiImage(src, mapping);
+                    });
+                }
+            }
+            name = caseName("autoStretch", type);
+            if (harness.isSelected(name)) {
+                const cv::Mat &src = images.noise(sizeCase.size, type);
+                harness.run(name, parametersOf("autoStretch", src), pixels, [&src]() {
+                    VisionLibrary::autoStretch(src);
+                });
+            }
+        }
+
+        for (const int type : THRESHOLD_TYPES) {
+            for (const int kSize : THRESHOLD_KSIZES) {
+                const QString name = caseName("threshold", type, QString("/k%1").arg(kSize));
+                if (harness.isSelected(name)) {
+                    const cv::Mat &src = images.scene(sizeCase.size, type);
+                    QJsonObject parameters = parametersOf("threshold", src);
+                    parameters.insert("kSize", kSize);
+                    // 耗时与minDiff无关
+                    harness.run(name, parameters, pixels, [&src, kSize]() {
+                        VisionLibrary::threshold(src, kSize, 5, VisionLibrary::ThresholdPolarity::Both);
+                    });
+                }
+            }
+        }
+
+        QString name = caseName("otsuThreshold", CV_8UC1);
+        if (harness.isSelected(name)) {
+            const cv::Mat &src = images.scene(sizeCase.size, CV_8UC1);
+            harness.run(name, parametersOf("otsuThreshold", src), pixels, [&src]() {
+                VisionLibrary::otsuThreshold(src);
+            });
+        }
+
+        name = caseName("findSimpleExternalContours", CV_8UC1);
+        if (harness.isSelected(name)) {
+            const cv::Mat &src = images.blobs(sizeCase.size);
+            QJsonObject parameters = parametersOf("findSimpleExternalContours", src);
+            parameters.insert("contours", int(VisionLibrary::findSimpleExternalContours(src).size()));
+            harness.run(name, parameters, pixels, [&src]() {
+                VisionLibrary::findSimpleExternalContours(src);
+            });
+        }
+
+        // 每帧提取轮廓并画出来: std::vector<std::vector<cv::Point>>每帧为每个轮廓分配内存, 复用的ContourSet不分配.
+        // identical是两者的轮廓和画出的图像是否完全相同
+        const QString vectorName = caseName("findAndDrawContours", CV_8UC1, "/vector");
+        const QString contourSetName = caseName("findAndDrawContours", CV_8UC1, "/ContourSet");
+        if (harness.isSelected(vectorName) || harness.isSelected(contourSetName)) {
+            const cv::Mat &src = images.rings(sizeCase.size);
+            cv::Mat drawing(src.size(), CV_8UC1);
+            VisionLibrary::ContourSet contourSet;
+            VisionLibrary::findSimpleExternalContours(src, contourSet);
+            const std::vector<std::vector<cv::Point>> contours = VisionLibrary::findSimpleExternalContours(src);
+            drawing.setTo(0);
+            cv::drawContours(drawing, contours, -1, VisionLibrary::SCALAR_WHITE);
+            cv::Mat contourSetDrawing = cv::Mat::zeros(src.size(), CV_8UC1);
+            contourSet.draw(contourSetDrawing, VisionLibrary::SCALAR_WHITE);
+            QJsonObject parameters = parametersOf("findAndDrawContours", src);
+            parameters.insert("contours", int(contours.size()));
+            parameters.insert("points", qint64(contourSet.pointCount()));
+            parameters.insert("identical", contourSet.toVector() == contours && 0 == cv::countNonZero(drawing != contourSetDrawing));
+            if (harness.isSelected(vectorName)) {
+                harness.run(vectorName, parameters, pixels, [&src, &drawing]() {
+                    const std::vector<std::vector<cv::Point>> contours = VisionLibrary::findSimpleExternalContours(src);
+                    drawing.setTo(0);
+                    cv::drawContours(drawing, contours, -1, VisionLibrary::SCALAR_WHITE);
+                });
+            }
+            if (harness.isSelected(contourSetName)) {
+                harness.run(contourSetName, parameters, pixels, [&src, &drawing, &contourSet]() {
+                    VisionLibrary::findSimpleExternalContours(src, contourSet);
+                    drawing.setTo(0);
+                    contourSet.draw(drawing, VisionLibrary::SCALAR_WHITE);
+                });
+            }
+        }
+
+        // 分块并行提取轮廓随线程数的扩展性. 同时检查结果与单线程的完全相同(默认分块, 以及奇数行的小分块)
+        for (const QString &pattern : {QString("blobs"), QString("rings")}) {
+            const QString baseName = caseName("findSimpleExternalContoursParallel", CV_8UC1, "/" + pattern);
+            const auto threadCaseName = [&baseName](const int threads) {
+                return QString("%1/threads%2").arg(baseName).arg(threads);
+            };
+            if (std::none_of(threadCounts.begin(), threadCounts.end(), [&](const int threads) {
+                return harness.isSelected(threadCaseName(threads));
+            })) {
+                continue;
+            }
+            const cv::Mat &src = "blobs" == pattern ? images.blobs(sizeCase.size) : images.rings(sizeCase.size);
+            const cv::Point offset(7, -3);
+            const std::vector<std::vector<cv::Point>> expected = VisionLibrary::findSimpleExternalContours(src, offset);
+            for (const int threads : threadCounts) {
+                const QString name = threadCaseName(threads);
+                if (!harness.isSelected(name)) {
+                    continue;
+                }
+                cv::setNumThreads(threads);
+                QJsonObject parameters = parametersOf("findSimpleExternalContoursParallel", src);
+                parameters.insert("pattern", pattern);
+                parameters.insert("threads", threads);
+                parameters.insert("contours", int(expected.size()));
+                const QStringList mismatches = mismatchedBandRows(src, offset, expected, {0, 17, 255});
+                harness.check("check/" + name, mismatches.isEmpty(),
+                              "differs from findSimpleExternalContours with bandRows " + mismatches.join(", "));
+                harness.run(name, parameters, pixels, [&src, &offset]() {
+                    VisionLibrary::findSimpleExternalContoursParallel(src, offset);
+                });
+            }
+            cv::setNumThreads(defaultThreads);
+        }
+    }
+}
@@ -0,0 +1,15 @@
+﻿#pragma once
+
+#include "Benchmark/benchmarkharness.h"
+
+/*!
+ * \brief runVisionBenchmarks 运行VisionLibrary的基准测试:
+ * toPremultiImage(含显示映射), toDisplayImage, autoStretch, threshold, otsuThreshold, findSimpleExternalContours,
+ * 以及findSimpleExternalContoursParallel随线程数的扩展性(同时检查结果与单线程的相同, 不同时失败).
+ * 每帧提取并画出轮廓时std::vector<std::vector<cv::Point>>与复用的ContourSet的对比.
+ * 输入是合成图像, 尺寸从VGA到100MP, 类型覆盖8U/16U/32F和不同的通道数
+ * 另外检查mapImageFile导入PGM/NPY的结果, 很小的分块(1行, 奇数行)下跨接缝的轮廓, 以及CV_8UC1的动态阈值与cv::blur的做法相同
+ * \param harness
+ * \param maxMegapixels 跳过更大的尺寸
+ */
+void runVisionBenchmarks(BenchmarkHarness &harness, const double maxMegapixels);
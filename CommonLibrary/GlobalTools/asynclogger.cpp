@@ -0,0 +1,403 @@
+﻿#include "asynclogger.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <QDate>
+#include <QDeadlineTimer>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QThread>
+#include <QTime>
+#include "CommonLibrary/GlobalTools/globaltools.h"
+
+// 复用的缓冲区预留的大小. reserve()过的QByteArray在resize(0)时不释放内存
+constexpr int BATCH_RESERVE_SIZE = 256 * 1024;
+// LogRing::inFlightSequence的值, 表示生产者没有正在写入的消息
+constexpr quint64 NOT_IN_FLIGHT = std::numeric_limits<quint64>::max();
+
+// 缓冲区中每条消息之前的记录头
+struct LogRecordHeader {
+    quint32 size; // 消息的字节数
+    quint64 sequence;
+};
+
+/*!
+ * \brief The LogRing class 单生产者(打日志的线程)单消费者(后台线程)的无锁环形缓冲区, 存放格式化好的消息
+ * \note head和tail单调递增, 对容量取模得到位置. 生产者只写head, 消费者只写tail, 各占一个缓存行
+ */
+class LogRing
+{
+public:
+    explicit LogRing(const int capacity) : _buffer(roundUpToPowerOfTwo(capacity)), _mask(_buffer.size() - 1)
+    {
+    }
+
+    // 生产者调用. 空间不够时返回false, 消息被丢弃
+    bool push(const quint64 sequence, const QByteArray &text)
+    {
+        const quint64 size = sizeof(LogRecordHeader) + quint64(text.size());
+        const quint64 head = _head.load(std::memory_order_relaxed);
+        const quint64 tail = _tail.load(std::memory_order_acquire);
+        if (head + size - tail > _buffer.size()) {
+            return false;
+        }
+        const LogRecordHeader header{quint32(text.size()), sequence};
+        copyIn(head, &header, sizeof(header));
+        copyIn(head + sizeof(header), text.constData(), size_t(text.size()));
+        _head.store(head + size, std::memory_order_release);
+        return true;
+    }
+
+    // 消费者调用. 取出序号小于sequenceLimit的消息追加到batch, 每条消息调用一次onRecord(序号, 在batch中的偏移, 字节数).
+    // 同一个缓冲区中的序号是递增的, 所以遇到第一条不小于sequenceLimit的消息就停下, 它和之后的消息留给下一批
+    template <typename Visitor>
+    void drain(QByteArray &batch, const quint64 sequenceLimit, const Visitor &onRecord)
+    {
+        quint64 tail = _tail.load(std::memory_order_relaxed);
+        const quint64 head = _head.load(std::memory_order_acquire);
+        while (tail < head) {
+            LogRecordHeader header;
+            copyOut(tail, &header, sizeof(header));
+            if (header.sequence >= sequenceLimit) {
+                break;
+            }
+            const int offset = batch.size();
+            batch.resize(offset + int(header.size));
+            copyOut(tail + sizeof(header), batch.data() + offset, header.size);
+            onRecord(header.sequence, offset, int(header.size));
+            tail += sizeof(header) + header.size;
+        }
+        _tail.store(tail, std::memory_order_release);
+    }
+
+    bool isEmpty() const
+    {
+        return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_relaxed);
+    }
+
+    // 所属的线程已经退出, 不会再有写入
+    std::atomic_bool orphaned{false};
+    // 生产者正在写入的消息的序号的下界, 没有正在写入的消息时为NOT_IN_FLIGHT
+    std::atomic<quint64> inFlightSequence{NOT_IN_FLIGHT};
+
+private:
+    static size_t roundUpToPowerOfTwo(const int capacity)
+    {
+        size_t size = 1024;
+        while (size < size_t(capacity)) {
+            size <<= 1;
+        }
+        return size;
+    }
+
+    // 拷贝进/出缓冲区, 处理回绕
+    void copyIn(const quint64 position, const void *data, const size_t size)
+    {
+        const size_t offset = size_t(position & _mask);
+        const size_t first = qMin(size, _buffer.size() - offset);
+        std::memcpy(_buffer.data() + offset, data, first);
+        std::memcpy(_buffer.data(), static_cast<const char *>(data) + first, size - first);
+    }
+    void copyOut(const quint64 position, void *data, const size_t size) const
+    {
+        const size_t offset = size_t(position & _mask);
+        const size_t first = qMin(size, _buffer.size() - offset);
+        std::memcpy(data, _buffer.data() + offset, first);
+        std::memcpy(static_cast<char *>(data) + first, _buffer.data(), size - first);
+    }
+
+    std::vector<char> _buffer;
+    const quint64 _mask;
+    alignas(64) std::atomic<quint64> _head{0}; // 生产者写到了哪里
+    alignas(64) std::atomic<quint64> _tail{0}; // 消费者读到了哪里
+};
+
+// 线程退出时把它的缓冲区标记为无主, 后台线程取空之后释放
+struct ThreadRingHolder {
+    std::shared_ptr<LogRing> ring;
+
+    ~ThreadRingHolder()
+    {
+        if (ring) {
+            ring->orphaned = true;
+        }
+    }
+};
+static thread_local ThreadRingHolder t_ringHolder;
+
+static const char *typeTag(const QtMsgType type)
+{
+    switch (type) {
+    case QtInfoMsg:
+        return "[Info]";
+    case QtDebugMsg:
+        return "[Debug]";
+    case QtWarningMsg:
+        return "[Warning]";
+    case QtCriticalMsg:
+        return "[Critical]";
+    case QtFatalMsg:
+        return "[Fatal]";
+    }
+    return "";
+}
+
+AsyncLogger &AsyncLogger::instance()
+{
+    static AsyncLogger logger;
+    return logger;
+}
+
+AsyncLogger::AsyncLogger()
+{
+    _batch.reserve(BATCH_RESERVE_SIZE);
+    _output.reserve(BATCH_RESERVE_SIZE);
+    _thread = QThread::create([this]() {
+        run();
+    });
+    _running = true;
+    _thread->start();
+}
+
+AsyncLogger::~AsyncLogger()
+{
+    stop();
+    // 本对象析构之后不能再被调用, 如果装的是本类的消息处理函数, 就恢复Qt默认的
+    const QtMessageHandler previous = qInstallMessageHandler(nullptr);
+    if (previous != messageHandler && previous != MyMessageOutput) {
+        qInstallMessageHandler(previous);
+    }
+}
+
+void AsyncLogger::setOptions(const Options &options)
+{
+    QMutexLocker locker(&_mutex);
+    _options = options;
+    _wakeCondition.wakeAll();
+}
+
+AsyncLogger::Options AsyncLogger::options() const
+{
+    QMutexLocker locker(&_mutex);
+    return _options;
+}
+
+void AsyncLogger::log(QtMsgType type, const QMessageLogContext &context, const QString &message)
+{
+    // 日志信息类型和时间
+    QString text = typeTag(type);
+    text.append(QTime::currentTime().toString("[hh:mm:ss]"));
+    // 给日志添加上下文信息, 比如哪个文件, 哪一行
+    text.append(QString("[%1 %2] %3\n")
+                .arg(QFileInfo(context.file).fileName())
+                .arg(context.line)
+                .arg(message));
+    const QByteArray bytes = text.toUtf8();
+    if (!_running) {
+        std::fputs(bytes.constData(), stderr);
+        return;
+    }
+    LogRing *const ring = threadRing();
+    // 先登记正在写入(序号的下界), 再检查是否已停止, 最后取序号:
+    // 后台线程会等序号可能比它取的上限小的写入完成, 停止时会等所有登记过的写入完成, 所以消息既不会乱序, 也不会留在没人取的缓冲区里
+    ring->inFlightSequence.store(_sequence.load());
+    if (!_running) {
+        ring->inFlightSequence.store(NOT_IN_FLIGHT, std::memory_order_release);
+        std::fputs(bytes.constData(), stderr);
+        return;
+    }
+    if (!ring->push(_sequence++, bytes)) {
+        ++_droppedCount;
+    }
+    ring->inFlightSequence.store(NOT_IN_FLIGHT, std::memory_order_release);
+    if (QtFatalMsg == type) {
+        // 之后Qt会abort(), 先把日志写进文件
+        flush();
+    }
+}
+
+bool AsyncLogger::flush(const int timeoutMs)
+{
+    // 后台线程自己打的日志不能等自己写
+    if (!_running || QThread::currentThread() == _thread) {
+        return false;
+    }
+    QMutexLocker locker(&_mutex);
+    const quint64 request = ++_flushRequested;
+    _wakeCondition.wakeAll();
+    const QDeadlineTimer deadline(timeoutMs);
+    while (_flushCompleted < request) {
+        if (!_flushedCondition.wait(&_mutex, deadline)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void AsyncLogger::stop()
+{
+    if (!_running.exchange(false)) {
+        return;
+    }
+    {
+        QMutexLocker locker(&_mutex);
+        _stopping = true;
+        _wakeCondition.wakeAll();
+    }
+    _thread->wait();
+    delete _thread;
+    _thread = nullptr;
+    _file.close();
+}
+
+qint64 AsyncLogger::droppedCount() const
+{
+    return _droppedCount;
+}
+
+void AsyncLogger::messageHandler(QtMsgType type, const QMessageLogContext &context, const QString &message)
+{
+    instance().log(type, context, message);
+}
+
+LogRing *AsyncLogger::threadRing()
+{
+    if (!t_ringHolder.ring) {
+        QMutexLocker locker(&_mutex);
+        t_ringHolder.ring = std::make_shared<LogRing>(_options.ringCapacity);
+        _rings.push_back(t_ringHolder.ring);
+    }
+    return t_ringHolder.ring.get();
+}
+
+void AsyncLogger::run()
+{
+    QElapsedTimer cleanupTimer;
+    QMutexLocker locker(&_mutex);
+    forever {
+        const Options options = _options;
+        const bool stopping = _stopping;
+        // 在取消息之前记下请求, 保证请求之前产生的消息都在这一批中
+        const quint64 flushRequested = _flushRequested;
+        locker.unlock();
+
+        writeBatch(options, stopping);
+        if (!cleanupTimer.isValid() || cleanupTimer.elapsed() >= options.retentionInterval) {
+            // 删掉修改日期至今超过expireDays的文件
+            CleanExpiredFiles(options.logDir, options.expireDays);
+            cleanupTimer.start();
+        }
+
+        locker.relock();
+        _flushCompleted = flushRequested;
+        _flushedCondition.wakeAll();
+        if (stopping) {
+            break;
+        }
+        if (_flushRequested == _flushCompleted && !_stopping) {
+            _wakeCondition.wait(&_mutex, ulong(qMax(1, options.flushInterval)));
+        }
+    }
+}
+
+void AsyncLogger::writeBatch(const Options &options, const bool final)
+{
+    std::vector<std::shared_ptr<LogRing>> rings;
+    quint64 sequenceLimit = 0;
+    {
+        QMutexLocker locker(&_mutex);
+        // 先判断orphaned再判断isEmpty: 标记之后不会再有写入, 取空了就可以释放
+        _rings.erase(std::remove_if(_rings.begin(), _rings.end(), [](const std::shared_ptr<LogRing> &ring) {
+            return ring->orphaned && ring->isEmpty();
+        }), _rings.end());
+        rings = _rings;
+        // 在锁内取序号的上限: 之后才注册的缓冲区, 其中的消息的序号都不小于它
+        sequenceLimit = _sequence.load();
+    }
+
+    if (final) {
+        // 已经停止, 新的消息都直接输出到stderr. 等已经登记的写入完成, 然后全部取出
+        for (const std::shared_ptr<LogRing> &ring : rings) {
+            while (NOT_IN_FLIGHT != ring->inFlightSequence.load()) {
+                QThread::yieldCurrentThread();
+            }
+        }
+        sequenceLimit = NOT_IN_FLIGHT;
+    } else {
+        // 序号比上限小的消息可能还在写入(已经取了序号, 还没有放进缓冲区), 等它们完成. 只是几次拷贝, 很快
+        for (const std::shared_ptr<LogRing> &ring : rings) {
+            while (ring->inFlightSequence.load() < sequenceLimit) {
+                QThread::yieldCurrentThread();
+            }
+        }
+    }
+
+    // 只取序号小于上限的消息: 它们此时都已经在缓冲区中, 之后产生的消息的序号都不小于上限, 所以各批之间也是有序的
+    _batch.resize(0);
+    _records.clear();
+    for (const std::shared_ptr<LogRing> &ring : rings) {
+        ring->drain(_batch, sequenceLimit, [this](const quint64 sequence, const int offset, const int size) {
+            _records.push_back(LogRecord{sequence, offset, size});
+        });
+    }
+
+    _output.resize(0);
+    const qint64 droppedCount = _droppedCount;
+    if (droppedCount != _reportedDroppedCount) {
+        _output.append(QString("[Warning]%1[%2 %3] %4 log messages dropped, the ring buffer was full\n")
+                       .arg(QTime::currentTime().toString("[hh:mm:ss]"), QFileInfo(__FILE__).fileName())
+                       .arg(__LINE__)
+                       .arg(droppedCount - _reportedDroppedCount).toUtf8());
+        _reportedDroppedCount = droppedCount;
+    }
+    if (_records.empty() && _output.isEmpty()) {
+        return;
+    }
+    // 各线程的消息按产生的顺序合并
+    std::sort(_records.begin(), _records.end(), [](const LogRecord &lhs, const LogRecord &rhs) {
+        return lhs.sequence < rhs.sequence;
+    });
+    for (const LogRecord &record : _records) {
+        _output.append(_batch.constData() + record.offset, record.size);
+    }
+
+    if (!openLogFile(options, _output.size())) {
+        std::fwrite(_output.constData(), 1, size_t(_output.size()), stderr);
+        return;
+    }
+    _file.write(_output);
+    _file.flush();
+}
+
+bool AsyncLogger::openLogFile(const Options &options, const qint64 incomingSize)
+{
+    const QString date = QDate::currentDate().toString("yyyy-MM-dd");
+    const QDir dir(options.logDir);
+    const auto pathOf = [&dir, &date](const int index) {
+        return dir.filePath(0 == index ? date + ".txt" : QString("%1.%2.txt").arg(date).arg(index));
+    };
+    if (!_file.isOpen() || date != _fileDate || _file.fileName() != pathOf(_fileIndex)) {
+        // 第一次写, 换了一天, 或者换了日志目录: 从当天第一个没有写满的文件开始
+        _file.close();
+        _fileDate = date;
+        _fileIndex = 0;
+        dir.mkpath(".");
+        while (QFileInfo(pathOf(_fileIndex)).size() >= options.maxFileSize) {
+            ++_fileIndex;
+        }
+    } else if (_file.size() > 0 && _file.size() + incomingSize > options.maxFileSize) {
+        // 写满了, 换下一个文件
+        _file.close();
+        ++_fileIndex;
+    }
+    if (!_file.isOpen()) {
+        _file.setFileName(pathOf(_fileIndex));
+        // Text: 如果是Windows系统, 将\n转换为\r\n
+        if (!_file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text)) {
+            return false;
+        }
+    }
+    return true;
+}
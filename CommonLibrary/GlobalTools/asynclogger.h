@@ -0,0 +1,104 @@
+﻿#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <QByteArray>
+#include <QFile>
+#include <QMutex>
+#include <QString>
+#include <QWaitCondition>
+
+class QThread;
+class LogRing;
+
+/*!
+ * \brief The AsyncLogger class 异步日志. 消息处理函数只负责格式化并放进本线程的环形缓冲区, 由后台线程批量写文件
+ * \note
+ * - 每个打日志的线程有自己的单生产者单消费者环形缓冲区, 写入不加锁(只有线程第一次打日志时注册一次);
+ * - 后台线程每隔flushInterval, 或有人调用flush()时, 取出所有缓冲区的消息, 按产生的顺序合并后一次写入.
+ *   取了序号还没放进缓冲区的消息会被等待, 所以文件中所有消息(包括跨批次的)都按序号排列.
+ *   日志文件一直打开, 不再每条消息打开关闭一次;
+ * - 按日期换文件, 同一天的文件超过maxFileSize时换成yyyy-MM-dd.1.txt, yyyy-MM-dd.2.txt, ...;
+ * - 过期日志的清理(CleanExpiredFiles)在后台线程中按retentionInterval定时进行, 不再每条消息都遍历目录;
+ * - 缓冲区满时丢弃新消息并计数, 后台线程会把丢弃的条数写进日志;
+ * - Fatal消息会先flush(), 保证崩溃之前的日志都已写入文件
+ *
+ * 用法: qInstallMessageHandler(AsyncLogger::messageHandler), 或者继续用MyMessageOutput(已改为转调本类).
+ * 程序退出前可以调用stop(), 否则在静态对象析构时停止. 与stop()同时打的日志要么写进文件, 要么输出到stderr, 不会丢失
+ */
+class AsyncLogger
+{
+public:
+    struct Options {
+        QString logDir = "./logs/";
+        qint64 maxFileSize = 64 * 1024 * 1024; // 单个日志文件的大小上限(字节)
+        int expireDays = 60; // 修改日期至今超过这么多天的文件会被删掉
+        int retentionInterval = 60 * 60 * 1000; // 多久清理一次过期文件(毫秒)
+        int flushInterval = 200; // 多久写一次文件(毫秒)
+        int ringCapacity = 256 * 1024; // 每个线程的缓冲区大小(字节), 会向上取整为2的幂. 只影响之后新建的缓冲区
+    };
+
+    static AsyncLogger &instance();
+    ~AsyncLogger();
+
+    // 可以在任意时刻设置, 从下一次写文件开始生效
+    void setOptions(const Options &options);
+    Options options() const;
+
+    // 格式化一条消息并放进本线程的缓冲区. 格式同原来的MyMessageOutput: [类型][时间][文件 行号] 内容
+    void log(QtMsgType type, const QMessageLogContext &context, const QString &message);
+    // 阻塞直到调用之前产生的消息都已写入文件. 最多等timeoutMs毫秒, 超时返回false
+    bool flush(const int timeoutMs = 5000);
+    // 写完所有消息, 停止后台线程. 之后的消息直接输出到stderr
+    void stop();
+
+    // 因缓冲区满而丢弃的消息数
+    qint64 droppedCount() const;
+
+    // 用于qInstallMessageHandler
+    static void messageHandler(QtMsgType type, const QMessageLogContext &context, const QString &message);
+
+private:
+    AsyncLogger();
+    Q_DISABLE_COPY(AsyncLogger)
+
+    // 本线程的缓冲区, 第一次调用时创建并注册
+    LogRing *threadRing();
+    // 后台线程
+    void run();
+    // 取出所有缓冲区的消息并写入文件. final为true时是停止前的最后一批
+    void writeBatch(const Options &options, const bool final);
+    // 按日期和大小决定当前应该写的文件
+    bool openLogFile(const Options &options, const qint64 incomingSize);
+
+    mutable QMutex _mutex; // 保护_options, _stopping, 两个flush计数和_rings
+    QWaitCondition _wakeCondition; // 唤醒后台线程
+    QWaitCondition _flushedCondition; // 后台线程完成了一次写入
+    Options _options;
+    bool _stopping = false;
+    quint64 _flushRequested = 0;
+    quint64 _flushCompleted = 0;
+    std::vector<std::shared_ptr<LogRing>> _rings;
+
+    std::atomic_bool _running{false};
+    std::atomic<quint64> _sequence{0}; // 消息的全局序号, 用于合并各线程的消息
+    std::atomic<qint64> _droppedCount{0};
+
+    // 以下只在后台线程中访问
+    // 一条消息在_batch中的位置
+    struct LogRecord {
+        quint64 sequence;
+        int offset;
+        int size;
+    };
+    QByteArray _batch; // 从各缓冲区取出的消息, 按缓冲区排列
+    std::vector<LogRecord> _records;
+    QByteArray _output; // 按序号合并之后要写入的内容. 这三个每次写入都复用, 不重新分配
+    qint64 _reportedDroppedCount = 0; // 已经写进日志的丢弃数
+    QFile _file;
+    QString _fileDate; // 当前文件的日期, yyyy-MM-dd
+    int _fileIndex = 0; // 同一天的第几个文件
+
+    QThread *_thread = nullptr;
+};
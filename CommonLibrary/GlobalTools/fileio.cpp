@@ -0,0 +1,301 @@
+﻿#include "fileio.h"
+#include <climits>
+#include <cstring>
+#include <QSaveFile>
+#include "CommonLibrary/GlobalTools/globaltools.h"
+
+MappedFile::MappedFile(const QString &filePath)
+{
+    open(filePath);
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const QString &filePath)
+{
+    close();
+    _file.setFileName(filePath);
+    if (!_file.open(QIODevice::ReadOnly)) {
+        _errorString = _file.errorString();
+        return false;
+    }
+    _size = _file.size();
+    // 空文件不能映射
+    if (_size > 0) {
+        _data = _file.map(0, _size);
+        if (nullptr == _data) {
+            _errorString = _file.errorString();
+            _file.close();
+            _size = 0;
+            return false;
+        }
+    }
+    _isOpen = true;
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (nullptr != _data) {
+        _file.unmap(_data);
+        _data = nullptr;
+    }
+    _file.close();
+    _size = 0;
+    _isOpen = false;
+}
+
+bool MappedFile::isOpen() const
+{
+    return _isOpen;
+}
+
+QString MappedFile::errorString() const
+{
+    return _errorString;
+}
+
+std::string_view MappedFile::view() const
+{
+    return nullptr == _data ? std::string_view() : std::string_view(reinterpret_cast<const char *>(_data), size_t(_size));
+}
+
+QByteArray MappedFile::bytes() const
+{
+    if (nullptr == _data || _size > INT_MAX) {
+        return QByteArray();
+    }
+    return QByteArray::fromRawData(reinterpret_cast<const char *>(_data), int(_size));
+}
+
+qint64 MappedFile::size() const
+{
+    return _size;
+}
+
+LineReader::LineReader(const QString &filePath, const char delimiter, const int chunkSize)
+    : _file(filePath), _delimiter(delimiter), _chunkSize(qMax(1, chunkSize))
+{
+    if (!_file.open(QIODevice::ReadOnly)) {
+        _hasError = true;
+        _errorString = _file.errorString();
+        _atEnd = true;
+    }
+}
+
+bool LineReader::isOpen() const
+{
+    return _file.isOpen();
+}
+
+bool LineReader::hasError() const
+{
+    return _hasError;
+}
+
+QString LineReader::errorString() const
+{
+    return _errorString;
+}
+
+bool LineReader::readLine(std::string_view &line)
+{
+    forever {
+        const char *const begin = _buffer.data() + _begin;
+        const size_t available = _end - _begin;
+        const void *const found = available > _scanned ? std::memchr(begin + _scanned, _delimiter, available - _scanned) : nullptr;
+        size_t length = 0;
+        if (nullptr != found) {
+            length = size_t(static_cast<const char *>(found) - begin);
+            _begin += length + 1;
+        } else if (_atEnd) {
+            // 最后一行可能没有分隔符
+            if (0 == available) {
+                return false;
+            }
+            length = available;
+            _begin = _end;
+        } else {
+            _scanned = available;
+            if (!fill()) {
+                return false;
+            }
+            continue;
+        }
+        _scanned = 0;
+        if ('\n' == _delimiter && length > 0 && '\r' == begin[length - 1]) {
+            --length;
+        }
+        line = std::string_view(begin, length);
+        ++_lineNumber;
+        return true;
+    }
+}
+
+qint64 LineReader::lineNumber() const
+{
+    return _lineNumber;
+}
+
+bool LineReader::fill()
+{
+    const size_t available = _end - _begin;
+    if (_begin > 0) {
+        std::memmove(_buffer.data(), _buffer.data() + _begin, available);
+        _begin = 0;
+        _end = available;
+    }
+    // 行比缓冲区长时扩大缓冲区
+    if (_buffer.size() < _end + size_t(_chunkSize)) {
+        _buffer.resize(_end + size_t(_chunkSize));
+    }
+    const qint64 count = _file.read(_buffer.data() + _end, _chunkSize);
+    if (count < 0) {
+        _hasError = true;
+        _errorString = _file.errorString();
+        _atEnd = true;
+        return false;
+    }
+    _end += size_t(count);
+    _atEnd = 0 == count;
+    return true;
+}
+
+BufferedFileWriter::BufferedFileWriter(const QString &filePath) : BufferedFileWriter(filePath, Options())
+{
+}
+
+BufferedFileWriter::BufferedFileWriter(const QString &filePath, const Options &options) : _options(options)
+{
+    QIODevice::OpenMode mode = QIODevice::WriteOnly;
+    if (Mode::Append == options.mode) {
+        _file.reset(new QFile(filePath));
+        mode |= QIODevice::Append;
+    } else {
+        _file.reset(new QSaveFile(filePath));
+    }
+    if (options.text) {
+        mode |= QIODevice::Text;
+    }
+    if (!OpenFileForWriting(*_file, mode)) {
+        setError(_file->errorString());
+        return;
+    }
+    // reserve()过的QByteArray在resize(0)时不释放内存
+    _buffer.reserve(options.bufferSize);
+}
+
+BufferedFileWriter::~BufferedFileWriter()
+{
+    if (Mode::Append == _options.mode && _file->isOpen()) {
+        flushBuffer();
+    }
+    // 没有commit()的QSaveFile析构时删除临时文件, 目标文件不变
+}
+
+bool BufferedFileWriter::isOpen() const
+{
+    return _file->isOpen();
+}
+
+bool BufferedFileWriter::hasError() const
+{
+    return _hasError;
+}
+
+QString BufferedFileWriter::errorString() const
+{
+    return _errorString;
+}
+
+bool BufferedFileWriter::write(const QString &text)
+{
+    return write(text.toUtf8());
+}
+
+bool BufferedFileWriter::write(const std::string_view &bytes)
+{
+    if (_hasError || !_file->isOpen()) {
+        return false;
+    }
+    if (_buffer.size() + qint64(bytes.size()) > _options.bufferSize) {
+        if (!flushBuffer()) {
+            return false;
+        }
+        // 大块的内容直接写入文件
+        if (qint64(bytes.size()) >= _options.bufferSize) {
+            if (_file->write(bytes.data(), qint64(bytes.size())) != qint64(bytes.size())) {
+                setError(_file->errorString());
+                return false;
+            }
+            return true;
+        }
+    }
+    _buffer.append(bytes.data(), int(bytes.size()));
+    return true;
+}
+
+bool BufferedFileWriter::write(const QByteArray &bytes)
+{
+    return write(std::string_view(bytes.constData(), size_t(bytes.size())));
+}
+
+QIODevice *BufferedFileWriter::device()
+{
+    flushBuffer();
+    return _file.get();
+}
+
+bool BufferedFileWriter::commit()
+{
+    if (_hasError || !_file->isOpen()) {
+        if (QSaveFile *saveFile = qobject_cast<QSaveFile *>(_file.get())) {
+            saveFile->cancelWriting();
+        }
+        return false;
+    }
+    if (!flushBuffer()) {
+        return false;
+    }
+    if (QSaveFile *saveFile = qobject_cast<QSaveFile *>(_file.get())) {
+        if (!saveFile->commit()) {
+            setError(saveFile->errorString());
+            return false;
+        }
+        return true;
+    }
+    if (!_file->flush()) {
+        setError(_file->errorString());
+        return false;
+    }
+    _file->close();
+    return true;
+}
+
+bool BufferedFileWriter::flushBuffer()
+{
+    if (_hasError) {
+        return false;
+    }
+    if (_buffer.isEmpty()) {
+        return true;
+    }
+    if (_file->write(_buffer) != _buffer.size()) {
+        setError(_file->errorString());
+        return false;
+    }
+    _buffer.resize(0);
+    return true;
+}
+
+void BufferedFileWriter::setError(const QString &message)
+{
+    if (!_hasError) {
+        _hasError = true;
+        _errorString = QString("%1: %2").arg(_file->fileName(), message);
+        qWarning().noquote() << "Write file failed:" << _errorString;
+    }
+}
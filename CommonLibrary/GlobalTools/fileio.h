@@ -0,0 +1,137 @@
+﻿#pragma once
+
+#include <memory>
+#include <string_view>
+#include <vector>
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+
+/*!
+ * \brief The MappedFile class 把整个文件只读地映射到内存, 内容以视图返回, 不读入也不拷贝
+ * \note 哪些页常驻内存由操作系统的页缓存决定, 所以大文件也不会一次占满内存. 视图只在本对象打开期间有效
+ */
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    explicit MappedFile(const QString &filePath);
+    ~MappedFile();
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    bool open(const QString &filePath);
+    void close();
+    bool isOpen() const;
+    QString errorString() const;
+
+    // 文件的全部内容. 空文件返回空视图
+    std::string_view view() const;
+    // 不拷贝的QByteArray(QByteArray::fromRawData). QByteArray最大2GB, 超过时返回空
+    QByteArray bytes() const;
+    qint64 size() const;
+
+private:
+    QFile _file;
+    uchar *_data = nullptr;
+    qint64 _size = 0;
+    bool _isOpen = false;
+    QString _errorString;
+};
+
+/*!
+ * \brief The LineReader class 分块读取文本文件, 逐行(或逐条记录)返回
+ * \note 每次从文件读取chunkSize字节到复用的缓冲区, 返回的行是缓冲区的视图, 只在下一次readLine()之前有效.
+ * 内存占用与文件大小无关, 只与chunkSize和最长的行有关
+ */
+class LineReader
+{
+public:
+    /*!
+     * \brief LineReader
+     * \param filePath
+     * \param delimiter 记录的分隔符. 是'\n'时同时去掉行尾的'\r', 与文本模式(QIODevice::Text)读取的结果相同
+     * \param chunkSize 每次读取的字节数
+     */
+    explicit LineReader(const QString &filePath, const char delimiter = '\n', const int chunkSize = 1024 * 1024);
+
+    bool isOpen() const;
+    bool hasError() const;
+    QString errorString() const;
+
+    // 读取下一行(不含分隔符). 读完或出错时返回false
+    bool readLine(std::string_view &line);
+    // 已经读取的行数
+    qint64 lineNumber() const;
+
+private:
+    // 把没读完的内容移到缓冲区开头, 再从文件读取一块. 出错时返回false
+    bool fill();
+
+    QFile _file;
+    const char _delimiter;
+    const int _chunkSize;
+    std::vector<char> _buffer;
+    size_t _begin = 0; // 缓冲区中未返回的内容[_begin, _end)
+    size_t _end = 0;
+    size_t _scanned = 0; // 从_begin开始已经找过分隔符的字节数
+    bool _atEnd = false;
+    qint64 _lineNumber = 0;
+    bool _hasError = false;
+    QString _errorString;
+};
+
+/*!
+ * \brief The BufferedFileWriter class 带缓冲区的文件写入器
+ * \note
+ * - AtomicReplace(默认): 先写临时文件(QSaveFile), commit()时改名替换目标文件. 中途出错或没有commit()时目标文件不变;
+ * - Append: 追加到目标文件, 析构时写入剩余的内容;
+ * - 内容先写进复用的缓冲区, 满了才写入文件, 所以很多次小的写入只有很少的系统调用;
+ * - 目录用MakeMultiLevelDirCached创建, 同一目录只检查一次
+ */
+class BufferedFileWriter
+{
+public:
+    enum class Mode : int {
+        AtomicReplace,
+        Append,
+    };
+    struct Options {
+        Mode mode = Mode::AtomicReplace;
+        bool text = true; // 文本模式(QIODevice::Text), 在Windows上把\n转换为\r\n, 与WriteFile相同
+        int bufferSize = 1024 * 1024;
+    };
+
+    explicit BufferedFileWriter(const QString &filePath);
+    BufferedFileWriter(const QString &filePath, const Options &options);
+    // Append时写入剩余的内容; AtomicReplace时如果没有commit(), 放弃写入的内容
+    ~BufferedFileWriter();
+    BufferedFileWriter(const BufferedFileWriter &) = delete;
+    BufferedFileWriter &operator=(const BufferedFileWriter &) = delete;
+
+    bool isOpen() const;
+    bool hasError() const;
+    QString errorString() const;
+
+    // 写入utf-8编码的text
+    bool write(const QString &text);
+    bool write(const std::string_view &bytes);
+    bool write(const QByteArray &bytes);
+    /*!
+     * \brief device 写入缓冲区中的内容, 返回底层的文件, 用于自带缓冲区的写入器(比如JsonWriter).
+     * 之后再用write()时要先flush()那个写入器
+     */
+    QIODevice *device();
+    // 写入剩余的内容. AtomicReplace时替换目标文件. 之后不能再写入
+    bool commit();
+
+private:
+    bool flushBuffer();
+    void setError(const QString &message);
+
+    const Options _options;
+    std::unique_ptr<QFileDevice> _file; // AtomicReplace时是QSaveFile, Append时是QFile
+    QByteArray _buffer;
+    bool _hasError = false;
+    QString _errorString;
+};
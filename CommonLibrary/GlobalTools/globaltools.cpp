@@ -1,10 +1,12 @@
 ﻿#include "globaltools.h"
+#include "asynclogger.h"
 #include <filesystem>
 
 #include <QRegularExpressionMatch>
+#include <QReadWriteLock>
+#include <QSet>
 #include <QJsonDocument>
 #include <QDate>
-#include <QMutex>
 
 void CleanExpiredFiles(const QString &dir_path, const int expire_days)
 {
@@ -27,62 +29,8 @@ void CleanExpiredFiles(const QString &dir_path, const int expire_days)
 // 日志工具
 void MyMessageOutput(QtMsgType msg_type, const QMessageLogContext &context, const QString &msg)
 {
-    // 日志信息类型
-    QString text;
-    switch (msg_type) {
-    case QtInfoMsg:
-        text = "[Info]";
-        break;
-    case QtDebugMsg:
-        text = "[Debug]";
-        break;
-    case QtWarningMsg:
-        text = "[Warning]";
-        break;
-    case QtCriticalMsg:
-        text = "[Critical]";
-        break;
-    case QtFatalMsg:
-        text = "[Fatal]";
-        break;
-    }
-    // 时间
-    text.append(QTime::currentTime().toString("[hh:mm:ss]"));
-    // 给日志添加上下文信息, 比如哪个文件, 哪一行, 哪一个函数
-    text.append(QString("[%1 %2] %3\n")
-                .arg(QFileInfo(context.file).fileName())
-                .arg(context.line)
-                .arg(msg));
-//                .arg(CaptureContent(context.function, " ([\\S]+?)\\(")) // 提取函数名 -> 有了文件名和行数, 函数名就不需要了
-    // 日志文件所在目录
-    static const QString LOG_DIR = "./logs/";
-    const QDir dir(LOG_DIR);
-    if (!dir.exists()) {
-        // 如果不存在该路径, 创建到该路径的所有文件夹
-        dir.mkpath(".");
-    }
-    // 根据日期构造日志文件路径
-    const QString path_forLogFile = QString("%1%2")
-                                    .arg(LOG_DIR,
-                                         QDate::currentDate().toString("yyyy-MM-dd'.txt'"));
-
-    // 互斥量, 以防有多线程调用
-    static QMutex mutex_forlogFile;
-    {
-        QMutexLocker locker(&mutex_forlogFile); // locker构造, 自动加锁
-        // 写入文件
-        if (QFile logFile(path_forLogFile);
-                logFile.open(QIODevice::WriteOnly //只写
-                             | QIODevice::Append // 添加而不是覆盖
-                             | QIODevice::Text)) { // 如果是Linux系统, 将\r\n转换为\n; 如果是Window系统, 将\n转换为\r\n. 其实这处理也不是很完美, 但总好过没有;)
-            // 如果打开成功, 就写入将内容文件
-            QTextStream textStream(&logFile);
-            textStream << text;
-        } // textStream析构, 自动flush到logFile; 然后logFile析构, 自动close, 从而flush到log文件
-    } // locker析构, 自动解锁
-
-    // 删掉LOG_DIR中修改日期至今超过expire_days的文件
-    CleanExpiredFiles(LOG_DIR, 60);
+    // 只格式化并放进本线程的缓冲区, 由后台线程写文件和清理过期文件
+    AsyncLogger::instance().log(msg_type, context, msg);
 }
 
 /* 文件夹相关 */
@@ -110,6 +58,25 @@ bool MakeMultiLevelDirSilently(const QString &file_path)
     QDir dir;
     return dir.mkpath(QFileInfo(file_path).path());
 }
+// 静默版本, 记住已经存在或创建过的目录
+bool MakeMultiLevelDirCached(const QString &file_path)
+{
+    static QReadWriteLock lock;
+    static QSet<QString> existing_dirs;
+    const QString dir_path = QFileInfo(file_path).path();
+    {
+        QReadLocker locker(&lock);
+        if (existing_dirs.contains(dir_path)) {
+            return true;
+        }
+    }
+    if (!QDir().mkpath(dir_path)) {
+        return false;
+    }
+    QWriteLocker locker(&lock);
+    existing_dirs.insert(dir_path);
+    return true;
+}
 
 
 
@@ -144,12 +111,10 @@ QByteArray ReadFile(const QString &file_path)
 // 将content保存在file_path
 bool WriteFile(const QString &filePath, const QString &content)
 {
-    // 创建直到目标文件的多级目录
-    MakeMultiLevelDir(filePath);
-    // 写入文件
+    // 写入文件, 需要时创建直到目标文件的多级目录
     QFile file(filePath);
-    if (!file.open(QIODevice::WriteOnly
-                   | QIODevice::Text)) {
+    if (!OpenFileForWriting(file, QIODevice::WriteOnly
+                            | QIODevice::Text)) {
         qWarning().noquote() << "Open file failed:" << filePath;
         return false;
     }
@@ -163,12 +128,10 @@ bool WriteFile(const QString &filePath, const QString &content)
 
 bool AppendFile(const QString &file_path, const QString &content)
 {
-    // 创建直到目标文件的多级目录
-    MakeMultiLevelDir(file_path);
-    // 写入文件
+    // 写入文件, 需要时创建直到目标文件的多级目录
     QFile file(file_path);
-    if (!file.open(QIODevice::Append
-                   | QIODevice::Text)) {
+    if (!OpenFileForWriting(file, QIODevice::Append
+                            | QIODevice::Text)) {
         qWarning().noquote() << "Open file failed:" << file_path;
         return false;
     }
@@ -180,6 +143,17 @@ bool AppendFile(const QString &file_path, const QString &content)
     return true;
 }
 
+bool OpenFileForWriting(QFileDevice &file, const QIODevice::OpenMode mode)
+{
+    // 已经检查过的目录不再检查
+    MakeMultiLevelDirCached(file.fileName());
+    if (file.open(mode)) {
+        return true;
+    }
+    MakeMultiLevelDir(file.fileName());
+    return file.open(mode);
+}
+
 /* 字符串转码相关 */
 QString gbk_to_utf8(const std::string &vs_string)
 {
@@ -213,11 +187,58 @@ QString MakePattern(const DataExchangFormat &text_format, const QString &key)
     return "";
 }
 
-// 利用正则表达式从文本(xml或json)中获取内容(获取第一个), 直接根据构造搜索模式
-const QString CaptureContent(const QString &text, const QString &pattern)
+// 编译好的正则表达式的缓存, 线程安全. 超过上限时整个清空(模式通常来自有限的几组关键字, 很少会超过)
+constexpr int MAX_CACHED_REGULAR_EXPRESSIONS = 1024;
+template <typename Key>
+class RegularExpressionCache
+{
+public:
+    template <typename MakePatternFunction>
+    QRegularExpression get(const Key &key, const MakePatternFunction &makePattern)
+    {
+        {
+            QReadLocker locker(&_lock);
+            const auto it = _expressions.constFind(key);
+            if (_expressions.constEnd() != it) {
+                return *it;
+            }
+        }
+        // 在锁外编译. 两个线程同时编译同一模式也没关系, 结果一样
+        QRegularExpression regular_expression(makePattern());
+        // 立即编译并JIT优化, 之后的拷贝共享编译结果
+        regular_expression.optimize();
+        QWriteLocker locker(&_lock);
+        if (_expressions.size() >= MAX_CACHED_REGULAR_EXPRESSIONS) {
+            _expressions.clear();
+        }
+        _expressions.insert(key, regular_expression);
+        return regular_expression;
+    }
+
+private:
+    QReadWriteLock _lock;
+    QHash<Key, QRegularExpression> _expressions;
+};
+
+QRegularExpression CachedRegularExpression(const QString &pattern)
+{
+    static RegularExpressionCache<QString> cache;
+    return cache.get(pattern, [&pattern]() {
+        return pattern;
+    });
+}
+
+QRegularExpression CachedRegularExpression(const DataExchangFormat &text_format, const QString &key)
+{
+    static RegularExpressionCache<QPair<int, QString>> cache;
+    return cache.get(qMakePair(int(text_format), key), [&text_format, &key]() {
+        return MakePattern(text_format, key);
+    });
+}
+
+// 用编译好的正则表达式获取内容(获取第一个)
+static QString CaptureContent(const QString &text, const QRegularExpression &regular_expression)
 {
-    // 构造正则表达式
-    QRegularExpression regular_expression(pattern);
     // 搜索目标内容
     QRegularExpressionMatch match = regular_expression.match(text);
     // 字符串, 用于存储返回值
@@ -229,26 +250,15 @@ const QString CaptureContent(const QString &text, const QString &pattern)
         // 如果没有匹配到, 输出日志提示
         qInfo().noquote() << "Nothing matched:"
 //                          << "\n\ttext=" << text
-                          << "\n\tpattern=" << pattern;
+                          << "\n\tpattern=" << regular_expression.pattern();
     }
     // 如果匹配到了, 会返回对应的内容, 如果没有匹配到, 返回的是一个null的QString
     return content;
 }
 
-// 利用正则表达式从文本(xml或json)中获取内容(获取第一个), 根据数据交换类型和关键字来构造搜索模式
-const QString CaptureContent(const QString &text, const DataExchangFormat &text_format,
-                             const QString &key)
+// 用编译好的正则表达式获取内容(获取所有)
+static QStringList CaptureContents(const QString &text, const QRegularExpression &regular_expression)
 {
-    // 构造搜索模式
-    QString pattern = MakePattern(text_format, key);
-    return CaptureContent(text, pattern);
-}
-
-// 利用正则表达式从文本(xml或json)中获取内容(获取所有), 直接根据构造搜索模式
-const QStringList CaptureContents(const QString &text, const QString &pattern)
-{
-    // 构造正则表达式
-    QRegularExpression regular_expression(pattern);
     // 搜索目标内容
     QRegularExpressionMatchIterator it = regular_expression.globalMatch(text);
     // 字符串列表, 用于存储返回值
@@ -264,19 +274,187 @@ const QStringList CaptureContents(const QString &text, const QString &pattern)
         // 如果没有匹配到, 输出日志提示
         qInfo().noquote() << "Nothing matched:"
 //                          << "\n\ttext=" << text
-                          << "\n\tpattern=" << pattern;
+                          << "\n\tpattern=" << regular_expression.pattern();
     }
     // 如果没有匹配到, 返回的是一个空的字符串列表
     return contents;
 }
 
+// 利用正则表达式从文本(xml或json)中获取内容(获取第一个), 直接根据构造搜索模式
+const QString CaptureContent(const QString &text, const QString &pattern)
+{
+    return CaptureContent(text, CachedRegularExpression(pattern));
+}
+
+// 利用正则表达式从文本(xml或json)中获取内容(获取第一个), 根据数据交换类型和关键字来构造搜索模式
+const QString CaptureContent(const QString &text, const DataExchangFormat &text_format,
+                             const QString &key)
+{
+    return CaptureContent(text, CachedRegularExpression(text_format, key));
+}
+
+// 利用正则表达式从文本(xml或json)中获取内容(获取所有), 直接根据构造搜索模式
+const QStringList CaptureContents(const QString &text, const QString &pattern)
+{
+    return CaptureContents(text, CachedRegularExpression(pattern));
+}
+
 // 利用正则表达式从文本(xml或json)中获取内容(获取所有)
 const QStringList CaptureContents(const QString &text, const DataExchangFormat &text_format,
                                   const QString &key)
 {
-    // 构造搜索模式
-    QString pattern = MakePattern(text_format, key);
-    return CaptureContents(text, pattern);
+    return CaptureContents(text, CachedRegularExpression(text_format, key));
+}
+
+// 正则表达式中\s匹配的字符(没有UseUnicodePropertiesOption时)
+static bool IsRegexSpace(const QChar c)
+{
+    const ushort u = c.unicode();
+    return ' ' == u || ('\t' <= u && u <= '\r');
+}
+
+static bool IsQuote(const QChar c)
+{
+    return '\'' == c || '"' == c;
+}
+
+// 一次遍历json文本. 每个引号都是候选的起点, 到下一个引号之间的内容是候选的关键字,
+// 之后的部分同模式['"]key['"]\s*:\s*['"]([^'"\n]+?)['"]
+static void CaptureJsonContents(const QString &text, const QHash<QStringView, int> &key_indexes,
+                                QVector<QStringList> &contents)
+{
+    const QChar *const data = text.constData();
+    const int length = text.size();
+    // 每个关键字上次匹配的结尾. 同globalMatch, 同一关键字的匹配不重叠
+    QVector<int> next_starts(contents.size(), 0);
+    int i = 0;
+    while (i < length) {
+        if (!IsQuote(data[i])) {
+            ++i;
+            continue;
+        }
+        int key_end = i + 1;
+        while (key_end < length && !IsQuote(data[key_end])) {
+            ++key_end;
+        }
+        if (key_end >= length) {
+            break;
+        }
+        const auto it = key_indexes.constFind(QStringView(data + i + 1, key_end - i - 1));
+        if (key_indexes.constEnd() != it && i >= next_starts[*it]) {
+            int k = key_end + 1;
+            while (k < length && IsRegexSpace(data[k])) {
+                ++k;
+            }
+            if (k < length && ':' == data[k]) {
+                ++k;
+                while (k < length && IsRegexSpace(data[k])) {
+                    ++k;
+                }
+                if (k < length && IsQuote(data[k])) {
+                    const int value_start = k + 1;
+                    int value_end = value_start;
+                    while (value_end < length && !IsQuote(data[value_end]) && '\n' != data[value_end]) {
+                        ++value_end;
+                    }
+                    if (value_end < length && IsQuote(data[value_end]) && value_end > value_start) {
+                        contents[*it].append(text.mid(value_start, value_end - value_start));
+                        next_starts[*it] = value_end + 1;
+                    }
+                }
+            }
+        }
+        // 候选关键字中没有引号, 下一个候选就从它的右引号开始
+        i = key_end;
+    }
+}
+
+// 一次遍历xml文本. 每个'<'都是候选的起点, 之后的部分同模式<key[^>]*>\s*([\s\S]+?)\s*</key>
+static void CaptureXmlContents(const QString &text, const QStringList &keys,
+                               const QHash<QStringView, int> &key_indexes, QVector<QStringList> &contents)
+{
+    const QChar *const data = text.constData();
+    const int length = text.size();
+    QStringList closing_tags;
+    for (const QString &key : keys) {
+        closing_tags << QString("</%1>").arg(key);
+    }
+    // 每个关键字上次匹配的结尾. 同globalMatch, 同一关键字的匹配不重叠; 不同关键字的可以嵌套
+    QVector<int> next_starts(contents.size(), 0);
+    for (int i = text.indexOf('<'); i >= 0; i = text.indexOf('<', i + 1)) {
+        // 标签名到空白字符, '>'或'/'为止
+        int name_end = i + 1;
+        while (name_end < length && !IsRegexSpace(data[name_end]) && '>' != data[name_end] && '/' != data[name_end]) {
+            ++name_end;
+        }
+        const auto it = key_indexes.constFind(QStringView(data + i + 1, name_end - i - 1));
+        if (key_indexes.constEnd() == it || i < next_starts[*it]) {
+            continue;
+        }
+        const int tag_end = text.indexOf('>', name_end);
+        if (tag_end < 0) {
+            break;
+        }
+        if ('/' == data[tag_end - 1]) {
+            // 空元素<key/>
+            continue;
+        }
+        const int closing = text.indexOf(closing_tags.at(*it), tag_end + 1);
+        if (closing < 0) {
+            continue;
+        }
+        int content_start = tag_end + 1;
+        int content_end = closing;
+        while (content_start < content_end && IsRegexSpace(data[content_start])) {
+            ++content_start;
+        }
+        while (content_end > content_start && IsRegexSpace(data[content_end - 1])) {
+            --content_end;
+        }
+        if (content_start < content_end) {
+            contents[*it].append(text.mid(content_start, content_end - content_start));
+            next_starts[*it] = closing + closing_tags.at(*it).size();
+        }
+    }
+}
+
+QHash<QString, QStringList> CaptureMultipleContents(const QString &text,
+                                                    const DataExchangFormat &text_format, const QStringList &keys)
+{
+    // 关键字 -> 下标. QStringView指向keys中的字符串, 查找时不用构造QString
+    QHash<QStringView, int> key_indexes;
+    key_indexes.reserve(keys.size());
+    for (int i = 0; i < keys.size(); ++i) {
+        if (!key_indexes.contains(QStringView(keys.at(i)))) {
+            key_indexes.insert(QStringView(keys.at(i)), i);
+        }
+    }
+    QVector<QStringList> contents(keys.size());
+    switch (text_format) {
+    case DataExchangFormat::JSON:
+        CaptureJsonContents(text, key_indexes, contents);
+        break;
+    case DataExchangFormat::XML:
+        CaptureXmlContents(text, keys, key_indexes, contents);
+        break;
+    }
+
+    QHash<QString, QStringList> result;
+    QStringList missing_keys;
+    for (const QString &key : keys) {
+        const QStringList &key_contents = contents.at(key_indexes.value(QStringView(key)));
+        if (key_contents.isEmpty()) {
+            missing_keys << key;
+        } else {
+            result.insert(key, key_contents);
+        }
+    }
+    if (!missing_keys.isEmpty()) {
+        // 如果没有匹配到, 输出日志提示
+        qInfo().noquote() << "Nothing matched:"
+                          << "\n\tkeys=" << missing_keys.join(", ");
+    }
+    return result;
 }
 
 /* json相关 */
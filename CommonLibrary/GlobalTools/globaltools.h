@@ -5,10 +5,10 @@
 #include <QDate>
 #include <QTime>
 #include <QSettings>
-#include <QLineEdit>
 #include <QJsonObject>
 #include <QJsonArray>
 #include <QJsonDocument>
+#include <QRegularExpression>
 /* 软件版本信息 */
 // 主版本号
 const QString MAJOR_VERSION = "1.1";
@@ -23,7 +23,7 @@ const QString VERSION = QString("%1.%2").arg(MAJOR_VERSION, MINOR_VERSION);
 
 // 清理文件夹dir中的修改日期至今超过expire_days的文件,
 void CleanExpiredFiles(const QString &dir_path, const int expire_days);
-// 日志工具
+// 日志工具. 异步写入"./logs/"中按日期命名的文件, 见AsyncLogger
 void MyMessageOutput(QtMsgType msg_type, const QMessageLogContext &context,
                      const QString &msg);
 
@@ -32,6 +32,8 @@ void MyMessageOutput(QtMsgType msg_type, const QMessageLogContext &context,
 void MakeMultiLevelDir(const QString &file_path);
 // 静默版本
 bool MakeMultiLevelDirSilently(const QString &file_path);
+// 静默版本, 并且记住已经存在或创建过的目录, 之后对同一目录直接返回true. 目录被外部删除后见OpenFileForWriting
+bool MakeMultiLevelDirCached(const QString &file_path);
 
 /* 文件相关 */
 // 从file_path读取文件并把内容放在content
@@ -42,6 +44,9 @@ QByteArray ReadFile(const QString &file_path);
 bool WriteFile(const QString &file_path, const QString &content);
 // 向文件追加内容
 bool AppendFile(const QString &file_path, const QString &content);
+// 以mode打开file用于写入, 需要时创建目录(MakeMultiLevelDirCached). 打开失败时(目录可能被删掉了)重新创建目录再试一次
+bool OpenFileForWriting(QFileDevice &file, const QIODevice::OpenMode mode);
+// 大文件的映射读取, 分块逐行读取和带缓冲区的原子写入见fileio.h
 
 /* 字符串转码相关 */
 QString gbk_to_utf8(const std::string &vs_string);
@@ -68,6 +73,21 @@ const QStringList CaptureContents(const QString &text,
                                   const DataExchangFormat &text_format, const QString &key);
 // 利用正则表达式从文本(xml或json)中获取内容(获取所有), 直接根据构造搜索模式
 const QStringList CaptureContents(const QString &text, const QString &pattern);
+// 根据数据交换类型和关键字构造CaptureContent(s)的搜索模式. 关键字是模式的一部分, 可以含正则表达式
+QString MakePattern(const DataExchangFormat &text_format, const QString &key);
+// 编译好(并经过JIT优化)的正则表达式. 按模式缓存, 线程安全, 同一模式只编译一次. CaptureContent(s)都用它
+QRegularExpression CachedRegularExpression(const QString &pattern);
+// 同上, 按(数据交换类型, 关键字)缓存, 命中时连MakePattern也省了
+QRegularExpression CachedRegularExpression(const DataExchangFormat &text_format, const QString &key);
+/*
+ * 一次遍历text, 同时提取多个关键字的内容, 返回关键字 -> 所有内容(按出现顺序). 没有匹配到的关键字不在结果中.
+ * 结果与对每个关键字调用CaptureContents相同, 只是不用正则表达式, 关键字按普通文本比较, 并且:
+ * - xml的标签名要完全相同(正则表达式<key[^>]*>也会匹配以key开头的标签名);
+ * - xml中内容为空或只有空白字符的元素不算匹配;
+ * - xml中的空元素<key/>被跳过(正则表达式会从<key/>一直匹配到下一个</key>, 把中间的标签也当作内容)
+ */
+QHash<QString, QStringList> CaptureMultipleContents(const QString &text,
+                                                    const DataExchangFormat &text_format, const QStringList &keys);
 
 /* json相关 */
 // 从QByteArray中解析json, 返回QHash<QString, QString>
@@ -0,0 +1,18 @@
+# 只依赖QtCore, 命令行程序也可以用. 需要widgets的程序(比如ImageView)自己加
+
+# 源文件中按仓库根目录的相对路径包含头文件, 比如"CommonLibrary/GlobalTools/globaltools.h"
+INCLUDEPATH += $$PWD/../..
+
+SOURCES += \
+    $$PWD/asynclogger.cpp \
+    $$PWD/fileio.cpp \
+    $$PWD/globaltools.cpp \
+    $$PWD/jsonreader.cpp \
+    $$PWD/jsonwriter.cpp
+
+HEADERS += \
+    $$PWD/asynclogger.h \
+    $$PWD/fileio.h \
+    $$PWD/globaltools.h \
+    $$PWD/jsonreader.h \
+    $$PWD/jsonwriter.h
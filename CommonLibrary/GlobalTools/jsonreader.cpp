@@ -0,0 +1,495 @@
+﻿#include "jsonreader.h"
+#include <charconv>
+#include <cmath>
+#include <limits>
+
+// 10的0到22次方都能精确表示为double
+static const double POWERS_OF_TEN[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+/*!
+ * \brief parseDouble 把json的数字文本转换成double
+ * \note 有效数字不超过2^53并且10的指数不超过22时, 尾数和10的幂都能精确表示, 一次乘除的结果就是正确舍入的(Clinger的快速路径).
+ * 其他情况交给QByteArray::toDouble(与区域设置无关)
+ */
+static double parseDouble(const std::string_view &text)
+{
+    constexpr quint64 MAX_EXACT_MANTISSA = quint64(1) << 53;
+    const char *p = text.data();
+    const char *const end = p + text.size();
+    const bool negative = p < end && '-' == *p;
+    if (negative) {
+        ++p;
+    }
+    quint64 mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    for (; p < end && '0' <= *p && *p <= '9'; ++p, ++digits) {
+        mantissa = mantissa * 10 + quint64(*p - '0');
+    }
+    if (p < end && '.' == *p) {
+        for (++p; p < end && '0' <= *p && *p <= '9'; ++p, ++digits) {
+            mantissa = mantissa * 10 + quint64(*p - '0');
+            --exponent;
+        }
+    }
+    if (p < end && ('e' == *p || 'E' == *p)) {
+        int value = 0;
+        if (std::errc() != std::from_chars('+' == p[1] ? p + 2 : p + 1, end, value).ec) {
+            return QByteArray(text.data(), int(text.size())).toDouble();
+        }
+        exponent += value;
+    }
+    if (digits <= 19 && mantissa <= MAX_EXACT_MANTISSA && -22 <= exponent && exponent <= 22) {
+        double value = double(mantissa);
+        value = exponent < 0 ? value / POWERS_OF_TEN[-exponent] : value * POWERS_OF_TEN[exponent];
+        return negative ? -value : value;
+    }
+    return QByteArray(text.data(), int(text.size())).toDouble();
+}
+
+// 码点编码为utf-8
+static void appendUtf8(std::string &out, const uint codePoint)
+{
+    if (codePoint < 0x80) {
+        out += char(codePoint);
+    } else if (codePoint < 0x800) {
+        out += char(0xC0 | (codePoint >> 6));
+        out += char(0x80 | (codePoint & 0x3F));
+    } else if (codePoint < 0x10000) {
+        out += char(0xE0 | (codePoint >> 12));
+        out += char(0x80 | ((codePoint >> 6) & 0x3F));
+        out += char(0x80 | (codePoint & 0x3F));
+    } else {
+        out += char(0xF0 | (codePoint >> 18));
+        out += char(0x80 | ((codePoint >> 12) & 0x3F));
+        out += char(0x80 | ((codePoint >> 6) & 0x3F));
+        out += char(0x80 | (codePoint & 0x3F));
+    }
+}
+
+// 4位十六进制数, 不合法时返回-1
+static int parseHex4(const char *p)
+{
+    int value = 0;
+    for (int i = 0; i < 4; ++i) {
+        const char c = p[i];
+        value <<= 4;
+        if ('0' <= c && c <= '9') {
+            value |= c - '0';
+        } else if ('a' <= c && c <= 'f') {
+            value |= c - 'a' + 10;
+        } else if ('A' <= c && c <= 'F') {
+            value |= c - 'A' + 10;
+        } else {
+            return -1;
+        }
+    }
+    return value;
+}
+
+JsonReader::JsonReader(const std::string_view &json) : _json(json)
+{
+}
+
+JsonReader::JsonReader(const QByteArray &json) : _json(json.constData(), size_t(json.size()))
+{
+}
+
+JsonReader::Token JsonReader::next()
+{
+    if (Token::Error == _token) {
+        return _token;
+    }
+    skipWhitespace();
+    const char c = _position < _json.size() ? _json[_position] : '\0';
+    switch (_state) {
+    case State::Done:
+        return _token = Token::EndDocument;
+    case State::AfterValue:
+        if (_containers.empty()) {
+            if (_position < _json.size()) {
+                return setError("Unexpected characters after the document");
+            }
+            _state = State::Done;
+            return _token = Token::EndDocument;
+        }
+        if (',' == c) {
+            ++_position;
+            _state = '{' == _containers.back() ? State::Key : State::Value;
+            return next();
+        }
+        if (('}' == c && '{' == _containers.back()) || (']' == c && '[' == _containers.back())) {
+            ++_position;
+            _containers.pop_back();
+            return _token = '}' == c ? Token::EndObject : Token::EndArray;
+        }
+        return setError("Expected ',' or the end of the container");
+    case State::FirstKeyOrEnd:
+        if ('}' == c) {
+            ++_position;
+            _containers.pop_back();
+            _state = State::AfterValue;
+            return _token = Token::EndObject;
+        }
+        Q_FALLTHROUGH();
+    case State::Key:
+        if ('"' != c) {
+            return setError("Expected a key");
+        }
+        if (!readString()) {
+            return _token;
+        }
+        skipWhitespace();
+        if (_position >= _json.size() || ':' != _json[_position]) {
+            return setError("Expected ':'");
+        }
+        ++_position;
+        _state = State::Value;
+        return _token = Token::Key;
+    case State::FirstValueOrEnd:
+        if (']' == c) {
+            ++_position;
+            _containers.pop_back();
+            _state = State::AfterValue;
+            return _token = Token::EndArray;
+        }
+        Q_FALLTHROUGH();
+    case State::Value:
+        return readValue();
+    }
+    return setError("Invalid state");
+}
+
+JsonReader::Token JsonReader::readValue()
+{
+    if (_position >= _json.size()) {
+        return setError("Unexpected end of the document");
+    }
+    switch (_json[_position]) {
+    case '{':
+        ++_position;
+        _containers.push_back('{');
+        _state = State::FirstKeyOrEnd;
+        return _token = Token::BeginObject;
+    case '[':
+        ++_position;
+        _containers.push_back('[');
+        _state = State::FirstValueOrEnd;
+        return _token = Token::BeginArray;
+    case '"':
+        if (!readString()) {
+            return _token;
+        }
+        _state = State::AfterValue;
+        return _token = Token::String;
+    case 't':
+        _state = State::AfterValue;
+        return readLiteral("true") ? (_token = Token::True) : _token;
+    case 'f':
+        _state = State::AfterValue;
+        return readLiteral("false") ? (_token = Token::False) : _token;
+    case 'n':
+        _state = State::AfterValue;
+        return readLiteral("null") ? (_token = Token::Null) : _token;
+    default:
+        if (!readNumber()) {
+            return _token;
+        }
+        _state = State::AfterValue;
+        return _token = Token::Number;
+    }
+}
+
+bool JsonReader::readString()
+{
+    // _position指向左引号
+    const size_t begin = ++_position;
+    size_t i = begin;
+    while (i < _json.size() && '"' != _json[i] && '\\' != _json[i]) {
+        if (uchar(_json[i]) < 0x20) {
+            _position = i;
+            setError("Control character in a string");
+            return false;
+        }
+        ++i;
+    }
+    if (i >= _json.size()) {
+        _position = i;
+        setError("Unterminated string");
+        return false;
+    }
+    if ('"' == _json[i]) {
+        // 没有转义字符, 直接指向输入
+        _value = _json.substr(begin, i - begin);
+        _position = i + 1;
+        return true;
+    }
+
+    _unescaped.assign(_json.data() + begin, i - begin);
+    while (i < _json.size() && '"' != _json[i]) {
+        const char c = _json[i];
+        if ('\\' != c) {
+            if (uchar(c) < 0x20) {
+                _position = i;
+                setError("Control character in a string");
+                return false;
+            }
+            _unescaped += c;
+            ++i;
+            continue;
+        }
+        if (i + 1 >= _json.size()) {
+            break;
+        }
+        const char escaped = _json[i + 1];
+        i += 2;
+        switch (escaped) {
+        case '"':
+        case '\\':
+        case '/':
+            _unescaped += escaped;
+            break;
+        case 'b':
+            _unescaped += '\b';
+            break;
+        case 'f':
+            _unescaped += '\f';
+            break;
+        case 'n':
+            _unescaped += '\n';
+            break;
+        case 'r':
+            _unescaped += '\r';
+            break;
+        case 't':
+            _unescaped += '\t';
+            break;
+        case 'u': {
+            int codePoint = i + 4 <= _json.size() ? parseHex4(_json.data() + i) : -1;
+            if (codePoint < 0) {
+                _position = i;
+                setError("Invalid \\u escape");
+                return false;
+            }
+            i += 4;
+            // 代理对
+            if (0xD800 <= codePoint && codePoint < 0xDC00 && i + 6 <= _json.size()
+                    && '\\' == _json[i] && 'u' == _json[i + 1]) {
+                const int low = parseHex4(_json.data() + i + 2);
+                if (0xDC00 <= low && low < 0xE000) {
+                    codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+                    i += 6;
+                }
+            }
+            appendUtf8(_unescaped, uint(codePoint));
+            break;
+        }
+        default:
+            _position = i - 1;
+            setError("Invalid escape");
+            return false;
+        }
+    }
+    if (i >= _json.size()) {
+        _position = i;
+        setError("Unterminated string");
+        return false;
+    }
+    _value = _unescaped;
+    _position = i + 1;
+    return true;
+}
+
+bool JsonReader::readNumber()
+{
+    // -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+    const size_t begin = _position;
+    size_t i = _position;
+    const auto isDigit = [this](const size_t index) {
+        return index < _json.size() && '0' <= _json[index] && _json[index] <= '9';
+    };
+    if (i < _json.size() && '-' == _json[i]) {
+        ++i;
+    }
+    if (!isDigit(i)) {
+        _position = i;
+        setError("Invalid value");
+        return false;
+    }
+    if ('0' == _json[i]) {
+        ++i;
+    } else {
+        while (isDigit(i)) {
+            ++i;
+        }
+    }
+    _isInteger = true;
+    if (i < _json.size() && '.' == _json[i]) {
+        _isInteger = false;
+        ++i;
+        if (!isDigit(i)) {
+            _position = i;
+            setError("Invalid number");
+            return false;
+        }
+        while (isDigit(i)) {
+            ++i;
+        }
+    }
+    if (i < _json.size() && ('e' == _json[i] || 'E' == _json[i])) {
+        _isInteger = false;
+        ++i;
+        if (i < _json.size() && ('+' == _json[i] || '-' == _json[i])) {
+            ++i;
+        }
+        if (!isDigit(i)) {
+            _position = i;
+            setError("Invalid number");
+            return false;
+        }
+        while (isDigit(i)) {
+            ++i;
+        }
+    }
+    _value = _json.substr(begin, i - begin);
+    _position = i;
+    return true;
+}
+
+bool JsonReader::readLiteral(const std::string_view &literal)
+{
+    if (_json.substr(_position, literal.size()) != literal) {
+        setError("Invalid value");
+        return false;
+    }
+    _position += literal.size();
+    return true;
+}
+
+void JsonReader::skipWhitespace()
+{
+    while (_position < _json.size()) {
+        const char c = _json[_position];
+        if (' ' != c && '\n' != c && '\r' != c && '\t' != c) {
+            return;
+        }
+        ++_position;
+    }
+}
+
+JsonReader::Token JsonReader::setError(const QString &message)
+{
+    if (Token::Error != _token) {
+        _errorString = message;
+        _errorOffset = _position;
+        _token = Token::Error;
+    }
+    return _token;
+}
+
+JsonReader::Token JsonReader::token() const
+{
+    return _token;
+}
+
+bool JsonReader::hasError() const
+{
+    return Token::Error == _token;
+}
+
+QString JsonReader::errorString() const
+{
+    return _errorString;
+}
+
+int JsonReader::errorOffset() const
+{
+    return int(_errorOffset);
+}
+
+int JsonReader::depth() const
+{
+    return int(_containers.size());
+}
+
+std::string_view JsonReader::stringView() const
+{
+    return Token::Key == _token || Token::String == _token ? _value : std::string_view();
+}
+
+QString JsonReader::toString() const
+{
+    const std::string_view view = stringView();
+    return QString::fromUtf8(view.data(), int(view.size()));
+}
+
+bool JsonReader::isKey(const std::string_view &key) const
+{
+    return Token::Key == _token && _value == key;
+}
+
+std::string_view JsonReader::numberView() const
+{
+    return Token::Number == _token ? _value : std::string_view();
+}
+
+double JsonReader::toDouble() const
+{
+    return Token::Number == _token ? parseDouble(_value) : 0.0;
+}
+
+qint64 JsonReader::toInt64(bool *ok) const
+{
+    qint64 value = 0;
+    const bool converted = Token::Number == _token && convertNumber(value);
+    if (nullptr != ok) {
+        *ok = converted;
+    }
+    return converted ? value : 0;
+}
+
+bool JsonReader::nextKey()
+{
+    return Token::Key == next();
+}
+
+bool JsonReader::skipValue()
+{
+    const Token first = next();
+    if (Token::BeginObject == first || Token::BeginArray == first) {
+        const size_t depth = _containers.size();
+        while (_containers.size() >= depth) {
+            if (Token::Error == next()) {
+                return false;
+            }
+        }
+        return true;
+    }
+    return Token::String == first || Token::Number == first || Token::True == first
+           || Token::False == first || Token::Null == first;
+}
+
+bool JsonReader::convertNumber(double &value) const
+{
+    value = parseDouble(_value);
+    return true;
+}
+
+bool JsonReader::convertNumber(float &value) const
+{
+    value = float(parseDouble(_value));
+    return true;
+}
+
+bool JsonReader::convertNumber(int &value) const
+{
+    return _isInteger && std::errc() == std::from_chars(_value.data(), _value.data() + _value.size(), value).ec;
+}
+
+bool JsonReader::convertNumber(qint64 &value) const
+{
+    return _isInteger && std::errc() == std::from_chars(_value.data(), _value.data() + _value.size(), value).ec;
+}
@@ -0,0 +1,175 @@
+﻿#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <QByteArray>
+#include <QString>
+
+/*!
+ * \brief The JsonReader class 拉取式(pull)的json读取器, 不建树, 也不拷贝输入
+ * \note
+ * - 每次next()前进一个记号(token), 调用者按需取值, 不需要的值用skipValue()整个跳过;
+ * - 没有转义字符的字符串直接指向输入, 有转义字符时才解码到内部缓冲区, 所以输入要比读取器活得久;
+ * - readNumberArray()把数字数组直接转换进std::vector, 不经过QJsonValue/QVariant;
+ * - 出错之后next()总是返回Error, 错误信息见errorString()和errorOffset()
+ *
+ * 用法:
+ * \code
+ * JsonReader reader(bytes);
+ * if (JsonReader::Token::BeginObject == reader.next()) {
+ *     while (reader.nextKey()) {
+ *         if (reader.isKey("points")) {
+ *             reader.readNumberArray(points, true); // [[x, y], ...]展平成x, y, ...
+ *         } else {
+ *             reader.skipValue();
+ *         }
+ *     }
+ * }
+ * if (reader.hasError()) ...
+ * \endcode
+ */
+class JsonReader
+{
+public:
+    enum class Token : int {
+        None, // 还没有调用next()
+        BeginObject,
+        EndObject,
+        BeginArray,
+        EndArray,
+        Key, // 对象中的键, 内容见stringView()
+        String,
+        Number, // 内容见toDouble(), toInt64()或numberView()
+        True,
+        False,
+        Null,
+        EndDocument,
+        Error,
+    };
+
+    // json是utf-8. 读取器不拷贝json, 它的内存要一直有效
+    explicit JsonReader(const std::string_view &json);
+    explicit JsonReader(const QByteArray &json);
+
+    // 前进到下一个记号
+    Token next();
+    Token token() const;
+
+    bool hasError() const;
+    QString errorString() const;
+    // 出错的位置(字节)
+    int errorOffset() const;
+    // 当前所在的对象/数组的层数
+    int depth() const;
+
+    // Key或String的内容(utf-8, 已解码转义字符). 有转义字符时只在下一次next()之前有效
+    std::string_view stringView() const;
+    QString toString() const;
+    // 当前是不是键key
+    bool isKey(const std::string_view &key) const;
+
+    // Number的原始文本
+    std::string_view numberView() const;
+    double toDouble() const;
+    // 不是整数或超出范围时ok为false
+    qint64 toInt64(bool *ok = nullptr) const;
+
+    /*!
+     * \brief nextKey 在对象中前进到下一个键
+     * \return 到了对象的结尾(EndObject)或出错时返回false
+     * \note 返回true之后要读取(next()等)或跳过(skipValue())这个键的值, 才能再调用nextKey()
+     */
+    bool nextKey();
+    // 读取下一个值并丢掉, 对象和数组整个跳过. 下一个记号不是值(比如EndArray)或出错时返回false
+    bool skipValue();
+
+    /*!
+     * \brief readNumberArray 读取下一个值, 它应该是数字数组, 数字转换成T追加到values
+     * \param values
+     * \param flatten 为true时允许嵌套的数组, 按顺序展平, 比如[[x, y], [x, y]]
+     * \return 成功返回true. 下一个记号是EndArray(外层数组结束了)时返回false但不算出错, 便于循环读取数组的数组;
+     * 不是数组, 有非数字的元素, 或者数字不能表示为T(比如T是整数而数字有小数部分)时返回false并出错
+     */
+    template <typename T>
+    bool readNumberArray(std::vector<T> &values, const bool flatten = false);
+
+private:
+    // 期望的下一个记号
+    enum class State : int {
+        Value,
+        FirstValueOrEnd, // '['之后
+        Key,
+        FirstKeyOrEnd, // '{'之后
+        AfterValue, // ','或者对象/数组的结尾
+        Done,
+    };
+
+    Token readValue();
+    bool readString();
+    bool readNumber();
+    bool readLiteral(const std::string_view &literal);
+    void skipWhitespace();
+    Token setError(const QString &message);
+    // 把_value中的数字转换成T
+    bool convertNumber(double &value) const;
+    bool convertNumber(float &value) const;
+    bool convertNumber(int &value) const;
+    bool convertNumber(qint64 &value) const;
+
+    const std::string_view _json;
+    size_t _position = 0;
+    Token _token = Token::None;
+    State _state = State::Value;
+    std::vector<char> _containers; // 正在读的对象('{')和数组('[')
+    std::string_view _value; // 字符串或数字的内容
+    bool _isInteger = false; // 数字没有小数部分和指数部分
+    std::string _unescaped; // 有转义字符的字符串解码到这里, 复用
+    QString _errorString;
+    size_t _errorOffset = 0;
+};
+
+template <typename T>
+bool JsonReader::readNumberArray(std::vector<T> &values, const bool flatten)
+{
+    const Token first = next();
+    if (Token::EndArray == first) {
+        return false;
+    }
+    if (Token::BeginArray != first) {
+        if (Token::Error != first) {
+            setError("Expected a number array");
+        }
+        return false;
+    }
+    const size_t depth = _containers.size();
+    forever {
+        switch (next()) {
+        case Token::Number: {
+            T value;
+            if (!convertNumber(value)) {
+                setError(QString("Number not representable: %1").arg(QString::fromUtf8(_value.data(), int(_value.size()))));
+                return false;
+            }
+            values.push_back(value);
+            break;
+        }
+        case Token::EndArray:
+            if (_containers.size() < depth) {
+                return true;
+            }
+            break;
+        case Token::BeginArray:
+            if (flatten) {
+                break;
+            }
+            setError("Nested array in a number array");
+            return false;
+        case Token::Error:
+            return false;
+        default:
+            setError("Expected a number");
+            return false;
+        }
+    }
+}
@@ -0,0 +1,542 @@
+﻿#include "jsonwriter.h"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <QFileDevice>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QLocale>
+#include <QThread>
+
+// 标准库能不能格式化浮点数(MSVC从2017 15.9开始支持)
+#if defined(__cpp_lib_to_chars) || (defined(_MSC_VER) && _MSC_VER >= 1916)
+#define DOUBLE_TO_CHARS_AVAILABLE
+#endif
+
+// 这个范围内的整数都能用double精确表示
+constexpr double MAX_EXACT_INTEGER = 9007199254740992.0; // 2^53
+// QJsonDocument把这个范围内的整数值按'f'格式输出, 之外的按'g'格式
+constexpr double MAX_FIXED_INTEGER = 18446744073709551616.0; // 2^64
+
+static char hexDigit(const uint value)
+{
+    return char(value < 10 ? '0' + value : 'a' + value - 10);
+}
+
+// 转义ascii字符c, 与QJsonDocument相同
+static char *escapeAscii(char *cursor, const uchar c)
+{
+    *cursor++ = '\\';
+    switch (c) {
+    case '"':
+    case '\\':
+        *cursor++ = char(c);
+        break;
+    case '\b':
+        *cursor++ = 'b';
+        break;
+    case '\f':
+        *cursor++ = 'f';
+        break;
+    case '\n':
+        *cursor++ = 'n';
+        break;
+    case '\r':
+        *cursor++ = 'r';
+        break;
+    case '\t':
+        *cursor++ = 't';
+        break;
+    default:
+        *cursor++ = 'u';
+        *cursor++ = '0';
+        *cursor++ = '0';
+        *cursor++ = hexDigit(c >> 4);
+        *cursor++ = hexDigit(c & 0xF);
+        break;
+    }
+    return cursor;
+}
+
+/*!
+ * \brief shortestDigits 能还原number(> 0)的最短的十进制有效数字
+ * \param number
+ * \param digits 有效数字, 去掉了末尾的0, 至少要有17个字节
+ * \param decimalPoint 小数点的位置, number = 0.digits * 10^decimalPoint
+ * \return 有效数字的个数
+ */
+static int shortestDigits(const double number, char *digits, int &decimalPoint)
+{
+    // 科学计数法, 形如d.ddde+XX
+#ifdef DOUBLE_TO_CHARS_AVAILABLE
+    char text[32];
+    const char *const end = std::to_chars(text, text + sizeof(text), number, std::chars_format::scientific).ptr;
+#else
+    const QByteArray bytes = QByteArray::number(number, 'e', QLocale::FloatingPointShortest);
+    const char *const text = bytes.constData();
+    const char *const end = text + bytes.size();
+#endif
+    int count = 0;
+    const char *p = text;
+    for (; p < end && 'e' != *p; ++p) {
+        if ('.' != *p) {
+            digits[count++] = *p;
+        }
+    }
+    int exponent = 0;
+    if (p < end) {
+        std::from_chars('+' == p[1] ? p + 2 : p + 1, end, exponent);
+    }
+    while (count > 1 && '0' == digits[count - 1]) {
+        --count;
+    }
+    decimalPoint = exponent + 1;
+    return count;
+}
+
+JsonWriter::JsonWriter(QIODevice *device) : JsonWriter(device, Options())
+{
+}
+
+JsonWriter::JsonWriter(QIODevice *device, const Options &options) : _device(device), _options(options)
+{
+    // reserve()过的QByteArray在resize(0)时不释放内存
+    _buffer.reserve(options.bufferSize);
+    if (options.backgroundFlush) {
+        _pending.reserve(options.bufferSize);
+        _thread = QThread::create([this]() {
+            runBackground();
+        });
+        _thread->start();
+    }
+}
+
+JsonWriter::~JsonWriter()
+{
+    flush();
+    if (nullptr != _thread) {
+        {
+            QMutexLocker locker(&_mutex);
+            _stopping = true;
+            _workCondition.wakeAll();
+        }
+        _thread->wait();
+        delete _thread;
+    }
+}
+
+JsonWriter &JsonWriter::beginObject()
+{
+    beforeValue();
+    _buffer.append('{');
+    _containers.push_back('{');
+    _first = true;
+    return *this;
+}
+
+JsonWriter &JsonWriter::endObject()
+{
+    Q_ASSERT(!_containers.empty() && '{' == _containers.back() && !_afterKey);
+    _buffer.append('}');
+    _containers.pop_back();
+    _first = false;
+    flushIfFull();
+    return *this;
+}
+
+JsonWriter &JsonWriter::beginArray()
+{
+    beforeValue();
+    _buffer.append('[');
+    _containers.push_back('[');
+    _first = true;
+    return *this;
+}
+
+JsonWriter &JsonWriter::endArray()
+{
+    Q_ASSERT(!_containers.empty() && '[' == _containers.back());
+    _buffer.append(']');
+    _containers.pop_back();
+    _first = false;
+    flushIfFull();
+    return *this;
+}
+
+JsonWriter &JsonWriter::key(const QString &name)
+{
+    beforeKey();
+    appendString(name);
+    _buffer.append(':');
+    return *this;
+}
+
+JsonWriter &JsonWriter::key(const std::string_view &name)
+{
+    beforeKey();
+    appendString(name);
+    _buffer.append(':');
+    return *this;
+}
+
+JsonWriter &JsonWriter::key(const char *name)
+{
+    return key(std::string_view(name));
+}
+
+JsonWriter &JsonWriter::value(const QString &text)
+{
+    beforeValue();
+    appendString(text);
+    flushIfFull();
+    return *this;
+}
+
+JsonWriter &JsonWriter::value(const std::string_view &text)
+{
+    beforeValue();
+    appendString(text);
+    flushIfFull();
+    return *this;
+}
+
+JsonWriter &JsonWriter::value(const char *text)
+{
+    return value(std::string_view(text));
+}
+
+JsonWriter &JsonWriter::value(const bool boolean)
+{
+    beforeValue();
+    _buffer.append(boolean ? "true" : "false");
+    flushIfFull();
+    return *this;
+}
+
+JsonWriter &JsonWriter::value(const double number)
+{
+    beforeValue();
+    appendNumber(number);
+    flushIfFull();
+    return *this;
+}
+
+JsonWriter &JsonWriter::value(const int number)
+{
+    beforeValue();
+    appendNumber(number);
+    flushIfFull();
+    return *this;
+}
+
+JsonWriter &JsonWriter::value(const qint64 number)
+{
+    beforeValue();
+    appendNumber(number);
+    flushIfFull();
+    return *this;
+}
+
+JsonWriter &JsonWriter::null()
+{
+    beforeValue();
+    _buffer.append("null");
+    flushIfFull();
+    return *this;
+}
+
+JsonWriter &JsonWriter::value(const QJsonValue &jsonValue)
+{
+    switch (jsonValue.type()) {
+    case QJsonValue::Bool:
+        return value(jsonValue.toBool());
+    case QJsonValue::Double:
+        return value(jsonValue.toDouble());
+    case QJsonValue::String:
+        return value(jsonValue.toString());
+    case QJsonValue::Array: {
+        beginArray();
+        const QJsonArray array = jsonValue.toArray();
+        for (const QJsonValue &element : array) {
+            value(element);
+        }
+        return endArray();
+    }
+    case QJsonValue::Object: {
+        // QJsonObject按键的顺序遍历, 与QJsonDocument相同
+        beginObject();
+        const QJsonObject object = jsonValue.toObject();
+        for (auto it = object.constBegin(); it != object.constEnd(); ++it) {
+            key(it.key());
+            value(it.value());
+        }
+        return endObject();
+    }
+    default:
+        return null();
+    }
+}
+
+bool JsonWriter::flush()
+{
+    submitBuffer();
+    waitForBackgroundWrite();
+    if (QFileDevice *file = qobject_cast<QFileDevice *>(_device)) {
+        if (!hasError() && !file->flush()) {
+            QMutexLocker locker(&_mutex);
+            _hasError = true;
+            _errorString = file->errorString();
+        }
+    }
+    return !hasError();
+}
+
+bool JsonWriter::hasError() const
+{
+    QMutexLocker locker(&_mutex);
+    return _hasError;
+}
+
+QString JsonWriter::errorString() const
+{
+    QMutexLocker locker(&_mutex);
+    return _errorString;
+}
+
+int JsonWriter::depth() const
+{
+    return int(_containers.size());
+}
+
+void JsonWriter::beforeValue()
+{
+    Q_ASSERT(_afterKey || _containers.empty() || '[' == _containers.back());
+    if (_afterKey) {
+        _afterKey = false;
+    } else if (!_first) {
+        _buffer.append(',');
+    }
+    _first = false;
+}
+
+void JsonWriter::beforeKey()
+{
+    Q_ASSERT(!_containers.empty() && '{' == _containers.back() && !_afterKey);
+    if (!_first) {
+        _buffer.append(',');
+    }
+    _first = false;
+    _afterKey = true;
+}
+
+void JsonWriter::appendString(const QString &text)
+{
+    // 最坏的情况每个utf-16字符转义为\uXXXX, 先按最坏情况扩大, 写完再缩小
+    const int offset = _buffer.size();
+    _buffer.resize(offset + 6 * text.size() + 2);
+    char *cursor = _buffer.data() + offset;
+    *cursor++ = '"';
+    const ushort *source = text.utf16();
+    const ushort *const end = source + text.size();
+    for (; source < end; ++source) {
+        const ushort u = *source;
+        if (u < 0x80) {
+            if (u < 0x20 || '"' == u || '\\' == u) {
+                cursor = escapeAscii(cursor, uchar(u));
+            } else {
+                *cursor++ = char(u);
+            }
+        } else if (u < 0x800) {
+            *cursor++ = char(0xC0 | (u >> 6));
+            *cursor++ = char(0x80 | (u & 0x3F));
+        } else if (!QChar::isSurrogate(u)) {
+            *cursor++ = char(0xE0 | (u >> 12));
+            *cursor++ = char(0x80 | ((u >> 6) & 0x3F));
+            *cursor++ = char(0x80 | (u & 0x3F));
+        } else if (QChar::isHighSurrogate(u) && source + 1 < end && QChar::isLowSurrogate(source[1])) {
+            const uint codePoint = QChar::surrogateToUcs4(u, source[1]);
+            ++source;
+            *cursor++ = char(0xF0 | (codePoint >> 18));
+            *cursor++ = char(0x80 | ((codePoint >> 12) & 0x3F));
+            *cursor++ = char(0x80 | ((codePoint >> 6) & 0x3F));
+            *cursor++ = char(0x80 | (codePoint & 0x3F));
+        } else {
+            // 不成对的代理, 与QJsonDocument一样写成\uXXXX
+            *cursor++ = '\\';
+            *cursor++ = 'u';
+            *cursor++ = hexDigit((u >> 12) & 0xF);
+            *cursor++ = hexDigit((u >> 8) & 0xF);
+            *cursor++ = hexDigit((u >> 4) & 0xF);
+            *cursor++ = hexDigit(u & 0xF);
+        }
+    }
+    *cursor++ = '"';
+    _buffer.resize(int(cursor - _buffer.constData()));
+}
+
+void JsonWriter::appendString(const std::string_view &text)
+{
+    _buffer.append('"');
+    const char *run = text.data();
+    const char *const end = run + text.size();
+    for (const char *p = run; p < end; ++p) {
+        const uchar c = uchar(*p);
+        if (c >= 0x20 && '"' != c && '\\' != c) {
+            continue;
+        }
+        // 不需要转义的部分整段拷贝
+        _buffer.append(run, int(p - run));
+        char escaped[8];
+        _buffer.append(escaped, int(escapeAscii(escaped, c) - escaped));
+        run = p + 1;
+    }
+    _buffer.append(run, int(end - run));
+    _buffer.append('"');
+}
+
+void JsonWriter::appendNumber(const double number)
+{
+    /*
+     * QJsonDocument的格式:
+     * 整数值(且绝对值小于2^64)是QByteArray::number(number, 'f', QLocale::FloatingPointShortest),
+     * 其他是QByteArray::number(number, 'g', QLocale::FloatingPointShortest).
+     * 'g'格式在小数点位置decimalPoint - 1 < -4或decimalPoint > 有效数字个数 + 5时用科学计数法, 指数至少两位
+     */
+    if (!std::isfinite(number)) {
+        _buffer.append("null");
+        return;
+    }
+    const double magnitude = std::abs(number);
+    const bool integral = magnitude == std::floor(magnitude);
+    if (integral && magnitude < MAX_EXACT_INTEGER) {
+        // 包括-0.0, QJsonDocument输出0
+        appendNumber(qint64(magnitude) * (number < 0 ? -1 : 1));
+        return;
+    }
+
+    char digits[32];
+    int decimalPoint = 0;
+    const int count = shortestDigits(magnitude, digits, decimalPoint);
+    char text[48];
+    char *cursor = text;
+    if (number < 0) {
+        *cursor++ = '-';
+    }
+    const int cutoff = decimalPoint > 0 ? count + 5 : 6;
+    if (integral && magnitude < MAX_FIXED_INTEGER) {
+        // 'f'格式, 有效数字之后补0
+        cursor = std::copy(digits, digits + count, cursor);
+        cursor = std::fill_n(cursor, decimalPoint - count, '0');
+    } else if (decimalPoint - 1 < -4 || decimalPoint > cutoff) {
+        // 科学计数法
+        *cursor++ = digits[0];
+        if (count > 1) {
+            *cursor++ = '.';
+            cursor = std::copy(digits + 1, digits + count, cursor);
+        }
+        const int exponent = decimalPoint - 1;
+        *cursor++ = 'e';
+        *cursor++ = exponent < 0 ? '-' : '+';
+        if (std::abs(exponent) < 10) {
+            *cursor++ = '0';
+        }
+        cursor = std::to_chars(cursor, text + sizeof(text), std::abs(exponent)).ptr;
+    } else if (decimalPoint <= 0) {
+        *cursor++ = '0';
+        *cursor++ = '.';
+        cursor = std::fill_n(cursor, -decimalPoint, '0');
+        cursor = std::copy(digits, digits + count, cursor);
+    } else if (decimalPoint >= count) {
+        cursor = std::copy(digits, digits + count, cursor);
+        cursor = std::fill_n(cursor, decimalPoint - count, '0');
+    } else {
+        cursor = std::copy(digits, digits + decimalPoint, cursor);
+        *cursor++ = '.';
+        cursor = std::copy(digits + decimalPoint, digits + count, cursor);
+    }
+    _buffer.append(text, int(cursor - text));
+}
+
+void JsonWriter::appendNumber(const int number)
+{
+    char text[16];
+    _buffer.append(text, int(std::to_chars(text, text + sizeof(text), number).ptr - text));
+}
+
+void JsonWriter::appendNumber(const qint64 number)
+{
+    if (std::abs(double(number)) >= MAX_EXACT_INTEGER) {
+        appendNumber(double(number));
+        return;
+    }
+    char text[24];
+    _buffer.append(text, int(std::to_chars(text, text + sizeof(text), number).ptr - text));
+}
+
+void JsonWriter::flushIfFull()
+{
+    if (_buffer.size() >= _options.bufferSize) {
+        submitBuffer();
+    }
+}
+
+void JsonWriter::submitBuffer()
+{
+    if (_buffer.isEmpty()) {
+        return;
+    }
+    if (nullptr == _thread) {
+        writeToDevice(_buffer);
+        _buffer.resize(0);
+        return;
+    }
+    // 等后台线程写完上一个缓冲区, 然后交换
+    QMutexLocker locker(&_mutex);
+    while (!_pending.isEmpty()) {
+        _idleCondition.wait(&_mutex);
+    }
+    _pending.swap(_buffer);
+    _workCondition.wakeAll();
+}
+
+void JsonWriter::writeToDevice(const QByteArray &bytes)
+{
+    if (hasError()) {
+        return;
+    }
+    if (_device->write(bytes) != bytes.size()) {
+        QMutexLocker locker(&_mutex);
+        _hasError = true;
+        _errorString = _device->errorString();
+    }
+}
+
+void JsonWriter::waitForBackgroundWrite()
+{
+    if (nullptr == _thread) {
+        return;
+    }
+    QMutexLocker locker(&_mutex);
+    while (!_pending.isEmpty()) {
+        _idleCondition.wait(&_mutex);
+    }
+}
+
+void JsonWriter::runBackground()
+{
+    QMutexLocker locker(&_mutex);
+    forever {
+        while (_pending.isEmpty() && !_stopping) {
+            _workCondition.wait(&_mutex);
+        }
+        if (_pending.isEmpty()) {
+            break;
+        }
+        // _pending不为空时前台不会访问它
+        locker.unlock();
+        writeToDevice(_pending);
+        locker.relock();
+        _pending.resize(0);
+        _idleCondition.wakeAll();
+    }
+}
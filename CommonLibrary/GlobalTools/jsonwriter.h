@@ -0,0 +1,142 @@
+﻿#pragma once
+
+#include <string_view>
+#include <vector>
+#include <QByteArray>
+#include <QJsonValue>
+#include <QMutex>
+#include <QString>
+#include <QWaitCondition>
+
+class QIODevice;
+class QThread;
+
+/*!
+ * \brief The JsonWriter class 流式的json写入器, 边生成边写入QIODevice, 不需要先建QJsonObject/QVariantHash
+ * \note
+ * - 输出与QJsonDocument::Compact逐字节相同(数字的格式, 字符串的转义都一样).
+ *   唯一的区别是对象的键按写入的顺序输出, 而QJsonObject按键排序, 所以要得到相同的结果, 键要按升序写入;
+ * - 内容先写进复用的缓冲区, 满了(Options::bufferSize)才写入设备;
+ * - Options::backgroundFlush为true时, 缓冲区满了交给后台线程写入设备, 同时换另一个缓冲区继续生成(双缓冲).
+ *   此时设备只能由后台线程访问, 所以不要用有线程亲和性的设备(比如QTcpSocket), QFile/QSaveFile可以;
+ * - 出错(设备写入失败)之后的内容都被丢弃, 见hasError()和errorString();
+ * - 调用顺序不对(比如数组中写键)是编程错误, 用Q_ASSERT检查
+ *
+ * 用法:
+ * \code
+ * JsonWriter writer(&file);
+ * writer.beginObject();
+ * writer.key("contours").beginArray();
+ * for (const std::vector<cv::Point> &contour : contours) {
+ *     writer.beginArray();
+ *     for (const cv::Point &point : contour) {
+ *         writer.beginArray().value(point.x).value(point.y).endArray();
+ *     }
+ *     writer.endArray();
+ * }
+ * writer.endArray();
+ * writer.endObject();
+ * if (!writer.flush()) ...
+ * \endcode
+ */
+class JsonWriter
+{
+public:
+    struct Options {
+        int bufferSize = 256 * 1024; // 缓冲区超过这个大小就写入设备
+        bool backgroundFlush = false; // 在后台线程写入设备
+    };
+
+    // device要已经打开, 并且在本对象析构之前一直有效
+    explicit JsonWriter(QIODevice *device);
+    JsonWriter(QIODevice *device, const Options &options);
+    // 写入剩下的内容, 见flush()
+    ~JsonWriter();
+
+    JsonWriter &beginObject();
+    JsonWriter &endObject();
+    JsonWriter &beginArray();
+    JsonWriter &endArray();
+    // 对象中的键, 之后要写它的值
+    JsonWriter &key(const QString &name);
+    // name是utf-8
+    JsonWriter &key(const std::string_view &name);
+    JsonWriter &key(const char *name);
+
+    JsonWriter &value(const QString &text);
+    // text是utf-8
+    JsonWriter &value(const std::string_view &text);
+    JsonWriter &value(const char *text);
+    JsonWriter &value(const bool boolean);
+    // 非有限数(inf, nan)写成null, 与QJsonDocument相同
+    JsonWriter &value(const double number);
+    JsonWriter &value(const int number);
+    // 与QJsonValue相同, 绝对值超过2^53的整数先转换为double
+    JsonWriter &value(const qint64 number);
+    JsonWriter &null();
+    // 写入QJsonValue(包括QJsonObject和QJsonArray), 用于混合小的树和流式的大数组
+    JsonWriter &value(const QJsonValue &jsonValue);
+    // 写入数字数组[v0, v1, ...]
+    template <typename T>
+    JsonWriter &numberArray(const T *values, const size_t count);
+
+    /*!
+     * \brief flush 把缓冲区中的内容写入设备(后台写入时等待写完), 如果设备是文件, 再刷新文件的缓冲区
+     * \return 没有出过错返回true
+     */
+    bool flush();
+    bool hasError() const;
+    QString errorString() const;
+    // 当前所在的对象/数组的层数
+    int depth() const;
+
+private:
+    // 写值或键之前: 需要的话加逗号
+    void beforeValue();
+    void beforeKey();
+    void appendString(const QString &text);
+    void appendString(const std::string_view &text);
+    void appendNumber(const double number);
+    void appendNumber(const int number);
+    void appendNumber(const qint64 number);
+    // 缓冲区满了就写入设备
+    void flushIfFull();
+    // 把_buffer写入设备或交给后台线程
+    void submitBuffer();
+    void writeToDevice(const QByteArray &bytes);
+    void waitForBackgroundWrite();
+    void runBackground();
+
+    QIODevice *const _device;
+    const Options _options;
+    QByteArray _buffer;
+    std::vector<char> _containers; // 正在写的对象('{')和数组('[')
+    bool _first = true; // 当前对象/数组中还没有元素
+    bool _afterKey = false; // 刚写完键, 下一个是它的值
+
+    // 以下成员由_mutex保护(后台线程也会访问)
+    mutable QMutex _mutex;
+    bool _hasError = false;
+    QString _errorString;
+    QThread *_thread = nullptr; // 后台写入的线程
+    QWaitCondition _workCondition; // 有要写的内容或要退出
+    QWaitCondition _idleCondition; // 写完了
+    QByteArray _pending; // 等待后台线程写入的内容
+    bool _stopping = false;
+};
+
+template <typename T>
+JsonWriter &JsonWriter::numberArray(const T *values, const size_t count)
+{
+    beginArray();
+    for (size_t i = 0; i < count; ++i) {
+        if (0 != i) {
+            _buffer.append(',');
+        }
+        appendNumber(values[i]);
+        if (_buffer.size() >= _options.bufferSize) {
+            submitBuffer();
+        }
+    }
+    return endArray();
+}
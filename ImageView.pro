@@ -1,4 +1,4 @@
-QT       += core gui
+QT       += core gui concurrent
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -8,19 +8,15 @@ CONFIG += c++17
 # In order to do so, uncomment the following line.
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
+# VisionLibrary中的转换核用OpenCV的universal intrinsics实现, 默认按编译器的基线指令集(x64上是SSE2)编译.
+# 如果目标机器都支持AVX2, 可以打开下面这行, 向量宽度会翻倍
+#msvc: QMAKE_CXXFLAGS += /arch:AVX2
+
 SOURCES += \
-    CommonLibrary/GlobalTools/globaltools.cpp \
-    ImageView1/imageview1.cpp \
-    ImageView2/imageview2.cpp \
-    VisionLibrary/visionlibrary.cpp \
     main.cpp \
     mainwindow.cpp
 
 HEADERS += \
-    CommonLibrary/GlobalTools/globaltools.h \
-    ImageView1/imageview1.h \
-    ImageView2/imageview2.h \
-    VisionLibrary/visionlibrary.h \
     mainwindow.h
 
 FORMS += \
@@ -31,10 +27,5 @@ qnx: target.path = /tmp/$${TARGET}/bin
 else: unix:!android: target.path = /opt/$${TARGET}/bin
 !isEmpty(target.path): INSTALLS += target
 
-# 使用OpenCV 4.5.0 world
-OPENCV450_BUILD = G:/OpenSource/OpenCV/4_5_0/install/opencv/build
-win32:CONFIG(release, debug|release): LIBS += -L$$OPENCV450_BUILD/x64/vc15/lib/ -lopencv_world450
-else:win32:CONFIG(debug, debug|release): LIBS += -L$$OPENCV450_BUILD/x64/vc15/lib/ -lopencv_world450d
-INCLUDEPATH += $$OPENCV450_BUILD/include
-
-
+# ImageView1, ImageView2, VisionLibrary, GlobalTools和OpenCV
+include(ImageView2/imageview2.pri)
@@ -0,0 +1,135 @@
+﻿#include "framemailbox.h"
+#include <QDebug>
+#include "VisionLibrary/visionlibrary.h"
+
+FrameMailbox::FrameMailbox(QObject *parent) : QObject(parent)
+{
+    setConverter([](const cv::Mat &mat) {
+        return VisionLibrary::toDisplayImage(mat);
+    });
+}
+
+FrameMailbox::~FrameMailbox()
+{
+    if (_worker.joinable()) {
+        _quit = true;
+        _semaphore.release();
+        _worker.join();
+    }
+    delete _pending.exchange(nullptr);
+    delete _ready.exchange(nullptr);
+    for (std::atomic<Frame *> &slot : _freeFrames) {
+        delete slot.exchange(nullptr);
+    }
+}
+
+void FrameMailbox::publish(const cv::Mat &mat)
+{
+    std::call_once(_startFlag, [this]() {
+        _worker = std::thread(&FrameMailbox::run, this);
+    });
+    ++_publishedCount;
+    Frame *const frame = acquireFrame();
+    frame->mat = mat;
+    bool wasEmpty = false;
+    replace(_pending, frame, &wasEmpty);
+    if (wasEmpty) {
+        // 槽位中原来有帧的话, 工作线程已经被唤醒过了, 不用再唤醒
+        _semaphore.release();
+    }
+}
+
+bool FrameMailbox::take(cv::Mat &mat, QImage &image)
+{
+    // 先清除标志再取帧: 如果工作线程在这之后放入新帧, 它会再发一次信号
+    _notified = false;
+    Frame *const frame = _ready.exchange(nullptr);
+    if (nullptr == frame) {
+        return false;
+    }
+    mat = frame->mat;
+    image = frame->image;
+    recycleFrame(frame);
+    ++_takenCount;
+    return true;
+}
+
+void FrameMailbox::setConverter(const Converter &converter)
+{
+    std::atomic_store(&_converter, std::make_shared<const Converter>(converter));
+}
+
+quint64 FrameMailbox::publishedCount() const
+{
+    return _publishedCount;
+}
+
+quint64 FrameMailbox::droppedCount() const
+{
+    return _droppedCount;
+}
+
+quint64 FrameMailbox::takenCount() const
+{
+    return _takenCount;
+}
+
+void FrameMailbox::run()
+{
+    while (true) {
+        _semaphore.acquire();
+        if (_quit) {
+            return;
+        }
+        Frame *const frame = _pending.exchange(nullptr);
+        if (nullptr == frame) {
+            continue;
+        }
+        const std::shared_ptr<const Converter> converter = std::atomic_load(&_converter);
+        if (converter && *converter) {
+            frame->image = (*converter)(frame->mat);
+        }
+        replace(_ready, frame);
+        if (!_notified.exchange(true)) {
+            // 跨线程发射, 接收者在GUI线程中以排队方式执行
+            emit signal_frameReady();
+        }
+    }
+}
+
+void FrameMailbox::replace(std::atomic<Frame *> &slot, Frame *frame, bool *wasEmpty)
+{
+    Frame *const old = slot.exchange(frame);
+    if (nullptr != wasEmpty) {
+        *wasEmpty = (nullptr == old);
+    }
+    if (nullptr != old) {
+        ++_droppedCount;
+        recycleFrame(old);
+    }
+}
+
+FrameMailbox::Frame *FrameMailbox::acquireFrame()
+{
+    // 每个槽位单独交换, 不存在共享链表的ABA问题
+    for (std::atomic<Frame *> &slot : _freeFrames) {
+        if (Frame *const frame = slot.exchange(nullptr)) {
+            return frame;
+        }
+    }
+    return new Frame;
+}
+
+void FrameMailbox::recycleFrame(Frame *frame)
+{
+    frame->mat.release();
+    frame->image = QImage();
+    for (std::atomic<Frame *> &slot : _freeFrames) {
+        Frame *empty = nullptr;
+        if (slot.compare_exchange_strong(empty, frame)) {
+            return;
+        }
+    }
+    // 多个生产者同时发布时才会多出帧对象
+    delete frame;
+}
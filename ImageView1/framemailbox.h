@@ -0,0 +1,86 @@
+﻿#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <QObject>
+#include <QImage>
+#include <QSemaphore>
+#include <opencv2/opencv.hpp>
+
+/*!
+ * \brief The FrameMailbox class 只有一个槽位的"最新帧优先"邮箱, 用于从采集线程向显示控件送图
+ * \note
+ * - 生产者(任意线程)调用publish(), 只是无锁地把帧换进槽位, 不会阻塞;
+ * - 显示转换在邮箱自己的工作线程中进行;
+ * - GUI线程收到signal_frameReady()之后调用take()取走最新的已转换帧;
+ * - 来不及转换或来不及显示的旧帧直接丢掉并计数, 所以无论生产者多快, 显示延迟都不超过大约一帧;
+ * - 帧对象在空闲槽位中回收复用. 只有一个生产者时同时在用的帧不超过FREE_FRAME_SLOTS个, 稳定之后每帧不再new/delete
+ */
+class FrameMailbox : public QObject
+{
+    Q_OBJECT
+public:
+    // 显示转换函数, 在工作线程中调用, 必须是线程安全的
+    using Converter = std::function<QImage(const cv::Mat &)>;
+
+    explicit FrameMailbox(QObject *parent = nullptr);
+    ~FrameMailbox() override;
+
+    // 任意线程调用: 发布一帧. 如果上一帧还没有开始转换, 就丢掉上一帧.
+    // 生产者可以用VisionLibrary::BufferPool::instance().acquireMat()取得每帧的cv::Mat, 被丢掉或显示完的帧会自动回到缓冲池
+    void publish(const cv::Mat &mat);
+    // GUI线程调用: 取走最新的已转换帧. 没有新帧时返回false
+    bool take(cv::Mat &mat, QImage &image);
+
+    // 设置显示转换函数, 可以在任意时刻调用, 从下一帧开始生效
+    void setConverter(const Converter &converter);
+
+    // 发布的帧数
+    quint64 publishedCount() const;
+    // 被更新的帧顶替而丢掉的帧数
+    quint64 droppedCount() const;
+    // 被take()取走的帧数
+    quint64 takenCount() const;
+
+signals:
+    // 有新的已转换帧. 在被take()之前只发一次, 所以事件队列中不会堆积
+    void signal_frameReady();
+
+private:
+    struct Frame {
+        cv::Mat mat;
+        QImage image;
+    };
+
+    // 空闲帧对象的槽位数: 生产者正在发布的, 等待转换的, 正在转换的, 等待显示的各一个
+    static constexpr int FREE_FRAME_SLOTS = 4;
+
+    // 工作线程: 等待新帧, 转换, 放进已转换槽位
+    void run();
+    // 把frame换进槽位slot, 顶替掉的旧帧回收并计数
+    void replace(std::atomic<Frame *> &slot, Frame *frame, bool *wasEmpty = nullptr);
+    // 从空闲槽位中取一个帧对象, 都空时才new
+    Frame *acquireFrame();
+    // 清空帧的内容(像素内存回到缓冲池), 放回空闲槽位. 槽位都满时才delete
+    void recycleFrame(Frame *frame);
+
+    std::atomic<Frame *> _pending{nullptr}; // 等待转换的帧
+    std::atomic<Frame *> _ready{nullptr}; // 等待显示的帧
+    std::atomic<Frame *> _freeFrames[FREE_FRAME_SLOTS] = {}; // 回收的帧对象, 空槽位为nullptr
+    std::atomic_bool _notified{false}; // 是否已经发出signal_frameReady()而还没有被take()
+    std::atomic_bool _quit{false};
+
+    // 工作线程在第一次publish()时才启动
+    std::once_flag _startFlag;
+    std::thread _worker;
+    QSemaphore _semaphore; // 每当_pending由空变为非空, 就唤醒工作线程一次
+
+    std::shared_ptr<const Converter> _converter;
+
+    std::atomic<quint64> _publishedCount{0};
+    std::atomic<quint64> _droppedCount{0};
+    std::atomic<quint64> _takenCount{0};
+};
@@ -0,0 +1,223 @@
+﻿#include "imagesequence.h"
+#include <algorithm>
+#include <QCollator>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QRunnable>
+#include "VisionLibrary/imagefile.h"
+
+// 目录中按后缀识别的图像文件, 与cv::imread和VisionLibrary::mapImageFile支持的格式一致
+static const QStringList IMAGE_NAME_FILTERS{
+    "*.bmp", "*.dib", "*.jpg", "*.jpeg", "*.jpe", "*.png", "*.tif", "*.tiff", "*.webp",
+    "*.pbm", "*.pgm", "*.ppm", "*.pnm", "*.sr", "*.ras", "*.exr", "*.hdr", "*.jp2",
+    "*.npy", "*.raw",
+};
+
+// 后台线程数. 解码大多受限于磁盘和内存带宽, 线程多了也不会更快
+constexpr int DECODE_THREAD_COUNT = 2;
+
+/*!
+ * \brief The DecodeTask class 包装一个函数, 用于带优先级地提交给QThreadPool
+ */
+class DecodeTask : public QRunnable
+{
+public:
+    explicit DecodeTask(const std::function<void()> &function) : _function(function) {}
+    void run() override
+    {
+        _function();
+    }
+
+private:
+    std::function<void()> _function;
+};
+
+// 解码结果占用的内存(KB). 零拷贝的QImage与cv::Mat共用像素, 不重复计算
+static int entryCost(const cv::Mat &mat, const QImage &image)
+{
+    qint64 bytes = static_cast<qint64>(mat.total() * mat.elemSize());
+    if (!image.isNull() && image.constBits() != mat.data) {
+        bytes += image.sizeInBytes();
+    }
+    return static_cast<int>(qMax<qint64>(1, bytes / 1024));
+}
+
+ImageSequence::ImageSequence(QObject *parent) : QObject(parent)
+{
+    _cache.setMaxCost(DEFAULT_CACHE_LIMIT * 1024);
+    _threadPool.setMaxThreadCount(DECODE_THREAD_COUNT);
+}
+
+ImageSequence::~ImageSequence()
+{
+    // 还没开始的任务直接丢掉, 正在解码的等它结束
+    ++_generation;
+    _threadPool.clear();
+    _threadPool.waitForDone();
+}
+
+bool ImageSequence::open(const QString &path)
+{
+    const QFileInfo fileInfo(path);
+    const QDir dir = fileInfo.isDir() ? QDir(fileInfo.absoluteFilePath()) : fileInfo.absoluteDir();
+    QStringList names = dir.entryList(IMAGE_NAME_FILTERS, QDir::Files | QDir::Readable);
+    if (names.isEmpty()) {
+        qWarning().noquote() << "No image found in" << dir.absolutePath();
+        return false;
+    }
+    // 按人的习惯排序: image2在image10前面
+    QCollator collator;
+    collator.setNumericMode(true);
+    collator.setCaseSensitivity(Qt::CaseInsensitive);
+    std::sort(names.begin(), names.end(), collator);
+
+    close();
+    for (const QString &name : qAsConst(names)) {
+        _files.append(dir.absoluteFilePath(name));
+    }
+    const int index = fileInfo.isDir() ? 0 : _files.indexOf(fileInfo.absoluteFilePath());
+    _current = qMax(0, index);
+    _direction = 1;
+    return true;
+}
+
+void ImageSequence::close()
+{
+    ++_generation;
+    _threadPool.clear();
+    _files.clear();
+    _cache.clear();
+    _pending.clear();
+    _current = -1;
+}
+
+int ImageSequence::count() const
+{
+    return _files.size();
+}
+
+int ImageSequence::currentIndex() const
+{
+    return _current;
+}
+
+QString ImageSequence::filePath(const int index) const
+{
+    return _files.value(index);
+}
+
+bool ImageSequence::seek(const int index, cv::Mat &mat, QImage &image)
+{
+    if (index < 0 || index >= _files.size()) {
+        return false;
+    }
+    if (index != _current) {
+        _direction = index > _current ? 1 : -1;
+        _current = index;
+    }
+    const Entry *const entry = _cache.object(index);
+    schedule();
+    if (nullptr == entry) {
+        return false;
+    }
+    mat = entry->mat;
+    image = entry->image;
+    return true;
+}
+
+void ImageSequence::setConverter(const Converter &converter)
+{
+    _converter = converter ? std::make_shared<const Converter>(converter) : nullptr;
+    // 缓存和正在进行的解码都是按旧的转换函数得到的
+    ++_generation;
+    _threadPool.clear();
+    _cache.clear();
+    _pending.clear();
+    if (_current >= 0) {
+        schedule();
+    }
+}
+
+void ImageSequence::setPrefetchCount(const int ahead, const int behind)
+{
+    _prefetchAhead = qMax(0, ahead);
+    _prefetchBehind = qMax(0, behind);
+}
+
+void ImageSequence::setCacheLimit(const int megaBytes)
+{
+    _cache.setMaxCost(qMax(1, megaBytes) * 1024);
+}
+
+void ImageSequence::schedule()
+{
+    // 当前图像优先, 然后沿浏览方向由近到远, 最后是逆浏览方向
+    const int current = _current;
+    const int direction = _direction;
+    enqueue(current, 1);
+    for (int i = 1; i <= _prefetchAhead; ++i) {
+        enqueue(current + direction * i, 0);
+    }
+    for (int i = 1; i <= _prefetchBehind; ++i) {
+        enqueue(current - direction * i, 0);
+    }
+}
+
+void ImageSequence::enqueue(const int index, const int priority)
+{
+    if (index < 0 || index >= _files.size() || _cache.contains(index) || _pending.contains(index)) {
+        return;
+    }
+    _pending.insert(index);
+    const QString path = _files[index];
+    const std::shared_ptr<const Converter> converter = _converter;
+    const int generation = _generation;
+    _threadPool.start(new DecodeTask([=]() {
+        // 排队期间用户可能已经翻走了, 不再需要的就不解码了
+        const bool wanted = generation == _generation && isWanted(index);
+        cv::Mat mat;
+        QImage image;
+        if (wanted) {
+            mat = VisionLibrary::readImage(path, cv::IMREAD_GRAYSCALE);
+            if (converter && !mat.empty()) {
+                image = (*converter)(mat);
+            }
+        }
+        QMetaObject::invokeMethod(this, [=]() {
+            onDecoded(generation, index, wanted, mat, image);
+        }, Qt::QueuedConnection);
+    }), priority);
+}
+
+void ImageSequence::onDecoded(const int generation, const int index, const bool decoded,
+                              const cv::Mat &mat, const QImage &image)
+{
+    if (generation != _generation) {
+        // 目录或转换函数已经变了
+        return;
+    }
+    _pending.remove(index);
+    if (!decoded) {
+        // 跳过之后用户可能又翻回来了
+        if (isWanted(index)) {
+            enqueue(index, index == _current ? 1 : 0);
+        }
+        return;
+    }
+    if (mat.empty()) {
+        qWarning().noquote() << "Decode image failed:" << _files.value(index);
+    } else {
+        // 超过缓存上限的单幅图像不会被缓存, 但仍然可以显示
+        _cache.insert(index, new Entry{mat, image}, entryCost(mat, image));
+    }
+    if (index == _current) {
+        emit signal_imageReady(index, mat, image);
+    }
+}
+
+bool ImageSequence::isWanted(const int index) const
+{
+    const int offset = (index - _current) * _direction;
+    return offset >= -_prefetchBehind && offset <= _prefetchAhead;
+}
@@ -0,0 +1,99 @@
+﻿#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <QObject>
+#include <QImage>
+#include <QCache>
+#include <QSet>
+#include <QStringList>
+#include <QThreadPool>
+#include <opencv2/opencv.hpp>
+
+/*!
+ * \brief The ImageSequence class 按文件名顺序浏览一个目录中的图像
+ * \note
+ * - 解码结果(cv::Mat和显示用的QImage)放在有内存上限的LRU缓存中;
+ * - 每次切换图像, 后台线程按浏览方向预取前面N幅, 后面M幅, 所以连续翻页时通常直接命中缓存;
+ * - 除了后台任务, 所有函数都只能在GUI线程调用
+ */
+class ImageSequence : public QObject
+{
+    Q_OBJECT
+public:
+    // 显示转换函数, 在后台线程中调用, 必须是线程安全的
+    using Converter = std::function<QImage(const cv::Mat &)>;
+
+    // 默认的缓存上限(MB)
+    static constexpr int DEFAULT_CACHE_LIMIT = 1024;
+    // 默认沿浏览方向预取的幅数
+    static constexpr int DEFAULT_PREFETCH_AHEAD = 3;
+    // 默认逆浏览方向预取的幅数
+    static constexpr int DEFAULT_PREFETCH_BEHIND = 1;
+
+    explicit ImageSequence(QObject *parent = nullptr);
+    // 会等待正在解码的后台任务结束
+    ~ImageSequence() override;
+
+    /*!
+     * \brief open 打开目录
+     * \param path 目录, 或目录中的一幅图像. 是图像时当前位置定位到它, 否则定位到第一幅
+     * \return 目录中没有支持的图像时返回false
+     */
+    bool open(const QString &path);
+    // 关闭目录, 清空缓存
+    void close();
+
+    int count() const;
+    int currentIndex() const;
+    QString filePath(const int index) const;
+
+    /*!
+     * \brief seek 切换到第index幅图像, 并按浏览方向开始预取
+     * \return 已缓存时返回true, 并输出mat和image; 否则返回false, 在后台解码完成后发射signal_imageReady
+     */
+    bool seek(const int index, cv::Mat &mat, QImage &image);
+
+    // 显示转换函数, 为空时只解码不转换(比如延迟转换模式). 改变后缓存作废
+    void setConverter(const Converter &converter);
+    // 预取的幅数: ahead为沿浏览方向, behind为逆浏览方向
+    void setPrefetchCount(const int ahead, const int behind);
+    // 缓存上限(MB)
+    void setCacheLimit(const int megaBytes);
+
+signals:
+    // 当前图像解码完成
+    void signal_imageReady(const int index, const cv::Mat &mat, const QImage &image);
+
+private:
+    struct Entry {
+        cv::Mat mat;
+        QImage image;
+    };
+
+    // 为当前图像和预取窗口中还没有缓存的图像安排后台解码
+    void schedule();
+    // 安排后台解码第index幅图像, priority越大越先执行
+    void enqueue(const int index, const int priority);
+    // 后台解码完成(或因不再需要而跳过), 在GUI线程中调用
+    void onDecoded(const int generation, const int index, const bool decoded, const cv::Mat &mat, const QImage &image);
+    // 第index幅图像是否在当前位置的预取窗口中. 后台线程也会调用
+    bool isWanted(const int index) const;
+
+    QStringList _files;
+    QCache<int, Entry> _cache; // 序号 -> 解码结果, 代价单位KB
+    QSet<int> _pending; // 已安排后台解码但还没有结果的序号
+    std::shared_ptr<const Converter> _converter;
+
+    // 后台线程会读的状态用原子变量.
+    // 每次打开目录或改变转换函数, _generation都加一, 之前的后台结果全部作废
+    std::atomic_int _generation{0};
+    std::atomic_int _current{-1};
+    std::atomic_int _direction{1}; // 浏览方向: 1向后, -1向前
+    std::atomic_int _prefetchAhead{DEFAULT_PREFETCH_AHEAD};
+    std::atomic_int _prefetchBehind{DEFAULT_PREFETCH_BEHIND};
+
+    // 放在最后, 最先析构: 析构时等待后台任务结束, 那时其他成员都还在
+    QThreadPool _threadPool;
+};
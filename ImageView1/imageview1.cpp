@@ -1,9 +1,20 @@
 ﻿#include "imageview1.h"
 #include <QPainter>
 #include <QPaintEvent>
+#include <QKeyEvent>
 #include <QDebug>
-#include <QMessageBox>
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QPointer>
+#include <QtConcurrent>
+#include <QtMath>
+#include <cmath>
+#include <cstring>
+#include "ImageView1/framemailbox.h"
+#include "ImageView1/imagesequence.h"
 #include "VisionLibrary/visionlibrary.h"
+#include "VisionLibrary/imagefile.h"
 #include "CommonLibrary/GlobalTools/globaltools.h"
 
 ImageView1::ImageView1(QWidget *parent) : QWidget(parent)
@@ -11,33 +22,160 @@ ImageView1::ImageView1(QWidget *parent) : QWidget(parent)
     // QWidget默认是不追踪鼠标的, 要一直点着鼠标的一个键移动才能触发mouseMoveEvent.
     // setMouseTracking(true)之后就可以追踪鼠标了
     setMouseTracking(true);
+
+    _frameMailbox = new FrameMailbox(this);
+    // 邮箱在工作线程中发射信号, 这里排队执行
+    connect(_frameMailbox, &FrameMailbox::signal_frameReady, this, &ImageView1::onFrameReady, Qt::QueuedConnection);
+
+    _imageSequence = new ImageSequence(this);
+    connect(_imageSequence, &ImageSequence::signal_imageReady, this, [this](const int, const cv::Mat &mat, const QImage &image) {
+        showSequenceImage(mat, image);
+    });
+    // 用键盘翻页需要焦点
+    setFocusPolicy(Qt::StrongFocus);
+    updateDisplayConverters();
 }
 
 void ImageView1::setMat(const cv::Mat &mat)
 {
-    const QSize oldSize = _image.size();
-    _image = VisionLibrary::toPremultiImage(mat);
-    if (_image.size() != oldSize) {
+    // 延迟转换模式或有显示映射时不转换全图, 瓦片在绘制时才按需转换.
+    // 否则格式允许时_image直接引用mat的内存, 不拷贝像素
+    installMat(mat, isTileConversion() ? QImage() : toDisplayImage(mat));
+}
+
+void ImageView1::installMat(const cv::Mat &mat, const QImage &image)
+{
+    const QSize oldSize = imageSize();
+    _isShowingPreview = false;
+    _image = image;
+    _mat = mat; // 浅拷贝
+    ++_imageGeneration;
+    // 图像内容变了, 金字塔中已生成的层和缓存的瓦片都作废
+    _pyramid.reset(imageSize());
+    if (imageSize() != oldSize) {
         // 如果图像大小发生变化, 那么要重新计算基本变换
         initBasicTransform();
     }
-    _mat = mat; // 浅拷贝
     emit signal_matChanged(_mat);
     update();
 }
 
+void ImageView1::setMat(const cv::Mat &mat, const QRect &dirtyRect)
+{
+    if (_mat.empty() || mat.size != _mat.size || mat.type() != _mat.type()) {
+        // 大小或类型变了, 只能整幅更新
+        setMat(mat);
+        return;
+    }
+    const QRect rect = dirtyRect & QRect(QPoint(0, 0), imageSize());
+    if (!isTileConversion() && !rect.isEmpty()) {
+        updateImageRegion(mat, rect);
+    }
+    _mat = mat; // 浅拷贝
+    // 金字塔和缓存的QPixmap中只有对应的区域需要更新
+    _pyramid.invalidate(_image, rect);
+    if (!rect.isEmpty()) {
+        updateScaledPixmap(rect);
+    }
+    emit signal_matRegionChanged(_mat, rect);
+    if (!rect.isEmpty()) {
+        // 只重绘dirtyRect在窗口中对应的区域, 留一点余量给金字塔上层的像素
+        update(imageTransform().mapRect(QRectF(rect)).toAlignedRect().adjusted(-2, -2, 2, 2));
+    }
+}
+
+// 文件大于这么多字节才先显示预览图, 小文件直接解码就很快
+constexpr qint64 PREVIEW_MIN_FILE_SIZE = 2 * 1024 * 1024;
+// 文件大于这么多字节时预览图缩小到1/8, 否则缩小到1/4
+constexpr qint64 PREVIEW_EIGHTH_FILE_SIZE = 16 * 1024 * 1024;
+
 void ImageView1::loadMatFromPath(const QString &imagePath)
 {
     if (imagePath.isEmpty()) {
         return;
     }
-    // 导入灰度图
-    const cv::Mat tmp = cv::imread(utf8_to_gbk(imagePath), cv::IMREAD_GRAYSCALE);
+    // 新的导入会取消还没有完成的导入
+    const int generation = ++*_loadGeneration;
+    const std::shared_ptr<std::atomic_int> currentGeneration = _loadGeneration;
+    const QPointer<ImageView1> self(this);
+    QElapsedTimer timer;
+    timer.start();
+
+    // 只有JPEG能在解码时直接缩小(DCT缩放), 其他格式的IMREAD_REDUCED_*要先完整解码, 反而更慢
+    const QFileInfo fileInfo(imagePath);
+    const QString suffix = fileInfo.suffix().toLower();
+    const bool withPreview = (QStringLiteral("jpg") == suffix || QStringLiteral("jpeg") == suffix) &&
+                             fileInfo.size() >= PREVIEW_MIN_FILE_SIZE;
+    const int previewFlag = fileInfo.size() >= PREVIEW_EIGHTH_FILE_SIZE ? cv::IMREAD_REDUCED_GRAYSCALE_8 :
+                            cv::IMREAD_REDUCED_GRAYSCALE_4;
+
+    // 在工作线程中解码. 回到GUI线程时以qApp为上下文, 再通过self判断控件是否还存在
+    QtConcurrent::run([=]() {
+        const std::string path = utf8_to_gbk(imagePath);
+        if (withPreview && *currentGeneration == generation) {
+            const cv::Mat preview = cv::imread(path, previewFlag);
+            if (!preview.empty() && *currentGeneration == generation) {
+                const qint64 elapsed = timer.elapsed();
+                QMetaObject::invokeMethod(qApp, [=]() {
+                    if (self && *currentGeneration == generation) {
+                        self->showPreview(preview);
+                        emit self->signal_loadProgress(imagePath, false, elapsed);
+                    }
+                }, Qt::QueuedConnection);
+            }
+        }
+        if (*currentGeneration != generation) {
+            // 已被取消
+            return;
+        }
+        // 导入灰度图. raw/pgm/npy直接映射文件, 不拷贝像素, 并保留原始位深
+        const cv::Mat tmp = VisionLibrary::readImage(imagePath, cv::IMREAD_GRAYSCALE);
+        const qint64 elapsed = timer.elapsed();
+        QMetaObject::invokeMethod(qApp, [=]() {
+            if (self && *currentGeneration == generation) {
+                self->finishLoading(imagePath, tmp, elapsed);
+            }
+        }, Qt::QueuedConnection);
+    });
+}
+
+void ImageView1::cancelLoading()
+{
+    ++*_loadGeneration;
+}
+
+void ImageView1::showPreview(const cv::Mat &preview)
+{
+    setMat(preview);
+    _isShowingPreview = true;
+}
+
+void ImageView1::finishLoading(const QString &imagePath, const cv::Mat &tmp, const qint64 elapsedMs)
+{
     if (tmp.empty()) {
-        QMessageBox::warning(this, QStringLiteral("警告"), QStringLiteral("导入图片{%1}失败!").arg(imagePath));
+        _isShowingPreview = false;
+        // 不在这里弹出模态对话框: 它会重新进入事件循环, 让之后的导入结果和setMat穿插进来. 由调用者决定如何提示
+        emit signal_loadFailed(imagePath);
         return;
     }
-    setMat(tmp);
+    if (_isShowingPreview && !_mat.empty()) {
+        // 正在显示预览图: 换成原图之后保持用户在预览图上的缩放和平移
+        const double ratio = double(_mat.cols) / tmp.cols;
+        double matrix[2][2];
+        std::memcpy(matrix, _matrix, sizeof(matrix));
+        const QPointF offset = _offset;
+        setMat(tmp);
+        for (int i = 0; i < 2; ++i) {
+            for (int j = 0; j < 2; ++j) {
+                _matrix[i][j] = matrix[i][j] * ratio;
+            }
+        }
+        _offset = offset;
+        update();
+    } else {
+        setMat(tmp);
+    }
+    emit signal_loadProgress(imagePath, true, elapsedMs);
     emit signal_matLoaded(tmp);
 }
 
@@ -46,11 +184,211 @@ const cv::Mat &ImageView1::mat() const
     return _mat;
 }
 
+QSize ImageView1::imageSize() const
+{
+    return QSize(_mat.cols, _mat.rows);
+}
+
+void ImageView1::setLazyConversion(const bool enabled)
+{
+    if (enabled == _lazyConversion) {
+        return;
+    }
+    _lazyConversion = enabled;
+    updateDisplayConverters();
+    // 用当前图像重新走一遍转换流程
+    setMat(_mat);
+}
+
+bool ImageView1::isLazyConversion() const
+{
+    return _lazyConversion;
+}
+
+void ImageView1::setDisplayMapping(const VisionLibrary::DisplayMapping &mapping)
+{
+    if (mapping == _displayMapping) {
+        return;
+    }
+    const bool wasTileConversion = isTileConversion();
+    _displayMapping = mapping;
+    // 只换瓦片的转换函数并清空转换好的瓦片. 金字塔保留缩小的原始瓦片,
+    // 下次绘制时只对可见的瓦片重新查表转换, 不再从原图缩小
+    _pyramid.setTileConverter([mapping](const cv::Mat &tile) {
+        return VisionLibrary::toPremultiImage(tile, mapping);
+    });
+    if (wasTileConversion != isTileConversion()) {
+        // 在整幅转换和按瓦片转换之间切换, 金字塔中由整幅图像生成的层也作废
+        updateDisplayConverters();
+        _image = isTileConversion() ? QImage() : toDisplayImage(_mat);
+        _pyramid.reset(imageSize());
+    }
+    // 图像没变, 只是显示内容变了, 缓存的QPixmap要重新渲染
+    ++_imageGeneration;
+    update();
+    emit signal_displayMappingChanged(_displayMapping);
+}
+
+VisionLibrary::DisplayMapping ImageView1::displayMapping() const
+{
+    return _displayMapping;
+}
+
+void ImageView1::autoStretch()
+{
+    if (!_mat.empty()) {
+        setDisplayMapping(VisionLibrary::autoStretch(_mat));
+    }
+}
+
+void ImageView1::resetDisplayMapping()
+{
+    setDisplayMapping(VisionLibrary::DisplayMapping());
+}
+
+bool ImageView1::isTileConversion() const
+{
+    return _lazyConversion || !_displayMapping.isIdentity();
+}
+
+void ImageView1::setOpaqueAlpha(const bool opaque)
+{
+    if (opaque == _opaqueAlpha) {
+        return;
+    }
+    _opaqueAlpha = opaque;
+    updateDisplayConverters();
+    if (CV_8UC4 == _mat.type()) {
+        setMat(_mat);
+    }
+}
+
+bool ImageView1::isOpaqueAlpha() const
+{
+    return _opaqueAlpha;
+}
+
+QImage ImageView1::toDisplayImage(const cv::Mat &mat) const
+{
+    if (CV_8UC4 == mat.type() && !_opaqueAlpha) {
+        // 检查alpha要读一遍整幅图像, 开销与转换相当, 不如直接转换
+        return VisionLibrary::toPremultiImage(mat);
+    }
+    return VisionLibrary::toDisplayImage(mat, true, _opaqueAlpha);
+}
+
+void ImageView1::setPixelGridEnabled(const bool enabled)
+{
+    _pixelGridEnabled = enabled;
+    update();
+}
+
+bool ImageView1::isPixelGridEnabled() const
+{
+    return _pixelGridEnabled;
+}
+
+void ImageView1::setTileCacheLimit(const int megaBytes)
+{
+    _pyramid.setTileCacheLimit(megaBytes);
+}
+
+FrameMailbox *ImageView1::frameMailbox() const
+{
+    return _frameMailbox;
+}
+
+void ImageView1::onFrameReady()
+{
+    cv::Mat mat;
+    QImage image;
+    if (!_frameMailbox->take(mat, image)) {
+        return;
+    }
+    // 帧可能是在切换转换模式之前转换的
+    if (isTileConversion()) {
+        image = QImage();
+    } else if (image.isNull()) {
+        image = toDisplayImage(mat);
+    }
+    installMat(mat, image);
+}
+
+void ImageView1::updateDisplayConverters()
+{
+    if (isTileConversion()) {
+        // 延迟转换模式或有显示映射时不需要整幅转换
+        _frameMailbox->setConverter(nullptr);
+        _imageSequence->setConverter(nullptr);
+    } else {
+        // 在工作线程中转换, 可以检查alpha
+        const auto converter = [opaque = _opaqueAlpha](const cv::Mat &mat) {
+            return VisionLibrary::toDisplayImage(mat, true, opaque);
+        };
+        _frameMailbox->setConverter(converter);
+        _imageSequence->setConverter(converter);
+    }
+}
+
+bool ImageView1::openImageSequence(const QString &path)
+{
+    if (!_imageSequence->open(path)) {
+        return false;
+    }
+    showImageAt(_imageSequence->currentIndex());
+    return true;
+}
+
+ImageSequence *ImageView1::imageSequence() const
+{
+    return _imageSequence;
+}
+
+void ImageView1::showNextImage()
+{
+    showImageAt(_imageSequence->currentIndex() + 1);
+}
+
+void ImageView1::showPreviousImage()
+{
+    showImageAt(_imageSequence->currentIndex() - 1);
+}
+
+void ImageView1::showImageAt(const int index)
+{
+    if (index < 0 || index >= _imageSequence->count()) {
+        return;
+    }
+    cv::Mat mat;
+    QImage image;
+    const bool cached = _imageSequence->seek(index, mat, image);
+    emit signal_sequenceIndexChanged(index, _imageSequence->filePath(index));
+    if (cached) {
+        showSequenceImage(mat, image);
+    }
+    // 否则在后台解码完成后由signal_imageReady显示, 在此之前继续显示上一幅
+}
+
+void ImageView1::showSequenceImage(const cv::Mat &mat, const QImage &image)
+{
+    if (mat.empty()) {
+        return;
+    }
+    // 翻页优先于还没有完成的异步导入
+    cancelLoading();
+    // 图像可能是在切换转换模式之前转换的
+    installMat(mat, isTileConversion() ? QImage() : image.isNull() ? toDisplayImage(mat) : image);
+    emit signal_matLoaded(_mat);
+}
+
 void ImageView1::paintEvent(QPaintEvent *)
 {
     QPainter painter(this);
     drawBackground(painter);
     drawImage(painter);
+    if (_pixelGridEnabled) {
+        drawPixelGrid(painter);
+    }
 }
 
 void ImageView1::mousePressEvent(QMouseEvent *event)
@@ -104,25 +442,55 @@ void ImageView1::resizeEvent(QResizeEvent *)
     // 之后会自动调用paintEvent, 所以这里不用调用update()
 }
 
+void ImageView1::keyPressEvent(QKeyEvent *event)
+{
+    if (_imageSequence->count() <= 0) {
+        QWidget::keyPressEvent(event);
+        return;
+    }
+    switch (event->key()) {
+    case Qt::Key_Right:
+    case Qt::Key_Down:
+    case Qt::Key_PageDown:
+        showNextImage();
+        break;
+    case Qt::Key_Left:
+    case Qt::Key_Up:
+    case Qt::Key_PageUp:
+        showPreviousImage();
+        break;
+    case Qt::Key_Home:
+        showImageAt(0);
+        break;
+    case Qt::Key_End:
+        showImageAt(_imageSequence->count() - 1);
+        break;
+    default:
+        QWidget::keyPressEvent(event);
+        break;
+    }
+}
+
 void ImageView1::initBasicTransform()
 {
-    if (_image.isNull()) {
+    const QSize size = imageSize();
+    if (size.isEmpty()) {
         // 图像为空就不进行计算了, 不然后面的计算中可能出现0除错误
         return;
     }
     _matrix[0][1] = _matrix[1][0] = 0.0;
-    const double heightRatio = height() / double(_image.height());
-    const double widthRatio = width() / double(_image.width());
+    const double heightRatio = height() / double(size.height());
+    const double widthRatio = width() / double(size.width());
     if (heightRatio < widthRatio) {
         // window的width比较长, 则左右有黑边
         _matrix[0][0] = _matrix[1][1] = heightRatio;
-        _offset.setX(_image.width() * (widthRatio - heightRatio) * 0.5);
+        _offset.setX(size.width() * (widthRatio - heightRatio) * 0.5);
         _offset.setY(0.0);
     } else {
         // window的height比较长, 则上下有黑边
         _matrix[0][0] = _matrix[1][1] = widthRatio;
         _offset.setX(0.0);
-        _offset.setY(_image.height() * (heightRatio - widthRatio) * 0.5);
+        _offset.setY(size.height() * (heightRatio - widthRatio) * 0.5);
     }
 }
 
@@ -136,6 +504,42 @@ void ImageView1::scale(const double scaleFactor)
     _offset *= scaleFactor;
 }
 
+QTransform ImageView1::imageTransform() const
+{
+    return QTransform(_matrix[0][0], _matrix[0][1],
+                      _matrix[1][0], _matrix[1][1],
+                      _offset.x(), _offset.y());
+}
+
+double ImageView1::currentScale() const
+{
+    // 基本变换只有等比缩放, 行列式开方就是缩放比例
+    return std::sqrt(std::abs(_matrix[0][0] * _matrix[1][1] - _matrix[1][0] * _matrix[0][1]));
+}
+
+void ImageView1::updateImageRegion(const cv::Mat &mat, const QRect &dirtyRect)
+{
+    if (QImage::Format_ARGB32_Premultiplied != _image.format()) {
+        // _image是直接引用_mat内存的零拷贝包装
+        if (mat.data != _mat.data) {
+            // 换了一块内存, 重新包装一下就行, 不拷贝像素
+            _image = toDisplayImage(mat);
+        }
+        // 同一块内存被原地修改, _image已经是最新的了
+        return;
+    }
+    // _image是转换出来的拷贝, 只转换dirtyRect内的像素, 再复制到_image中
+    const QImage patch = VisionLibrary::toPremultiImage(mat(VisionLibrary::toCvRect(dirtyRect)));
+    if (patch.isNull()) {
+        return;
+    }
+    const int bytesPerPixel = 4;
+    for (int i = 0; i < patch.height(); ++i) {
+        uchar *const destRow = _image.scanLine(dirtyRect.top() + i) + dirtyRect.left() * bytesPerPixel;
+        std::memcpy(destRow, patch.constScanLine(i), static_cast<size_t>(patch.width()) * bytesPerPixel);
+    }
+}
+
 void ImageView1::drawBackground(QPainter &painter)
 {
     painter.save();
@@ -149,12 +553,216 @@ void ImageView1::drawBackground(QPainter &painter)
 
 void ImageView1::drawImage(QPainter &painter)
 {
+    if (_mat.empty()) {
+        return;
+    }
+    if (drawScaledPixmap(painter)) {
+        // 平移时只是贴图
+        return;
+    }
     painter.save();
     // 绘制图片
-    painter.setWorldTransform(QTransform(_matrix[0][0], _matrix[0][1],
-                                         _matrix[1][0], _matrix[1][1],
-                                         _offset.x(), _offset.y()));
-    painter.drawImage(0, 0, _image);
+    const QTransform transform = imageTransform();
+    painter.setWorldTransform(transform);
+    // 只画窗口内可见的瓦片, 并按缩放比例(设备像素)选用金字塔中合适的层
+    const QRectF exposedRect = transform.inverted().mapRect(QRectF(rect()));
+    drawPyramid(painter, exposedRect, currentScale() * devicePixelRatioF());
+
+    painter.restore();
+}
+
+void ImageView1::drawPyramid(QPainter &painter, const QRectF &exposedRect, const double scale)
+{
+    if (isTileConversion()) {
+        _pyramid.draw(painter, _mat, exposedRect, scale);
+    } else {
+        _pyramid.draw(painter, _image, exposedRect, scale);
+    }
+}
+
+// 缩放之后的图像面积不超过窗口面积的这么多倍, 才缓存成QPixmap. 放得很大时缓存整幅图像太占内存, 直接画瓦片
+constexpr int MAX_SCALED_PIXMAP_AREA_RATIO = 4;
+
+bool ImageView1::drawScaledPixmap(QPainter &painter)
+{
+    const double scale = currentScale();
+    const double dpr = devicePixelRatioF();
+    // 缓存按设备像素渲染, HiDPI屏幕上不会模糊. 设备像素坐标系中的平移量分成两部分:
+    // 整数部分用于贴图(不重新采样), 小数部分渲染进缓存, 这样图像与像素网格用的是同一个_offset
+    const QPointF deviceOffset = _offset * dpr;
+    const QPoint pixelOffset(qFloor(deviceOffset.x()), qFloor(deviceOffset.y()));
+    const QPointF subpixelOffset = deviceOffset - QPointF(pixelOffset);
+    const QSize deviceSize(qCeil(_mat.cols * scale * dpr + subpixelOffset.x()), qCeil(_mat.rows * scale * dpr + subpixelOffset.y()));
+    // 缩放或连续送图时每一帧的状态都不同, 渲染缓存反而比直接画可见的瓦片慢.
+    // 只有与上一次绘制的缩放比例和图像都相同(只是平移或重绘)时才渲染缓存
+    const bool isSteady = _lastPaintScale == scale && _lastPaintGeneration == _imageGeneration;
+    _lastPaintScale = scale;
+    _lastPaintGeneration = _imageGeneration;
+    if (0.0 != _matrix[0][1] || 0.0 != _matrix[1][0] || deviceSize.isEmpty() ||
+            qint64(deviceSize.width()) * deviceSize.height() > MAX_SCALED_PIXMAP_AREA_RATIO * width() * height() * dpr * dpr) {
+        _scaledPixmap = QPixmap();
+        return false;
+    }
+    if (_scaledPixmap.isNull() || _scaledPixmapScale != scale || _scaledPixmapGeneration != _imageGeneration ||
+            _scaledPixmapWidgetSize != size() || _scaledPixmap.devicePixelRatioF() != dpr ||
+            _scaledPixmapSubpixelOffset != subpixelOffset) {
+        if (!isSteady) {
+            return false;
+        }
+        // 缩放比例, 图像, 窗口大小, 设备像素比或平移量的小数部分变了, 重新渲染.
+        // 整数个设备像素的平移(比如拖动)直接贴图
+        _scaledPixmap = QPixmap(deviceSize);
+        _scaledPixmap.setDevicePixelRatio(dpr);
+        _scaledPixmap.fill(Qt::transparent);
+        _scaledPixmapScale = scale;
+        _scaledPixmapGeneration = _imageGeneration;
+        _scaledPixmapWidgetSize = size();
+        _scaledPixmapSubpixelOffset = subpixelOffset;
+        QPainter pixmapPainter(&_scaledPixmap);
+        setScaledPixmapTransform(pixmapPainter);
+        drawPyramid(pixmapPainter, QRectF(0.0, 0.0, _mat.cols, _mat.rows), scale * dpr);
+    }
+    painter.drawPixmap(QPointF(pixelOffset) / dpr, _scaledPixmap);
+    return true;
+}
+
+void ImageView1::setScaledPixmapTransform(QPainter &pixmapPainter) const
+{
+    // pixmapPainter的坐标是逻辑像素, 而平移量的小数部分是设备像素
+    pixmapPainter.translate(_scaledPixmapSubpixelOffset / _scaledPixmap.devicePixelRatioF());
+    pixmapPainter.scale(_scaledPixmapScale, _scaledPixmapScale);
+}
+
+void ImageView1::updateScaledPixmap(const QRect &dirtyRect)
+{
+    if (_scaledPixmap.isNull() || _scaledPixmapGeneration != _imageGeneration) {
+        return;
+    }
+    // 只重新渲染缓存中dirtyRect对应的部分
+    QPainter pixmapPainter(&_scaledPixmap);
+    setScaledPixmapTransform(pixmapPainter);
+    // 金字塔上层的一个像素对应原图多个像素, 留一点余量
+    const QRectF exposedRect = QRectF(dirtyRect).adjusted(-2.0, -2.0, 2.0, 2.0);
+    pixmapPainter.setClipRect(exposedRect);
+    pixmapPainter.setCompositionMode(QPainter::CompositionMode_Source);
+    // 按设备像素选择金字塔的层
+    drawPyramid(pixmapPainter, exposedRect, _scaledPixmapScale * _scaledPixmap.devicePixelRatioF());
+}
 
+// 像素值文字的大小
+constexpr int PIXEL_TEXT_PIXEL_SIZE = 11;
+// 像素值文字的行高
+constexpr double PIXEL_TEXT_LINE_HEIGHT = 13.0;
+// 排版缓存的上限, 超过就清空
+constexpr int MAX_GLYPH_CACHE_SIZE = 8192;
+
+// 读取_mat中第(row, column)个像素第channel通道的值
+template <typename T>
+static double pixelValue(const cv::Mat &mat, const int row, const int column, const int channel)
+{
+    return mat.ptr<T>(row)[column * mat.channels() + channel];
+}
+
+static double pixelValue(const cv::Mat &mat, const int row, const int column, const int channel)
+{
+    switch (mat.depth()) {
+    case CV_8U:
+        return pixelValue<uchar>(mat, row, column, channel);
+    case CV_8S:
+        return pixelValue<schar>(mat, row, column, channel);
+    case CV_16U:
+        return pixelValue<ushort>(mat, row, column, channel);
+    case CV_16S:
+        return pixelValue<short>(mat, row, column, channel);
+    case CV_32S:
+        return pixelValue<int>(mat, row, column, channel);
+    case CV_32F:
+        return pixelValue<float>(mat, row, column, channel);
+    case CV_64F:
+        return pixelValue<double>(mat, row, column, channel);
+    default:
+        return 0.0;
+    }
+}
+
+void ImageView1::drawPixelGrid(QPainter &painter)
+{
+    const double scale = currentScale();
+    if (_mat.empty() || scale < PIXEL_GRID_MIN_SCALE) {
+        return;
+    }
+    // 通过基本变换的逆变换求出窗口内可见的像素范围, 只画这些像素
+    const QTransform transform = imageTransform();
+    const QRectF visibleRect = transform.inverted().mapRect(QRectF(rect()));
+    const int firstColumn = qMax(0, qFloor(visibleRect.left()));
+    const int lastColumn = qMin(_mat.cols - 1, qFloor(visibleRect.right()));
+    const int firstRow = qMax(0, qFloor(visibleRect.top()));
+    const int lastRow = qMin(_mat.rows - 1, qFloor(visibleRect.bottom()));
+    if (firstColumn > lastColumn || firstRow > lastRow) {
+        return;
+    }
+
+    painter.save();
+    // 网格线
+    QVector<QLineF> lines;
+    lines.reserve(lastColumn - firstColumn + lastRow - firstRow + 4);
+    const QPointF topLeft = transform.map(QPointF(firstColumn, firstRow));
+    const QPointF bottomRight = transform.map(QPointF(lastColumn + 1, lastRow + 1));
+    for (int column = firstColumn; column <= lastColumn + 1; ++column) {
+        const double x = transform.map(QPointF(column, 0.0)).x();
+        lines.append(QLineF(x, topLeft.y(), x, bottomRight.y()));
+    }
+    for (int row = firstRow; row <= lastRow + 1; ++row) {
+        const double y = transform.map(QPointF(0.0, row)).y();
+        lines.append(QLineF(topLeft.x(), y, bottomRight.x(), y));
+    }
+    painter.setPen(QPen(QColor(128, 128, 128, 160), 0));
+    painter.drawLines(lines);
+
+    // 像素值. 每个通道一行, 要能放下所有行才画
+    const int channels = _mat.channels();
+    if (scale >= qMax(PIXEL_TEXT_MIN_SCALE, PIXEL_TEXT_LINE_HEIGHT * (channels + 1))) {
+        QFont font = painter.font();
+        font.setPixelSize(PIXEL_TEXT_PIXEL_SIZE);
+        painter.setFont(font);
+        const bool isFloat = CV_32F == _mat.depth() || CV_64F == _mat.depth();
+        const int colorChannels = qMin(channels, 3);
+        for (int row = firstRow; row <= lastRow; ++row) {
+            for (int column = firstColumn; column <= lastColumn; ++column) {
+                const QPointF center = transform.map(QPointF(column + 0.5, row + 0.5));
+                // 按显示映射之后的灰度选择颜色: 暗的像素用白字, 亮的像素用黑字. 4通道的alpha不参与映射, 不算在内
+                double brightness = 0.0;
+                for (int channel = 0; channel < colorChannels; ++channel) {
+                    brightness += VisionLibrary::displayIntensity(pixelValue(_mat, row, column, channel), _mat.depth(),
+                                                                  _displayMapping);
+                }
+                painter.setPen(brightness / colorChannels < 0.5 ? Qt::white : Qt::black);
+                double y = center.y() - PIXEL_TEXT_LINE_HEIGHT * channels * 0.5;
+                for (int channel = 0; channel < channels; ++channel) {
+                    const double value = pixelValue(_mat, row, column, channel);
+                    const QStaticText &text = glyph(isFloat ? QString::number(value, 'g', 4)
+                                                    : QString::number(qint64(value)), font);
+                    painter.drawStaticText(QPointF(center.x() - text.size().width() * 0.5, y), text);
+                    y += PIXEL_TEXT_LINE_HEIGHT;
+                }
+            }
+        }
+    }
     painter.restore();
 }
+
+const QStaticText &ImageView1::glyph(const QString &text, const QFont &font)
+{
+    auto it = _glyphCache.find(text);
+    if (it == _glyphCache.end()) {
+        if (_glyphCache.size() >= MAX_GLYPH_CACHE_SIZE) {
+            _glyphCache.clear();
+        }
+        QStaticText staticText(text);
+        staticText.setPerformanceHint(QStaticText::AggressiveCaching);
+        // 事先排版, 之后每次绘制都不用再排版
+        staticText.prepare(QTransform(), font);
+        it = _glyphCache.insert(text, staticText);
+    }
+    return it.value();
+}
@@ -1,21 +1,119 @@
 ﻿#pragma once
 
+#include <atomic>
+#include <memory>
 #include <QWidget>
 #include <QImage>
+#include <QPixmap>
+#include <QTransform>
+#include <QHash>
+#include <QStaticText>
 #include <opencv2/opencv.hpp>
+#include "ImageView1/tilepyramid.h"
+#include "VisionLibrary/visionlibrary.h"
+
+class FrameMailbox;
+class ImageSequence;
 
 class ImageView1 : public QWidget
 {
     Q_OBJECT
 public:
+    // 一个图像像素至少占这么多个窗口像素, 才画像素网格
+    static constexpr double PIXEL_GRID_MIN_SCALE = 12.0;
+    // 一个图像像素至少占这么多个窗口像素, 才能横向放下像素值文字
+    static constexpr double PIXEL_TEXT_MIN_SCALE = 40.0;
+
     explicit ImageView1(QWidget *parent = nullptr);
 
     const cv::Mat &mat() const;
+    // 图像大小(图像坐标系)
+    QSize imageSize() const;
+
+    /*!
+     * \brief setLazyConversion 延迟转换模式
+     * \param enabled 为true时只保留_mat, 不再整幅转换成_image,
+     * 而是在瓦片第一次可见时才转换, 转换结果放在有容量上限的缓存中.
+     * 适合很大的图像: 省掉一份ARGB32的全图拷贝, setMat几乎不耗时
+     */
+    void setLazyConversion(const bool enabled);
+    bool isLazyConversion() const;
+    // 延迟转换模式下瓦片缓存的容量上限(MB)
+    void setTileCacheLimit(const int megaBytes);
+
+    /*!
+     * \brief setDisplayMapping 显示映射(窗宽/窗位/gamma), 用于显示12/16位图像和浮点图像
+     * \note 有显示映射时总是按瓦片转换(同延迟转换模式). 改变映射只清空转换好的瓦片, 重绘时只对可见的瓦片重新转换,
+     * 金字塔上层缩小的原始瓦片是缓存的, 不再从原图缩小. 所以拖动窗宽窗位的滑块时, 耗时只与窗口大小有关,
+     * 与图像大小无关. 像素网格中显示的仍是原始值, 文字的颜色按映射之后的灰度选择
+     */
+    void setDisplayMapping(const VisionLibrary::DisplayMapping &mapping);
+    VisionLibrary::DisplayMapping displayMapping() const;
+
+    /*!
+     * \brief setOpaqueAlpha 声明CV_8UC4的图像总是不透明(alpha全为255), 比如相机的BGRA帧
+     * \note 为true时CV_8UC4直接零拷贝显示, 不检查alpha. 为false(默认)时GUI线程中不逐帧扫描alpha, 直接转换成预乘格式;
+     * 邮箱和图像序列在工作线程中转换, 仍然检查alpha, 全为255时零拷贝
+     */
+    void setOpaqueAlpha(const bool opaque);
+    bool isOpaqueAlpha() const;
+
+    /*!
+     * \brief frameMailbox 用于从采集线程送图的邮箱
+     * \note 采集线程直接调用frameMailbox()->publish(mat), 不需要排队连接到setMat.
+     * 显示转换在邮箱的工作线程中进行, GUI线程总是显示最新的一帧, 来不及显示的旧帧被丢掉并计数.
+     * 与setMat不同, 经由邮箱显示的帧不会触发子类对setMat的重写(比如ImageView2不会清除选框)
+     */
+    FrameMailbox *frameMailbox() const;
+
+    /*!
+     * \brief openImageSequence 打开path所在的目录, 按文件名顺序浏览其中的图像
+     * \param path 目录, 或目录中的一幅图像. 是图像时先显示它, 否则显示第一幅
+     * \return 目录中没有支持的图像时返回false
+     * \note 之后用showNextImage/showPreviousImage, 或者键盘的左右方向键, PageUp/PageDown, Home/End翻页.
+     * 解码结果有LRU缓存, 并在后台按浏览方向预取, 连续翻页时通常不用等待解码.
+     * 与setMat不同, 翻页不会触发子类对setMat的重写(比如ImageView2的选框会保留, 便于在一组图像上比较同一区域)
+     */
+    bool openImageSequence(const QString &path);
+    // 浏览目录用的图像序列, 可以调整预取幅数和缓存上限
+    ImageSequence *imageSequence() const;
+
+    /*!
+     * \brief setPixelGridEnabled 像素网格模式, 默认打开
+     * \note 放大到一个图像像素占PIXEL_GRID_MIN_SCALE个窗口像素以上时画出像素边界,
+     * 再放大到能放下文字时在每个像素中显示_mat的原始值. 只画窗口内可见的像素
+     */
+    void setPixelGridEnabled(const bool enabled);
+    bool isPixelGridEnabled() const;
 
 public slots:
     virtual void setMat(const cv::Mat &mat);
+    /*!
+     * \brief setMat 局部更新: 与当前图像相比, 只有dirtyRect(图像坐标系)内的像素变了
+     * \note 只重新转换dirtyRect内的像素, 只重绘它在窗口中对应的区域.
+     * 如果mat的大小或类型与当前图像不同, 退化为整幅更新
+     */
+    void setMat(const cv::Mat &mat, const QRect &dirtyRect);
 
+    /*!
+     * \brief loadMatFromPath 异步导入灰度图
+     * \note 在工作线程中解码, 不阻塞GUI线程. 较大的JPEG先用IMREAD_REDUCED_GRAYSCALE_4/8(解码时DCT缩放)
+     * 显示一幅预览图, 解码完成后再换成原图. signal_matLoaded只在原图导入完成时发射, 失败时发射signal_loadFailed.
+     * 再次调用会取消还没有完成的导入
+     */
     void loadMatFromPath(const QString &path);
+    // 取消正在进行的导入. 正在进行的解码无法中断, 但结果会被丢掉
+    void cancelLoading();
+
+    // 图像序列翻页
+    void showNextImage();
+    void showPreviousImage();
+    void showImageAt(const int index);
+
+    // 按当前图像的直方图自动设置显示映射
+    void autoStretch();
+    // 恢复为恒等映射, 即按类型的惯例显示
+    void resetDisplayMapping();
 protected:
     void paintEvent(QPaintEvent *event) override;
     // 鼠标事件
@@ -25,22 +123,98 @@ protected:
     void wheelEvent(QWheelEvent *event) override;
     // 控件大小改变事件
     void resizeEvent(QResizeEvent *event) override;
+    // 键盘事件, 用于图像序列翻页
+    void keyPressEvent(QKeyEvent *event) override;
 signals:
     void signal_matChanged(const cv::Mat &mat);
+    // 局部更新, dirtyRect位于图像坐标系
+    void signal_matRegionChanged(const cv::Mat &mat, const QRect &dirtyRect);
     void signal_matLoaded(const cv::Mat &mat);
+    // 导入进度: finished为false表示显示了预览图, 为true表示原图导入完成. elapsedMs是从调用loadMatFromPath开始的耗时
+    void signal_loadProgress(const QString &path, const bool finished, const qint64 elapsedMs);
+    // 异步导入失败(文件不存在或无法解码). 之前显示的图像(包括预览图)保持不变
+    void signal_loadFailed(const QString &path);
+    // 图像序列翻到了第index幅. 图像可能还在解码, 显示时会发射signal_matLoaded
+    void signal_sequenceIndexChanged(const int index, const QString &path);
+    void signal_displayMappingChanged(const VisionLibrary::DisplayMapping &mapping);
 protected:
     // 每当窗口大小或图像大小改变, 都要重新计算一次基本变换
     void initBasicTransform();
     void scale(const double scaleFactor);
+    // 图像坐标系 -> 窗口坐标系的变换
+    QTransform imageTransform() const;
+    // 当前的缩放比例(窗口像素/图像像素)
+    double currentScale() const;
+
+    // 异步导入: 显示预览图
+    void showPreview(const cv::Mat &preview);
+    // 异步导入: 原图解码完成
+    void finishLoading(const QString &imagePath, const cv::Mat &tmp, const qint64 elapsedMs);
+
+    // 显示新图像, image是mat转换得到的显示图像(延迟转换模式下为空)
+    void installMat(const cv::Mat &mat, const QImage &image);
+    // 邮箱中有新的已转换帧
+    void onFrameReady();
+    // 是否按瓦片转换: 延迟转换模式, 或者有显示映射
+    bool isTileConversion() const;
+    // 在GUI线程中整幅转换, 不扫描CV_8UC4的alpha
+    QImage toDisplayImage(const cv::Mat &mat) const;
+    // 邮箱和图像序列的转换函数要与转换模式一致
+    void updateDisplayConverters();
+    // 显示图像序列中的一幅, image是后台转换好的显示图像(可能为空)
+    void showSequenceImage(const cv::Mat &mat, const QImage &image);
+
+    // 局部更新_image中dirtyRect内的像素
+    void updateImageRegion(const cv::Mat &mat, const QRect &dirtyRect);
 
     // 绘制背景
     void drawBackground(QPainter &painter);
     // 绘制图片
     void drawImage(QPainter &painter);
+    // 用金字塔画出图像中与exposedRect(图像坐标系)相交的部分, painter的世界变换要事先设置好
+    void drawPyramid(QPainter &painter, const QRectF &exposedRect, const double scale);
+    // 用缓存的QPixmap绘制, 不能用缓存(比如放得太大, 或正在缩放)时返回false
+    bool drawScaledPixmap(QPainter &painter);
+    // 在缓存的QPixmap上绘制时的变换: 图像坐标系 -> QPixmap的逻辑坐标系
+    void setScaledPixmapTransform(QPainter &pixmapPainter) const;
+    // 局部更新之后, 重新渲染缓存的QPixmap中对应的部分
+    void updateScaledPixmap(const QRect &dirtyRect);
+    // 绘制像素网格和像素值
+    void drawPixelGrid(QPainter &painter);
+    // 像素值的文字, 排版结果缓存起来. 缓存只按文字区分, 所以font要保持不变
+    const QStaticText &glyph(const QString &text, const QFont &font);
 
-    // 原图
+    // 原图. 延迟转换模式下_image为空
     QImage _image;
     cv::Mat _mat;
+    // 多分辨率金字塔, 只画可见区域内的瓦片
+    TilePyramid _pyramid;
+    bool _lazyConversion = false; // 是否为延迟转换模式
+    VisionLibrary::DisplayMapping _displayMapping; // 显示映射, 默认是恒等映射
+    bool _opaqueAlpha = false; // CV_8UC4的图像是否由调用者保证不透明
+    quint64 _imageGeneration = 0; // 图像内容每整幅变化一次就加一
+
+    // 按当前缩放比例渲染好的整幅图像, 分辨率是设备像素. 平移整数个设备像素时直接贴这张图, 不用重新采样.
+    // 缩放比例, 图像, 窗口大小, 设备像素比或平移量的小数部分变化时才重新渲染
+    QPixmap _scaledPixmap;
+    double _scaledPixmapScale = 0.0;
+    quint64 _scaledPixmapGeneration = 0;
+    QSize _scaledPixmapWidgetSize;
+    QPointF _scaledPixmapSubpixelOffset; // 渲染进缓存的平移量的小数部分(设备像素)
+    // 上一次绘制时的缩放比例和图像代数, 用于判断是否正在缩放或连续送图
+    double _lastPaintScale = 0.0;
+    quint64 _lastPaintGeneration = 0;
+
+    bool _pixelGridEnabled = true; // 是否打开像素网格模式
+    QHash<QString, QStaticText> _glyphCache; // 像素值文字 -> 排版好的文字
+
+    FrameMailbox *_frameMailbox;
+    ImageSequence *_imageSequence;
+
+    // 异步导入的代数, 每次导入或取消都加一, 工作线程据此判断自己是否已被取消.
+    // 用shared_ptr是因为工作线程可能比控件活得更久
+    std::shared_ptr<std::atomic_int> _loadGeneration = std::make_shared<std::atomic_int>(0);
+    bool _isShowingPreview = false; // 当前显示的是不是异步导入的预览图
 
     // 基本变换 = _matrix + _offset
     double _matrix[2][2] {
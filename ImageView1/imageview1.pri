@@ -0,0 +1,16 @@
+# ImageView1及其依赖. GUI程序和渲染基准测试共用
+QT += widgets
+
+SOURCES += \
+    $$PWD/framemailbox.cpp \
+    $$PWD/imagesequence.cpp \
+    $$PWD/imageview1.cpp \
+    $$PWD/tilepyramid.cpp
+
+HEADERS += \
+    $$PWD/framemailbox.h \
+    $$PWD/imagesequence.h \
+    $$PWD/imageview1.h \
+    $$PWD/tilepyramid.h
+
+include($$PWD/../VisionLibrary/visionlibrary.pri)
@@ -0,0 +1,304 @@
+﻿#include "tilepyramid.h"
+#include <QPainter>
+#include <QDebug>
+#include <cmath>
+#include "VisionLibrary/visionlibrary.h"
+#include "VisionLibrary/bufferpool.h"
+
+cv::Mat wrapImageAsMat(const QImage &image)
+{
+    int type = -1;
+    switch (image.format()) {
+    case QImage::Format_Grayscale8:
+        type = CV_8UC1;
+        break;
+    case QImage::Format_RGB888:
+    case QImage::Format_BGR888:
+        type = CV_8UC3;
+        break;
+    case QImage::Format_RGB32:
+    case QImage::Format_ARGB32:
+    case QImage::Format_ARGB32_Premultiplied:
+    case QImage::Format_RGBX8888:
+    case QImage::Format_RGBA8888:
+    case QImage::Format_RGBA8888_Premultiplied:
+        type = CV_8UC4;
+        break;
+    default:
+        return cv::Mat();
+    }
+    // 只读包装, 调用者不能通过返回值修改image
+    return cv::Mat(image.height(), image.width(), type,
+                   const_cast<uchar *>(image.constBits()),
+                   static_cast<size_t>(image.bytesPerLine()));
+}
+
+// 瓦片缓存默认容量(MB)
+constexpr int DEFAULT_TILE_CACHE_LIMIT = 256;
+
+TilePyramid::TilePyramid()
+{
+    _converter = [](const cv::Mat &tile) {
+        return VisionLibrary::toPremultiImage(tile);
+    };
+    setTileCacheLimit(DEFAULT_TILE_CACHE_LIMIT);
+}
+
+void TilePyramid::reset(const QSize &baseSize)
+{
+    _baseSize = baseSize;
+    _levels.clear();
+    _levels.resize(qMax(0, levelCount() - 1));
+    _tileCache.clear();
+    _rawTileCache.clear();
+}
+
+void TilePyramid::invalidate(const QImage &baseImage, const QRect &dirtyRect)
+{
+    // 延迟模式: 删掉各层中与dirtyRect相交的瓦片, 下次可见时重新转换.
+    // lazyTile()取原图区域时对边界四舍五入, 瓦片实际读取的原图区域可能比精确的范围大半个像素, 所以dirtyRect向外扩大1像素
+    const QRect expandedRect = dirtyRect.adjusted(-1, -1, 1, 1);
+    for (int level = 0; level < levelCount() && !(_tileCache.isEmpty() && _rawTileCache.isEmpty()); ++level) {
+        const QRect levelRect = mapToLevel(0 == level ? dirtyRect : expandedRect, level);
+        if (levelRect.isEmpty()) {
+            continue;
+        }
+        for (int row = levelRect.top() / TILE_SIZE; row <= levelRect.bottom() / TILE_SIZE; ++row) {
+            for (int column = levelRect.left() / TILE_SIZE; column <= levelRect.right() / TILE_SIZE; ++column) {
+                _tileCache.remove(tileKey(level, row, column));
+                _rawTileCache.remove(tileKey(level, row, column));
+            }
+        }
+    }
+
+    // 全图模式: 已生成的层总是从第1层开始连续的, 逐层把上一层的脏区域重新缩小
+    QRect parentRect = dirtyRect & QRect(QPoint(0, 0), _baseSize);
+    for (int level = 1; level < levelCount(); ++level) {
+        QImage &image = _levels[level - 1];
+        if (image.isNull() || parentRect.isEmpty()) {
+            break;
+        }
+        const QImage &parent = levelImage(baseImage, level - 1);
+        const cv::Mat parentMat = wrapImageAsMat(parent);
+        if (parentMat.empty() || parent.format() != image.format()) {
+            // 不能局部更新, 丢掉这一层及以上的层, 下次用到时重新生成
+            for (int i = level - 1; i < _levels.size(); ++i) {
+                _levels[i] = QImage();
+            }
+            break;
+        }
+        // 上一层的边长是偶数时, 这一方向正好缩小一半(2x2求平均), 对齐到偶数坐标后局部缩小与整层缩小的结果相同.
+        // 边长是奇数时, 这一层的边长向上取整, 缩放比例不是整数, 每个像素覆盖的区域和权重与它在整行(列)中的位置有关,
+        // 只有整行(列)一起缩小才与整层缩小的结果相同, 所以这一方向扩大到整层
+        const bool oddWidth = parent.width() % 2 != 0;
+        const bool oddHeight = parent.height() % 2 != 0;
+        const int left = oddWidth ? 0 : parentRect.left() & ~1;
+        const int top = oddHeight ? 0 : parentRect.top() & ~1;
+        const int right = oddWidth ? parent.width() : qMin((parentRect.right() + 2) & ~1, parent.width());
+        const int bottom = oddHeight ? parent.height() : qMin((parentRect.bottom() + 2) & ~1, parent.height());
+        const QRect childRect = QRect(QPoint(left / 2, top / 2),
+                                      QPoint((right + 1) / 2 - 1, (bottom + 1) / 2 - 1)) & image.rect();
+        if (childRect.isEmpty()) {
+            break;
+        }
+        cv::Mat levelMat(image.height(), image.width(), parentMat.type(),
+                         image.bits(), static_cast<size_t>(image.bytesPerLine()));
+        cv::Mat childMat = levelMat(VisionLibrary::toCvRect(childRect));
+        cv::resize(parentMat(cv::Rect(left, top, right - left, bottom - top)), childMat,
+                   childMat.size(), 0.0, 0.0, cv::INTER_AREA);
+        parentRect = childRect;
+    }
+}
+
+int TilePyramid::levelCount() const
+{
+    if (_baseSize.isEmpty()) {
+        return 0;
+    }
+    int count = 1;
+    QSize size = _baseSize;
+    while (qMax(size.width(), size.height()) > TILE_SIZE) {
+        size = QSize((size.width() + 1) / 2, (size.height() + 1) / 2);
+        ++count;
+    }
+    return count;
+}
+
+int TilePyramid::levelForScale(const double scale) const
+{
+    if (scale >= 1.0 || scale <= 0.0) {
+        // 放大显示时都用原图
+        return 0;
+    }
+    // 缩小到1/2^n以下才用第n层, 保证所用层的分辨率不低于屏幕
+    const int level = static_cast<int>(std::floor(std::log2(1.0 / scale)));
+    return qBound(0, level, qMax(0, levelCount() - 1));
+}
+
+QSize TilePyramid::levelSize(const int level) const
+{
+    QSize size = _baseSize;
+    for (int i = 0; i < level; ++i) {
+        size = QSize((size.width() + 1) / 2, (size.height() + 1) / 2);
+    }
+    return size;
+}
+
+void TilePyramid::draw(QPainter &painter, const QImage &baseImage, const QRectF &exposedRect, const double scale)
+{
+    if (baseImage.isNull()) {
+        return;
+    }
+    if (baseImage.size() != _baseSize) {
+        // 原图大小变了却没有调用reset()
+        reset(baseImage.size());
+    }
+    const int level = levelForScale(scale);
+    const QImage &image = levelImage(baseImage, level);
+    drawLevel(painter, level, exposedRect, [&](const QRect &tileRect, int, int) {
+        painter.drawImage(tileRect.topLeft(), image, tileRect);
+    });
+}
+
+void TilePyramid::draw(QPainter &painter, const cv::Mat &baseMat, const QRectF &exposedRect, const double scale)
+{
+    if (baseMat.empty()) {
+        return;
+    }
+    if (QSize(baseMat.cols, baseMat.rows) != _baseSize) {
+        reset(QSize(baseMat.cols, baseMat.rows));
+    }
+    const int level = levelForScale(scale);
+    drawLevel(painter, level, exposedRect, [&](const QRect &tileRect, int row, int column) {
+        painter.drawImage(tileRect.topLeft(), lazyTile(baseMat, level, row, column, tileRect));
+    });
+}
+
+void TilePyramid::setTileConverter(const TileConverter &converter)
+{
+    _converter = converter;
+    _tileCache.clear();
+}
+
+void TilePyramid::setTileCacheLimit(const int megaBytes)
+{
+    _tileCache.setMaxCost(qMax(1, megaBytes) * 1024);
+    _rawTileCache.setMaxCost(qMax(1, megaBytes) * 1024);
+}
+
+int TilePyramid::tileCacheLimit() const
+{
+    return _tileCache.maxCost() / 1024;
+}
+
+const QImage &TilePyramid::levelImage(const QImage &baseImage, const int level)
+{
+    if (0 == level) {
+        return baseImage;
+    }
+    QImage &image = _levels[level - 1];
+    if (image.isNull()) {
+        // 由上一层缩小一半得到
+        const QImage &parent = levelImage(baseImage, level - 1);
+        const cv::Mat parentMat = wrapImageAsMat(parent);
+        if (parentMat.empty()) {
+            // 不支持的格式, 先转换成最常用的格式
+            const QImage converted = parent.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+            image = converted.scaled(levelSize(level), Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+            return image;
+        }
+        const QSize size = levelSize(level);
+        image = VisionLibrary::BufferPool::instance().acquireImage(size, parent.format());
+        cv::Mat levelMat(size.height(), size.width(), parentMat.type(),
+                         image.bits(), static_cast<size_t>(image.bytesPerLine()));
+        // INTER_AREA缩小一半相当于2x2求平均, 对预乘的颜色也是正确的
+        cv::resize(parentMat, levelMat, levelMat.size(), 0.0, 0.0, cv::INTER_AREA);
+    }
+    return image;
+}
+
+QImage TilePyramid::lazyTile(const cv::Mat &baseMat, const int level, const int row, const int column, const QRect &tileRect)
+{
+    const quint64 key = tileKey(level, row, column);
+    if (const QImage *tile = _tileCache.object(key)) {
+        return *tile;
+    }
+
+    // 缩小的原始瓦片有缓存, 换转换函数之后只需重新转换
+    const QImage tile = _converter(rawTile(baseMat, level, row, column, tileRect));
+    if (tile.isNull()) {
+        return tile;
+    }
+    // 超过容量时QCache会自动删掉最久没用过的瓦片
+    const int cost = qMax(1, static_cast<int>(tile.sizeInBytes() / 1024));
+    _tileCache.insert(key, new QImage(tile), cost);
+    return tile;
+}
+
+cv::Mat TilePyramid::rawTile(const cv::Mat &baseMat, const int level, const int row, const int column, const QRect &tileRect)
+{
+    if (0 == level) {
+        return baseMat(VisionLibrary::toCvRect(tileRect));
+    }
+    const quint64 key = tileKey(level, row, column);
+    if (const cv::Mat *tile = _rawTileCache.object(key)) {
+        return *tile;
+    }
+    // 第level层的瓦片对应原图中的区域, 缩小之后再转换, 这样转换的像素数与瓦片大小相同
+    const QSize size = levelSize(level);
+    const double sx = double(_baseSize.width()) / size.width();
+    const double sy = double(_baseSize.height()) / size.height();
+    const int left = qRound(tileRect.left() * sx);
+    const int top = qRound(tileRect.top() * sy);
+    const int right = qMin(qRound((tileRect.right() + 1) * sx), baseMat.cols);
+    const int bottom = qMin(qRound((tileRect.bottom() + 1) * sy), baseMat.rows);
+    cv::Mat tile;
+    cv::resize(baseMat(cv::Rect(left, top, right - left, bottom - top)), tile,
+               cv::Size(tileRect.width(), tileRect.height()), 0.0, 0.0, cv::INTER_AREA);
+    const int cost = qMax(1, static_cast<int>(tile.total() * tile.elemSize() / 1024));
+    _rawTileCache.insert(key, new cv::Mat(tile), cost);
+    return tile;
+}
+
+void TilePyramid::drawLevel(QPainter &painter, const int level, const QRectF &exposedRect,
+                            const std::function<void(const QRect &, int, int)> &drawTile) const
+{
+    const QSize size = levelSize(level);
+    const QRect levelBounds(QPoint(0, 0), size);
+    // 第level层 -> 原图 的缩放比例. 因为宽高向上取整, 所以不一定正好是2^level
+    const double sx = double(_baseSize.width()) / size.width();
+    const double sy = double(_baseSize.height()) / size.height();
+    const QRect levelRect = mapToLevel(exposedRect, level);
+    if (levelRect.isEmpty()) {
+        return;
+    }
+
+    painter.save();
+    // 在第level层的坐标系中画整数坐标的瓦片, 相邻瓦片之间就不会有缝隙
+    painter.scale(sx, sy);
+    const int firstColumn = levelRect.left() / TILE_SIZE;
+    const int lastColumn = levelRect.right() / TILE_SIZE;
+    const int firstRow = levelRect.top() / TILE_SIZE;
+    const int lastRow = levelRect.bottom() / TILE_SIZE;
+    for (int row = firstRow; row <= lastRow; ++row) {
+        for (int column = firstColumn; column <= lastColumn; ++column) {
+            const QRect tileRect = QRect(column * TILE_SIZE, row * TILE_SIZE, TILE_SIZE, TILE_SIZE) & levelBounds;
+            drawTile(tileRect, row, column);
+        }
+    }
+    painter.restore();
+}
+
+quint64 TilePyramid::tileKey(const int level, const int row, const int column)
+{
+    return (quint64(level) << 56) | (quint64(row) << 28) | quint64(column);
+}
+
+QRect TilePyramid::mapToLevel(const QRectF &rect, const int level) const
+{
+    const QSize size = levelSize(level);
+    const double sx = double(_baseSize.width()) / size.width();
+    const double sy = double(_baseSize.height()) / size.height();
+    return QRectF(rect.x() / sx, rect.y() / sy, rect.width() / sx, rect.height() / sy)
+           .toAlignedRect() & QRect(QPoint(0, 0), size);
+}
@@ -0,0 +1,99 @@
+﻿#pragma once
+
+#include <functional>
+#include <QImage>
+#include <QVector>
+#include <QCache>
+#include <opencv2/opencv.hpp>
+
+class QPainter;
+
+/*!
+ * \brief The TilePyramid class 图像的多分辨率金字塔(mipmap), 按瓦片绘制
+ * \note
+ * - 第0层就是原图, 由调用者持有(这里不保存原图的拷贝, 以免原图被共享而在修改时发生深拷贝);
+ * - 第n层是第n-1层宽高各缩小一半(INTER_AREA), 在第一次用到时才生成;
+ * - 绘制时只画与可见区域相交的瓦片, 而且选择与当前缩放比例匹配的层,
+ *   所以绘制耗时只与窗口大小有关, 与图像大小无关
+ *
+ * 有两种用法:
+ * 1. 全图模式: 调用者事先把整幅cv::Mat转换成QImage, 用draw(painter, QImage, ...)绘制;
+ * 2. 延迟模式: 调用者只持有cv::Mat, 用draw(painter, cv::Mat, ...)绘制.
+ *    瓦片在第一次可见时才从cv::Mat转换, 并放在有容量上限的LRU缓存中.
+ *    第1层及以上的瓦片先从原图缩小(转换之前的原始值), 缩小的结果也单独缓存,
+ *    所以换转换函数(比如拖动窗宽窗位)时只对可见的瓦片重新转换, 不再从原图缩小
+ */
+class TilePyramid
+{
+public:
+    // 瓦片边长(像素)
+    static constexpr int TILE_SIZE = 512;
+    // 把cv::Mat的一块区域转换成用于显示的QImage
+    using TileConverter = std::function<QImage(const cv::Mat &)>;
+
+    TilePyramid();
+
+    // 原图变化之后调用, 丢弃已生成的所有层和缓存的瓦片
+    void reset(const QSize &baseSize);
+    /*!
+     * \brief invalidate 原图中只有dirtyRect内的像素变了
+     * \param baseImage 更新之后的原图. 全图模式下重新缩小已生成的各层中对应的区域; 延迟模式下传入空的QImage
+     * \param dirtyRect 位于原图坐标系
+     * \note
+     * - 全图模式下结果与整层重新生成的逐像素相同. 上一层的边长是奇数的方向上, 要重新缩小整行(列);
+     * - 延迟模式下, 从缓存中删掉与dirtyRect相交的瓦片
+     */
+    void invalidate(const QImage &baseImage, const QRect &dirtyRect);
+
+    // 层数(包括第0层)
+    int levelCount() const;
+    // 根据缩放比例(窗口像素/图像像素)选择合适的层
+    int levelForScale(const double scale) const;
+    // 第level层的大小
+    QSize levelSize(const int level) const;
+
+    /*!
+     * \brief draw 全图模式: 绘制与exposedRect相交的瓦片
+     * \param painter 世界变换必须已经设置为: 图像坐标系 -> 窗口坐标系
+     * \param baseImage 原图(第0层)
+     * \param exposedRect 需要绘制的区域, 位于图像坐标系
+     * \param scale 当前的缩放比例
+     */
+    void draw(QPainter &painter, const QImage &baseImage, const QRectF &exposedRect, const double scale);
+    // 延迟模式: 瓦片按需从baseMat转换, 参数同上
+    void draw(QPainter &painter, const cv::Mat &baseMat, const QRectF &exposedRect, const double scale);
+
+    // 延迟模式下瓦片的转换函数, 默认是VisionLibrary::toPremultiImage. 只清空转换好的瓦片, 保留缩小的原始瓦片
+    void setTileConverter(const TileConverter &converter);
+    // 延迟模式下瓦片缓存的容量上限(MB). 转换好的瓦片和缩小的原始瓦片各有这么多
+    void setTileCacheLimit(const int megaBytes);
+    int tileCacheLimit() const;
+
+protected:
+    // 返回第level层, 如果还没有生成就先生成
+    const QImage &levelImage(const QImage &baseImage, const int level);
+    // 延迟模式: 返回第level层的一块瓦片, 如果不在缓存中就先转换
+    QImage lazyTile(const cv::Mat &baseMat, const int level, const int row, const int column, const QRect &tileRect);
+    // 延迟模式: 第level层一块瓦片转换之前的原始值. 第0层是baseMat的一块(不拷贝), 其他层从baseMat缩小并缓存
+    cv::Mat rawTile(const cv::Mat &baseMat, const int level, const int row, const int column, const QRect &tileRect);
+    // 对第level层中与exposedRect相交的每一块瓦片调用drawTile(瓦片区域, 行, 列)
+    void drawLevel(QPainter &painter, const int level, const QRectF &exposedRect,
+                   const std::function<void(const QRect &, int, int)> &drawTile) const;
+
+    static quint64 tileKey(const int level, const int row, const int column);
+    // 把原图坐标系中的矩形映射到第level层的坐标系(向外取整)
+    QRect mapToLevel(const QRectF &rect, const int level) const;
+
+    QSize _baseSize;
+    // 第1层及以上, 第0层就是原图. 未生成的层为null
+    QVector<QImage> _levels;
+
+    TileConverter _converter;
+    // 延迟模式下的瓦片缓存, cost的单位是KB
+    QCache<quint64, QImage> _tileCache;
+    // 延迟模式下第1层及以上缩小之后, 转换之前的瓦片, cost的单位是KB
+    QCache<quint64, cv::Mat> _rawTileCache;
+};
+
+// 把QImage的内存包装成cv::Mat(不拷贝), 不支持的格式返回空Mat
+cv::Mat wrapImageAsMat(const QImage &image);
@@ -3,6 +3,7 @@
 #include <QPaintEvent>
 #include <QMenu>
 #include <QDebug>
+#include <algorithm>
 #include "VisionLibrary/visionlibrary.h"
 
 constexpr int CODE(int x, int y)
@@ -28,6 +29,19 @@ enum RegionCode {
 ImageView2::ImageView2(QWidget *parent) : ImageView1(parent)
 {
     setupContextMenu();
+
+    _roiStatistics = new RoiStatistics(this);
+    // 所有换图的途径(setMat, 邮箱, 图像序列)都会发射signal_matChanged. 局部更新也要重新计算积分图
+    const auto onMatChanged = [this](const cv::Mat &mat) {
+        _roiStatistics->setMat(mat);
+        updateRoiStatistics(true);
+    };
+    connect(this, &ImageView1::signal_matChanged, this, onMatChanged);
+    connect(this, &ImageView1::signal_matRegionChanged, this, onMatChanged);
+    connect(_roiStatistics, &RoiStatistics::signal_ready, this, [this]() {
+        updateRoiStatistics(true);
+        update();
+    });
 }
 
 void ImageView2::setMat(const cv::Mat &mat)
@@ -36,6 +50,11 @@ void ImageView2::setMat(const cv::Mat &mat)
     makeMarqueeInvalid();
 }
 
+const RoiStatistics::Statistics &ImageView2::roiStatistics() const
+{
+    return _statistics;
+}
+
 const cv::Mat ImageView2::roi() const
 {
     // 返回用户确认了选中区域(图像坐标系中)
@@ -56,6 +75,8 @@ void ImageView2::paintEvent(QPaintEvent *event)
 {
     ImageView1::paintEvent(event);
 
+    // 选框位于窗口坐标系, 缩放和平移图像也会改变它在图像中的区域. 区域没变时这里几乎不耗时
+    updateRoiStatistics();
     QPainter painter(this);
     if (_marquee.isValid()) {
         drawMarquee(painter);
@@ -196,6 +217,85 @@ void ImageView2::drawMarquee(QPainter &painter)
     painter.drawPoint(_marquee.bottomRight());
 
     painter.restore();
+
+    if (_statistics.isValid()) {
+        drawRoiStatistics(painter);
+    }
+}
+
+// 统计面板中直方图的大小
+constexpr int HISTOGRAM_WIDTH = 128;
+constexpr int HISTOGRAM_HEIGHT = 40;
+// 统计面板的内边距
+constexpr int PANEL_MARGIN = 4;
+
+void ImageView2::drawRoiStatistics(QPainter &painter)
+{
+    painter.save();
+    const QString text = QStringLiteral("n=%1  mean=%2  std=%3\nmin=%4  max=%5")
+                         .arg(_statistics.count)
+                         .arg(_statistics.mean, 0, 'f', 2)
+                         .arg(_statistics.stddev, 0, 'f', 2)
+                         .arg(_statistics.min)
+                         .arg(_statistics.max);
+    const QFontMetrics metrics = painter.fontMetrics();
+    const QRect textRect = metrics.boundingRect(QRect(0, 0, 1000, 1000), Qt::AlignLeft | Qt::AlignTop, text);
+    const bool withHistogram = !_statistics.histogram.isEmpty();
+    const int panelWidth = qMax(textRect.width(), withHistogram ? HISTOGRAM_WIDTH : 0) + PANEL_MARGIN * 2;
+    const int panelHeight = textRect.height() + (withHistogram ? HISTOGRAM_HEIGHT + PANEL_MARGIN : 0) + PANEL_MARGIN * 2;
+    // 放在选框的左下方, 放不下就放到选框里面
+    QRect panel(_marquee.left(), _marquee.bottom() + EDGE_WIDTH, panelWidth, panelHeight);
+    if (panel.bottom() > height()) {
+        panel.moveBottom(_marquee.bottom() - EDGE_WIDTH);
+    }
+
+    painter.setPen(Qt::NoPen);
+    painter.setBrush(QColor(0, 0, 0, 160));
+    painter.drawRect(panel);
+    painter.setPen(Qt::white);
+    painter.drawText(panel.adjusted(PANEL_MARGIN, PANEL_MARGIN, -PANEL_MARGIN, -PANEL_MARGIN),
+                     Qt::AlignLeft | Qt::AlignTop, text);
+
+    if (withHistogram) {
+        // 直方图只画[min, max]之间的部分, 合并成HISTOGRAM_WIDTH列
+        const QRect histogramRect(panel.left() + PANEL_MARGIN, panel.bottom() - PANEL_MARGIN - HISTOGRAM_HEIGHT + 1,
+                                  HISTOGRAM_WIDTH, HISTOGRAM_HEIGHT);
+        const int first = static_cast<int>(_statistics.min) - _statistics.histogramMinValue;
+        const int last = static_cast<int>(_statistics.max) - _statistics.histogramMinValue;
+        const double binsPerColumn = double(last - first + 1) / HISTOGRAM_WIDTH;
+        QVector<qint64> columns(HISTOGRAM_WIDTH, 0);
+        for (int bin = first; bin <= last; ++bin) {
+            columns[qMin(HISTOGRAM_WIDTH - 1, static_cast<int>((bin - first) / binsPerColumn))] += _statistics.histogram[bin];
+        }
+        const qint64 maxColumn = qMax<qint64>(1, *std::max_element(columns.cbegin(), columns.cend()));
+        painter.setPen(Qt::NoPen);
+        painter.setBrush(QColor(255, 255, 255, 60));
+        painter.drawRect(histogramRect);
+        painter.setBrush(Qt::white);
+        for (int i = 0; i < HISTOGRAM_WIDTH; ++i) {
+            const int barHeight = static_cast<int>(HISTOGRAM_HEIGHT * columns[i] / maxColumn);
+            if (barHeight > 0) {
+                painter.drawRect(histogramRect.left() + i, histogramRect.bottom() - barHeight + 1, 1, barHeight);
+            }
+        }
+    }
+    painter.restore();
+}
+
+void ImageView2::updateRoiStatistics(const bool force)
+{
+    QRect rect;
+    if (_marquee.isValid() && imageContainsMarquee()) {
+        rect = window2Image(_marquee) & QRect(QPoint(0, 0), imageSize());
+    }
+    if (!force && rect == _statistics.rect && _statistics.isValid() == !rect.isEmpty()) {
+        return;
+    }
+    const bool wasValid = _statistics.isValid();
+    _statistics = rect.isEmpty() ? RoiStatistics::Statistics() : _roiStatistics->compute(rect);
+    if (wasValid || _statistics.isValid()) {
+        emit signal_roiStatisticsChanged(_statistics);
+    }
 }
 
 int code(const int value, const QVector<int> &limits)
@@ -288,6 +388,6 @@ QRect ImageView2::image2Window(const QRect &rect) const
 
 bool ImageView2::imageContainsMarquee() const
 {
-    return image2Window(_image.rect()).contains(_marquee);
+    return image2Window(QRect(QPoint(0, 0), imageSize())).contains(_marquee);
 }
 
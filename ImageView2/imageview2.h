@@ -1,6 +1,7 @@
 ﻿#pragma once
 
 #include "ImageView1/imageview1.h"
+#include "ImageView2/roistatistics.h"
 
 class QMenu;
 class ImageView2 : public ImageView1
@@ -9,9 +10,12 @@ class ImageView2 : public ImageView1
 public:
     explicit ImageView2(QWidget *parent = nullptr);
 
+    using ImageView1::setMat;
     void setMat(const cv::Mat &mat) override;
 
     const cv::Mat roi() const;
+    // 选框内像素的统计量. 没有选框或选框不完全在图像中时无效
+    const RoiStatistics::Statistics &roiStatistics() const;
 
 protected:
     void paintEvent(QPaintEvent *event) override;
@@ -23,12 +27,18 @@ signals:
     // 返回用户确认了选中区域(图像坐标系中)
 //    void signal_confirmed(QRect rect_inImage);
     void signal_confirmed(const cv::Mat &roi);
+    // 选框内像素的统计量变了(拖动/调整选框, 缩放/平移图像, 换图都可能引起)
+    void signal_roiStatisticsChanged(const RoiStatistics::Statistics &statistics);
 private:
     void setupContextMenu();
     void makeMarqueeInvalid();
 
     // 绘制矩形框
     void drawMarquee(QPainter &painter);
+    // 在选框下方绘制统计量和直方图
+    void drawRoiStatistics(QPainter &painter);
+    // 选框在图像中的区域变了就重新统计. force为true时总是重新统计(比如换了图)
+    void updateRoiStatistics(const bool force = false);
 
     // 判断点位于选框的哪个区域
     int judgeRegion(const QPoint &pos) const;
@@ -60,5 +70,9 @@ private:
 
     // 上下文菜单. 当鼠标位于选框中, 点击右键时弹出
     QMenu *_menu;
+
+    // 选框内像素的统计. 积分图在工作线程中计算, 之后每次统计都是O(1)的(直方图增量更新)
+    RoiStatistics *_roiStatistics;
+    RoiStatistics::Statistics _statistics;
 };
 
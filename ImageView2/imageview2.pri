@@ -0,0 +1,10 @@
+# ImageView2(带选框的ImageView1)及其依赖
+SOURCES += \
+    $$PWD/imageview2.cpp \
+    $$PWD/roistatistics.cpp
+
+HEADERS += \
+    $$PWD/imageview2.h \
+    $$PWD/roistatistics.h
+
+include($$PWD/../ImageView1/imageview1.pri)
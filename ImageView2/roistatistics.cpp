@@ -0,0 +1,194 @@
+﻿#include "roistatistics.h"
+#include <QApplication>
+#include <QPointer>
+#include <QRegion>
+#include <QtConcurrent>
+#include <cmath>
+#include <limits>
+#include "VisionLibrary/visionlibrary.h"
+
+// 整数类型直方图下标0对应的值
+static int histogramMinValue(const int depth)
+{
+    switch (depth) {
+    case CV_16S:
+        return std::numeric_limits<short>::min();
+    default:
+        return 0;
+    }
+}
+
+// 整数类型直方图的区间数, 不统计直方图的类型返回0
+static int histogramBinCount(const int depth)
+{
+    switch (depth) {
+    case CV_8U:
+        return 256;
+    case CV_16U:
+    case CV_16S:
+        return 65536;
+    default:
+        return 0;
+    }
+}
+
+template <typename T>
+void accumulateRows(const cv::Mat &values, const QRect &rect, qint64 *histogram, const int minValue, const int sign)
+{
+    for (int i = rect.top(); i <= rect.bottom(); ++i) {
+        const T *const row = values.ptr<T>(i);
+        for (int j = rect.left(); j <= rect.right(); ++j) {
+            histogram[row[j] - minValue] += sign;
+        }
+    }
+}
+
+RoiStatistics::RoiStatistics(QObject *parent) : QObject(parent)
+{
+}
+
+void RoiStatistics::setMat(const cv::Mat &mat)
+{
+    _mat = mat; // 浅拷贝
+    _tables.reset();
+    _histogram.clear();
+    _histogramRect = QRect();
+    _isComputing = false;
+    // 正在计算的旧图像的结果作废
+    ++*_generation;
+}
+
+void RoiStatistics::startComputing()
+{
+    if (_isComputing || _mat.empty()) {
+        return;
+    }
+    _isComputing = true;
+    const cv::Mat mat = _mat;
+    const int generation = *_generation;
+    const std::shared_ptr<std::atomic_int> currentGeneration = _generation;
+    const QPointer<RoiStatistics> self(this);
+    QtConcurrent::run([=]() {
+        if (*currentGeneration != generation) {
+            // 连续换图时只计算最后一幅
+            return;
+        }
+        std::shared_ptr<Tables> tables = std::make_shared<Tables>();
+        if (1 == mat.channels()) {
+            tables->values = mat;
+        } else {
+            cv::cvtColor(mat, tables->values, 4 == mat.channels() ? cv::COLOR_BGRA2GRAY : cv::COLOR_BGR2GRAY);
+        }
+        if (CV_8S == tables->values.depth() || CV_32S == tables->values.depth()) {
+            // cv::integral不支持这两种类型
+            tables->values.convertTo(tables->values, CV_64F);
+        }
+        cv::integral(tables->values, tables->sum, tables->squaredSum, CV_64F, CV_64F);
+        QMetaObject::invokeMethod(qApp, [=]() {
+            if (self && *currentGeneration == generation) {
+                self->_tables = tables;
+                self->_isComputing = false;
+                emit self->signal_ready();
+            }
+        }, Qt::QueuedConnection);
+    });
+}
+
+bool RoiStatistics::isReady() const
+{
+    return nullptr != _tables;
+}
+
+RoiStatistics::Statistics RoiStatistics::compute(const QRect &rect)
+{
+    Statistics statistics;
+    if (!isReady()) {
+        startComputing();
+        return statistics;
+    }
+    const cv::Mat &values = _tables->values;
+    statistics.rect = rect & QRect(0, 0, values.cols, values.rows);
+    if (statistics.rect.isEmpty()) {
+        return statistics;
+    }
+    const QRect &r = statistics.rect;
+    statistics.count = qint64(r.width()) * r.height();
+
+    // 积分图比原图多一行一列, (y, x)处是原图[0, y) x [0, x)的和
+    const auto rectSum = [&r](const cv::Mat &integral) {
+        const int top = r.top();
+        const int left = r.left();
+        const int bottom = r.bottom() + 1;
+        const int right = r.right() + 1;
+        return integral.at<double>(bottom, right) - integral.at<double>(top, right) -
+               integral.at<double>(bottom, left) + integral.at<double>(top, left);
+    };
+    statistics.mean = rectSum(_tables->sum) / statistics.count;
+    const double variance = rectSum(_tables->squaredSum) / statistics.count - statistics.mean * statistics.mean;
+    // 浮点误差可能让方差略小于0
+    statistics.stddev = std::sqrt(qMax(0.0, variance));
+
+    const int binCount = histogramBinCount(values.depth());
+    if (binCount > 0) {
+        updateHistogram(r);
+        statistics.histogram = _histogram;
+        statistics.histogramMinValue = histogramMinValue(values.depth());
+        int first = 0;
+        while (first < binCount && 0 == _histogram[first]) {
+            ++first;
+        }
+        int last = binCount - 1;
+        while (last > first && 0 == _histogram[last]) {
+            --last;
+        }
+        statistics.min = first + statistics.histogramMinValue;
+        statistics.max = last + statistics.histogramMinValue;
+    } else {
+        cv::minMaxIdx(values(VisionLibrary::toCvRect(r)), &statistics.min, &statistics.max);
+    }
+    return statistics;
+}
+
+void RoiStatistics::updateHistogram(const QRect &rect)
+{
+    if (rect == _histogramRect) {
+        return;
+    }
+    const QRect overlap = rect & _histogramRect;
+    const qint64 overlapArea = qint64(overlap.width()) * overlap.height();
+    const qint64 area = qint64(rect.width()) * rect.height();
+    if (_histogram.isEmpty() || overlap.isEmpty() || overlapArea * 2 < area) {
+        // 重叠太少, 增量更新不如重新统计
+        _histogram.fill(0, histogramBinCount(_tables->values.depth()));
+        accumulateHistogram(rect, 1);
+    } else {
+        // 只统计新旧矩形之差
+        for (const QRect &added : QRegion(rect).subtracted(QRegion(_histogramRect))) {
+            accumulateHistogram(added, 1);
+        }
+        for (const QRect &removed : QRegion(_histogramRect).subtracted(QRegion(rect))) {
+            accumulateHistogram(removed, -1);
+        }
+    }
+    _histogramRect = rect;
+}
+
+void RoiStatistics::accumulateHistogram(const QRect &rect, const int sign)
+{
+    const cv::Mat &values = _tables->values;
+    const int minValue = histogramMinValue(values.depth());
+    qint64 *const histogram = _histogram.data();
+    switch (values.depth()) {
+    case CV_8U:
+        accumulateRows<uchar>(values, rect, histogram, minValue, sign);
+        break;
+    case CV_16U:
+        accumulateRows<ushort>(values, rect, histogram, minValue, sign);
+        break;
+    case CV_16S:
+        accumulateRows<short>(values, rect, histogram, minValue, sign);
+        break;
+    default:
+        break;
+    }
+}
@@ -0,0 +1,82 @@
+﻿#pragma once
+
+#include <atomic>
+#include <memory>
+#include <QObject>
+#include <QRect>
+#include <QVector>
+#include <opencv2/opencv.hpp>
+
+/*!
+ * \brief The RoiStatistics class 任意矩形区域内像素的统计量(均值, 标准差, 最小值, 最大值, 直方图)
+ * \note
+ * - 每幅图像在工作线程中计算一次积分图和平方积分图, 之后任意矩形的均值和方差都是O(1)的.
+ *   积分图在第一次调用compute()时才开始计算, 所以没有选框时(比如播放视频流)不花这份时间;
+ * - 整数类型的直方图随矩形增量更新: 只统计新旧矩形之差, 拖动选框时的代价与选框的周长成正比, 与面积无关;
+ * - 最小值和最大值从直方图得到. 浮点类型没有直方图, 最小值和最大值要遍历矩形, 代价与面积成正比;
+ * - 多通道图像先转换成灰度图再统计;
+ * - 除了工作线程, 所有函数都只能在GUI线程调用
+ */
+class RoiStatistics : public QObject
+{
+    Q_OBJECT
+public:
+    struct Statistics {
+        QRect rect; // 统计的区域, 位于图像坐标系
+        qint64 count = 0; // 像素数
+        double mean = 0.0;
+        double stddev = 0.0;
+        double min = 0.0;
+        double max = 0.0;
+        // 直方图, 整数类型每个值一个区间, 下标0对应的值是histogramMinValue. 浮点类型为空
+        QVector<qint64> histogram;
+        int histogramMinValue = 0;
+
+        bool isValid() const
+        {
+            return count > 0;
+        }
+    };
+
+    explicit RoiStatistics(QObject *parent = nullptr);
+
+    // 换图. 之前的积分图作废
+    void setMat(const cv::Mat &mat);
+    // 当前图像的积分图是否已经算好
+    bool isReady() const;
+
+    /*!
+     * \brief compute 统计rect(图像坐标系)内的像素
+     * \return rect与图像不相交时返回无效的统计量.
+     * 积分图还没有算好时也返回无效的统计量, 并在工作线程中开始计算, 完成后发射signal_ready
+     */
+    Statistics compute(const QRect &rect);
+
+signals:
+    // 当前图像的积分图计算完成
+    void signal_ready();
+
+private:
+    // 工作线程的计算结果
+    struct Tables {
+        cv::Mat values; // 单通道的图像
+        cv::Mat sum; // 积分图, CV_64F
+        cv::Mat squaredSum; // 平方积分图, CV_64F
+    };
+
+    // 在工作线程中计算_mat的积分图
+    void startComputing();
+    // 把_histogram从_histogramRect更新到rect
+    void updateHistogram(const QRect &rect);
+    // 把rect内的像素计入(sign为1)或移出(sign为-1)直方图
+    void accumulateHistogram(const QRect &rect, const int sign);
+
+    cv::Mat _mat;
+    std::shared_ptr<const Tables> _tables;
+    bool _isComputing = false;
+    // 每次换图都加一, 工作线程据此判断结果是否已经过时. 用shared_ptr是因为工作线程可能比本对象活得更久
+    std::shared_ptr<std::atomic_int> _generation = std::make_shared<std::atomic_int>(0);
+
+    QVector<qint64> _histogram;
+    QRect _histogramRect; // _histogram统计的是哪个矩形
+};
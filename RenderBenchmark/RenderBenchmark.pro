@@ -0,0 +1,19 @@
+QT       += core gui widgets concurrent
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = RenderBenchmark
+
+# ImageView1/ImageView2绘制路径的基准测试, 默认在offscreen平台上运行. 用法见RenderBenchmark --help
+SOURCES += \
+    ../Benchmark/benchmarkharness.cpp \
+    main.cpp \
+    renderbenchmarks.cpp
+
+HEADERS += \
+    ../Benchmark/benchmarkharness.h \
+    renderbenchmarks.h
+
+# ImageView1, ImageView2, VisionLibrary, GlobalTools和OpenCV
+include(../ImageView2/imageview2.pri)
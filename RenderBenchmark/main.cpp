@@ -0,0 +1,54 @@
+﻿#include <QApplication>
+#include <QCommandLineParser>
+#include <QTextStream>
+#include "Benchmark/benchmarkharness.h"
+#include "CommonLibrary/GlobalTools/globaltools.h"
+#include "RenderBenchmark/renderbenchmarks.h"
+
+int main(int argc, char *argv[])
+{
+    // 默认用offscreen平台, 没有显示器也能运行. 环境变量指定了其他平台(比如想看到窗口)时以环境变量为准
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    QApplication a(argc, argv);
+    QCoreApplication::setApplicationName("RenderBenchmark");
+    QCoreApplication::setApplicationVersion(VERSION);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Rendering benchmarks for ImageView1 and ImageView2. "
+                                     "Scripted pan/zoom/resize sequences are rendered offscreen and the frame times are written as JSON.");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    const QCommandLineOption outputOption(QStringList() << "o" << "output", "Path of the JSON results.", "file", "render_benchmark.json");
+    const QCommandLineOption filterOption(QStringList() << "f" << "filter",
+                                          "Only run cases whose name matches this regular expression, e.g. \"ImageView2/20MP\".", "regex");
+    const QCommandLineOption minTimeOption("min-time", "Minimum running time of each case in seconds.", "seconds", "0.5");
+    const QCommandLineOption maxMegapixelsOption("max-megapixels", "Skip image sizes larger than this.", "megapixels", "100");
+    const QCommandLineOption labelOption("label", "Free text stored in the results, e.g. a commit hash.", "text");
+    parser.addOptions({outputOption, filterOption, minTimeOption, maxMegapixelsOption, labelOption});
+    parser.process(a);
+
+    BenchmarkHarness::Options options;
+    options.minTime = parser.value(minTimeOption).toDouble();
+    // 帧时间的p99需要足够多的帧
+    options.minIterations = 100;
+    options.filter = QRegularExpression(parser.value(filterOption));
+    if (!options.filter.isValid()) {
+        QTextStream(stderr) << "Invalid filter: " << options.filter.errorString() << Qt::endl;
+        return 1;
+    }
+    BenchmarkHarness harness(options);
+    runRenderBenchmarks(harness, parser.value(maxMegapixelsOption).toDouble());
+
+    QJsonObject results = harness.toJson();
+    results.insert("label", parser.value(labelOption));
+    results.insert("platform", QApplication::platformName());
+    const QString outputPath = parser.value(outputOption);
+    if (!WriteFile(outputPath, QString::fromUtf8(GenerateJson(results)))) {
+        return 1;
+    }
+    QTextStream(stdout) << "Results: " << outputPath << Qt::endl;
+    // 正确性检查失败时以非0退出, 便于脚本发现
+    return harness.hasFailures() ? 2 : 0;
+}
@@ -0,0 +1,342 @@
+﻿#include "renderbenchmarks.h"
+#include <memory>
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QMouseEvent>
+#include <QThread>
+#include <QWheelEvent>
+#include "ImageView1/framemailbox.h"
+#include "ImageView1/imageview1.h"
+#include "ImageView1/tilepyramid.h"
+#include "ImageView2/imageview2.h"
+#include "VisionLibrary/bufferpool.h"
+#include "VisionLibrary/visionlibrary.h"
+
+// 暴露protected的currentScale, 用于把缩放调到指定的比例
+template <typename View>
+class BenchmarkView : public View
+{
+public:
+    using View::currentScale;
+};
+
+// 暴露protected的levelImage, 用于比较局部更新与整层重新生成的结果
+class CheckedTilePyramid : public TilePyramid
+{
+public:
+    using TilePyramid::levelImage;
+};
+
+/*!
+ * \brief checkTilePyramidInvalidate 全图模式下, 局部更新(invalidate)之后的各层与重新生成的各层逐像素相同.
+ * 覆盖宽高为奇数(缩放比例不是整数)的层, 以及跨瓦片和层边界的脏区域
+ */
+static void checkTilePyramidInvalidate(BenchmarkHarness &harness)
+{
+    static const QSize SIZES[] = {QSize(1501, 1237), QSize(1500, 1237), QSize(1501, 1236), QSize(2048, 1536)};
+    for (const QSize &size : SIZES) {
+        const QString name = QString("check/TilePyramid/invalidate/%1x%2").arg(size.width()).arg(size.height());
+        if (!harness.isSelected(name)) {
+            continue;
+        }
+        QImage base(size, QImage::Format_ARGB32_Premultiplied);
+        cv::Mat baseMat = wrapImageAsMat(base);
+        cv::RNG rng(5);
+        rng.fill(baseMat, cv::RNG::UNIFORM, 0, 256);
+
+        CheckedTilePyramid updated;
+        updated.reset(size);
+        for (int level = 0; level < updated.levelCount(); ++level) {
+            updated.levelImage(base, level);
+        }
+        // 改变几块区域, 每块之后局部更新
+        const QRect dirtyRects[] = {
+            QRect(0, 0, 1, 1),
+            QRect(size.width() - 3, size.height() - 2, 3, 2),
+            QRect(511, 300, 3, 700),
+            QRect(rng.uniform(0, size.width() / 2), rng.uniform(0, size.height() / 2), 333, 17),
+        };
+        for (const QRect &dirtyRect : dirtyRects) {
+            const QRect rect = dirtyRect & base.rect();
+            rng.fill(baseMat(VisionLibrary::toCvRect(rect)), cv::RNG::UNIFORM, 0, 256);
+            updated.invalidate(base, rect);
+        }
+
+        CheckedTilePyramid rebuilt;
+        rebuilt.reset(size);
+        QStringList mismatches;
+        for (int level = 1; level < rebuilt.levelCount(); ++level) {
+            if (updated.levelImage(base, level) != rebuilt.levelImage(base, level)) {
+                mismatches.append(QString::number(level));
+            }
+        }
+        harness.check(name, mismatches.isEmpty(), QString("levels differ from a full rebuild: %1").arg(mismatches.join(", ")));
+    }
+}
+
+// 一种尺寸的测试图像
+struct ImageSizeCase {
+    const char *name;
+    cv::Size size;
+};
+
+static const ImageSizeCase IMAGE_SIZES[] = {
+    {"VGA", cv::Size(640, 480)},
+    {"5MP", cv::Size(2592, 1944)},
+    {"20MP", cv::Size(5472, 3648)},
+    {"100MP", cv::Size(10000, 10000)},
+};
+
+static const QSize WIDGET_SIZES[] = {
+    QSize(800, 600),
+    QSize(1920, 1080),
+    QSize(3840, 2160),
+};
+
+// 超过这个像素数的图像用延迟转换模式显示, 同实际使用时的建议
+constexpr qint64 LAZY_CONVERSION_MIN_PIXELS = 25000000;
+
+// 平移和缩放的起始缩放比例(窗口像素/图像像素), 0表示适应窗口. 最后两个是开始画像素网格和开始显示像素值的比例
+static const double ZOOM_LEVELS[] = {0.0, 1.0, 4.0, ImageView1::PIXEL_GRID_MIN_SCALE, ImageView1::PIXEL_TEXT_MIN_SCALE};
+
+// 脚本的一步
+enum class Script : int {
+    Pan, // 按住左键拖动, 来回移动
+    Zoom, // 在窗口中心滚动滚轮, 放大10次再缩小10次
+    Resize, // 窗口在原大小和90%之间交替
+};
+
+/*!
+ * \brief The ViewDriver class 向控件发送合成的鼠标和滚轮事件, 再把控件渲染到QImage
+ * \note 事件直接交给控件处理(sendEvent), 不经过事件循环, 所以每一帧的耗时只包括事件处理和paintEvent
+ */
+class ViewDriver
+{
+public:
+    ViewDriver(QWidget *view, const QSize &frameSize)
+        : _view(view), _frame(frameSize, QImage::Format_ARGB32_Premultiplied)
+    {
+    }
+
+    void press(const QPoint &pos, const Qt::KeyboardModifiers modifiers = Qt::NoModifier)
+    {
+        QMouseEvent event(QEvent::MouseButtonPress, pos, _view->mapToGlobal(pos), Qt::LeftButton, Qt::LeftButton, modifiers);
+        QCoreApplication::sendEvent(_view, &event);
+    }
+
+    void move(const QPoint &pos, const Qt::KeyboardModifiers modifiers = Qt::NoModifier)
+    {
+        QMouseEvent event(QEvent::MouseMove, pos, _view->mapToGlobal(pos), Qt::NoButton, Qt::LeftButton, modifiers);
+        QCoreApplication::sendEvent(_view, &event);
+    }
+
+    void release(const QPoint &pos)
+    {
+        QMouseEvent event(QEvent::MouseButtonRelease, pos, _view->mapToGlobal(pos), Qt::LeftButton, Qt::NoButton, Qt::NoModifier);
+        QCoreApplication::sendEvent(_view, &event);
+    }
+
+    // 滚轮转一格. zoomIn为true时放大
+    void wheel(const QPoint &pos, const bool zoomIn)
+    {
+        QWheelEvent event(QPointF(pos), QPointF(_view->mapToGlobal(pos)), QPoint(), QPoint(0, zoomIn ? 120 : -120),
+                          Qt::NoButton, Qt::NoModifier, Qt::NoScrollPhase, false);
+        QCoreApplication::sendEvent(_view, &event);
+    }
+
+    void render()
+    {
+        _view->render(&_frame);
+    }
+
+private:
+    QWidget *const _view;
+    QImage _frame;
+};
+
+// 处理事件直到condition成立或超时, 用于等待后台计算(比如选框统计的积分图)
+static bool waitFor(const std::function<bool()> &condition, const int timeoutMs)
+{
+    QElapsedTimer timer;
+    timer.start();
+    while (!condition()) {
+        if (timer.elapsed() > timeoutMs) {
+            return false;
+        }
+        QCoreApplication::processEvents();
+        QThread::msleep(1);
+    }
+    return true;
+}
+
+static QString scriptName(const Script script)
+{
+    switch (script) {
+    case Script::Pan:
+        return "pan";
+    case Script::Zoom:
+        return "zoom";
+    default:
+        return "resize";
+    }
+}
+
+/*!
+ * \brief runCase 运行一个用例: 显示mat, 调到起始缩放比例, 然后每一帧执行脚本的一步并渲染
+ * \param withMarquee 为true时用ImageView2, 并在窗口中心拉一个1/3窗口大小的选框
+ */
+static void runCase(BenchmarkHarness &harness, const ImageSizeCase &imageCase, const cv::Mat &mat,
+                    const QSize &widgetSize, const bool withMarquee, const Script script, const double zoomLevel)
+{
+    const QString viewName = withMarquee ? "ImageView2" : "ImageView1";
+    const QString zoomName = zoomLevel > 0.0 ? QString("x%1").arg(zoomLevel) : QString("fit");
+    const QString name = QString("%1/%2/%3x%4/%5/%6").arg(viewName, imageCase.name).arg(widgetSize.width())
+                         .arg(widgetSize.height()).arg(scriptName(script), zoomName);
+    if (!harness.isSelected(name)) {
+        return;
+    }
+
+    std::unique_ptr<ImageView1> view;
+    std::function<double()> currentScale;
+    if (withMarquee) {
+        BenchmarkView<ImageView2> *const view2 = new BenchmarkView<ImageView2>;
+        currentScale = [view2]() {
+            return view2->currentScale();
+        };
+        view.reset(view2);
+    } else {
+        BenchmarkView<ImageView1> *const view1 = new BenchmarkView<ImageView1>;
+        currentScale = [view1]() {
+            return view1->currentScale();
+        };
+        view.reset(view1);
+    }
+    const bool lazyConversion = qint64(mat.total()) >= LAZY_CONVERSION_MIN_PIXELS;
+    view->setLazyConversion(lazyConversion);
+    view->resize(widgetSize);
+    view->show();
+    view->setMat(mat);
+
+    ViewDriver driver(view.get(), widgetSize);
+    const QPoint center(widgetSize.width() / 2, widgetSize.height() / 2);
+    if (withMarquee) {
+        driver.press(QPoint(widgetSize.width() / 3, widgetSize.height() / 3), Qt::ControlModifier);
+        driver.move(QPoint(widgetSize.width() * 2 / 3, widgetSize.height() * 2 / 3), Qt::ControlModifier);
+        driver.release(QPoint(widgetSize.width() * 2 / 3, widgetSize.height() * 2 / 3));
+        // 第一次绘制时开始在后台计算积分图, 算好之后选框下方才有统计量和直方图
+        driver.render();
+        ImageView2 *const view2 = static_cast<ImageView2 *>(view.get());
+        waitFor([view2]() {
+            return view2->roiStatistics().isValid();
+        }, 30000);
+    }
+    // 滚轮一次放大1.2倍, 调到不小于zoomLevel
+    for (int i = 0; i < 100 && currentScale() < zoomLevel; ++i) {
+        driver.wheel(center, true);
+    }
+
+    // 拖动的起点在选框之外, 所以ImageView2中拖动的也是图像
+    const QPoint panAnchor(widgetSize.width() / 8, widgetSize.height() / 8);
+    if (Script::Pan == script) {
+        driver.press(panAnchor);
+    }
+    int step = 0;
+    const std::function<void()> stepScript = [&]() {
+        switch (script) {
+        case Script::Pan: {
+            // 每32步换一次方向, 图像在原位附近来回移动
+            const int phase = step % 64;
+            const int distance = phase < 32 ? phase : 64 - phase;
+            driver.move(panAnchor + QPoint(16 * distance, 9 * distance));
+            break;
+        }
+        case Script::Zoom:
+            driver.wheel(center, step % 20 < 10);
+            break;
+        case Script::Resize:
+            view->resize(step % 2 ? widgetSize * 0.9 : widgetSize);
+            break;
+        }
+        ++step;
+    };
+
+    QJsonObject parameters;
+    parameters.insert("view", viewName);
+    parameters.insert("image", imageCase.name);
+    parameters.insert("imageWidth", mat.cols);
+    parameters.insert("imageHeight", mat.rows);
+    parameters.insert("widgetWidth", widgetSize.width());
+    parameters.insert("widgetHeight", widgetSize.height());
+    parameters.insert("script", scriptName(script));
+    parameters.insert("zoom", zoomName);
+    parameters.insert("startScale", currentScale());
+    parameters.insert("lazyConversion", lazyConversion);
+    harness.run(name, parameters, qint64(widgetSize.width()) * widgetSize.height(), [&]() {
+        stepScript();
+        driver.render();
+    });
+}
+
+/*!
+ * \brief runFrameMailboxCases 采集线程送图的路径: 每帧从缓冲池取cv::Mat, publish(), 等工作线程处理完再take().
+ * 不转换时只有邮箱本身的开销, 稳定之后每帧的堆分配和cv::Mat分配都应该是0; 默认转换(零拷贝包装)时再加上包装的分配
+ */
+static void runFrameMailboxCases(BenchmarkHarness &harness, const ImageSizeCase &imageCase)
+{
+    for (const bool convert : {false, true}) {
+        const QString name = QString("FrameMailbox/publishTake/8UC1/%1%2").arg(imageCase.name, convert ? "/toDisplayImage" : "");
+        if (!harness.isSelected(name)) {
+            continue;
+        }
+        FrameMailbox mailbox;
+        if (!convert) {
+            mailbox.setConverter(nullptr);
+        }
+        VisionLibrary::BufferPool &pool = VisionLibrary::BufferPool::instance();
+        cv::Mat mat;
+        QImage image;
+        QJsonObject parameters;
+        parameters.insert("image", imageCase.name);
+        parameters.insert("imageWidth", imageCase.size.width);
+        parameters.insert("imageHeight", imageCase.size.height);
+        parameters.insert("converter", convert ? "toDisplayImage" : "none");
+        harness.run(name, parameters, imageCase.size.area(), [&]() {
+            mailbox.publish(pool.acquireMat(imageCase.size.height, imageCase.size.width, CV_8UC1));
+            while (!mailbox.take(mat, image)) {
+                QThread::yieldCurrentThread();
+            }
+        });
+    }
+}
+
+void runRenderBenchmarks(BenchmarkHarness &harness, const double maxMegapixels)
+{
+    checkTilePyramidInvalidate(harness);
+
+    for (const ImageSizeCase &imageCase : IMAGE_SIZES) {
+        if (imageCase.size.area() > maxMegapixels * 1e6) {
+            continue;
+        }
+        runFrameMailboxCases(harness, imageCase);
+
+        // 噪声叠加水平渐变, 不会被压成单色
+        cv::Mat mat(imageCase.size, CV_8UC1);
+        cv::RNG rng(1);
+        rng.fill(mat, cv::RNG::UNIFORM, 0, 64);
+        cv::Mat ramp(1, mat.cols, CV_8UC1);
+        for (int j = 0; j < mat.cols; ++j) {
+            ramp.at<uchar>(0, j) = cv::saturate_cast<uchar>(192.0 * j / mat.cols);
+        }
+        cv::add(mat, cv::repeat(ramp, mat.rows, 1), mat);
+
+        for (const QSize &widgetSize : WIDGET_SIZES) {
+            for (const bool withMarquee : {false, true}) {
+                for (const double zoomLevel : ZOOM_LEVELS) {
+                    runCase(harness, imageCase, mat, widgetSize, withMarquee, Script::Pan, zoomLevel);
+                }
+                runCase(harness, imageCase, mat, widgetSize, withMarquee, Script::Zoom, 0.0);
+                runCase(harness, imageCase, mat, widgetSize, withMarquee, Script::Resize, 0.0);
+            }
+        }
+    }
+}
@@ -0,0 +1,14 @@
+﻿#pragma once
+
+#include "Benchmark/benchmarkharness.h"
+
+/*!
+ * \brief runRenderBenchmarks 运行ImageView1和ImageView2(带选框)的渲染基准测试
+ * \note 每个用例按脚本(平移, 缩放, 改变窗口大小)逐帧发送鼠标/滚轮事件, 再render()到QImage.
+ * 一帧的耗时就是一次调用的耗时, 结果中的medianNs, p99Ns和callsPerSecond即p50/p99帧时间和帧率.
+ * 覆盖不同的图像大小(VGA到100MP), 窗口大小和起始缩放比例(适应窗口到显示像素值)
+ * 另外检查TilePyramid局部更新的结果与整层重新生成的相同, 并测量FrameMailbox送图路径每帧的耗时和分配次数
+ * \param harness
+ * \param maxMegapixels 跳过更大的图像
+ */
+void runRenderBenchmarks(BenchmarkHarness &harness, const double maxMegapixels);
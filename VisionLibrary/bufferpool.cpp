@@ -0,0 +1,166 @@
+﻿#include "bufferpool.h"
+#include <QDebug>
+
+using namespace VisionLibrary;
+
+// cv::Mat只被缓冲池引用, 也就是闲置的
+static bool isIdle(const cv::Mat &mat)
+{
+    // 其他线程可能正在增减引用计数, 用原子操作读取
+    return nullptr != mat.u && 1 == CV_XADD(&mat.u->refcount, 0);
+}
+
+static qint64 matBytes(const cv::Mat &mat)
+{
+    return static_cast<qint64>(mat.total() * mat.elemSize());
+}
+
+BufferPool &BufferPool::instance()
+{
+    static BufferPool *const pool = new BufferPool;
+    return *pool;
+}
+
+BufferPool::BufferPool() = default;
+
+BufferPool::~BufferPool()
+{
+    // 此时仍被外面持有的QImage归还时会访问已析构的缓冲池, 所以只有确定没有外借的缓冲池才能析构
+    clear();
+}
+
+QImage BufferPool::acquireImage(const QSize &size, const QImage::Format format)
+{
+    if (size.isEmpty() || QImage::Format_Invalid == format) {
+        return QImage();
+    }
+    // 与QImage自己分配时相同: 每行按4字节对齐
+    const int bytesPerLine = ((size.width() * QImage::toPixelFormat(format).bitsPerPixel() + 31) >> 5) << 2;
+    const quint64 key = makeKey(size.width(), size.height(), format);
+
+    ImageBuffer *buffer = nullptr;
+    {
+        QMutexLocker locker(&_mutex);
+        const auto it = _idleImages.find(key);
+        if (it != _idleImages.end()) {
+            buffer = it.value();
+            _idleImages.erase(it);
+            _idleImageBytes -= buffer->bytes;
+        }
+    }
+    if (nullptr != buffer) {
+        ++_hitCount;
+    } else {
+        ++_missCount;
+        const qint64 bytes = qint64(bytesPerLine) * size.height();
+        uchar *const data = static_cast<uchar *>(cv::fastMalloc(static_cast<size_t>(bytes)));
+        buffer = new ImageBuffer{this, key, data, bytes};
+    }
+    // 用非const的内存构造, 所以只要只有一份拷贝, 调用bits()就不会深拷贝
+    return QImage(buffer->data, size.width(), size.height(), bytesPerLine, format,
+                  releaseImageBuffer, buffer);
+}
+
+cv::Mat BufferPool::acquireMat(const int rows, const int cols, const int type)
+{
+    if (rows <= 0 || cols <= 0) {
+        return cv::Mat();
+    }
+    const quint64 key = makeKey(cols, rows, type);
+    QMutexLocker locker(&_mutex);
+    for (auto it = _mats.find(key); it != _mats.end() && it.key() == key; ++it) {
+        if (isIdle(it.value())) {
+            ++_hitCount;
+            return it.value();
+        }
+    }
+    ++_missCount;
+    const cv::Mat mat(rows, cols, type);
+    _mats.insert(key, mat);
+    trimMats();
+    return mat;
+}
+
+void BufferPool::setCapacity(const int megaBytes)
+{
+    QMutexLocker locker(&_mutex);
+    _capacity = qint64(qMax(0, megaBytes)) * 1024 * 1024;
+    trimMats();
+}
+
+void BufferPool::clear()
+{
+    QMutexLocker locker(&_mutex);
+    for (ImageBuffer *buffer : qAsConst(_idleImages)) {
+        cv::fastFree(buffer->data);
+        delete buffer;
+    }
+    _idleImages.clear();
+    _idleImageBytes = 0;
+    // 正在被使用的cv::Mat不归缓冲池管了, 由最后一个引用者释放
+    _mats.clear();
+}
+
+quint64 BufferPool::hitCount() const
+{
+    return _hitCount;
+}
+
+quint64 BufferPool::missCount() const
+{
+    return _missCount;
+}
+
+qint64 BufferPool::idleBytes() const
+{
+    QMutexLocker locker(&_mutex);
+    qint64 bytes = _idleImageBytes;
+    for (const cv::Mat &mat : _mats) {
+        if (isIdle(mat)) {
+            bytes += matBytes(mat);
+        }
+    }
+    return bytes;
+}
+
+quint64 BufferPool::makeKey(const int width, const int height, const int format)
+{
+    return (quint64(format) << 48) | (quint64(width) << 24) | quint64(height);
+}
+
+void BufferPool::releaseImageBuffer(void *info)
+{
+    ImageBuffer *const buffer = static_cast<ImageBuffer *>(info);
+    buffer->pool->release(buffer);
+}
+
+void BufferPool::release(ImageBuffer *buffer)
+{
+    QMutexLocker locker(&_mutex);
+    if (_idleImageBytes + buffer->bytes > _capacity) {
+        // 闲置的太多了, 直接释放
+        cv::fastFree(buffer->data);
+        delete buffer;
+        return;
+    }
+    _idleImages.insert(buffer->key, buffer);
+    _idleImageBytes += buffer->bytes;
+}
+
+void BufferPool::trimMats()
+{
+    qint64 idleMatBytes = 0;
+    for (const cv::Mat &mat : qAsConst(_mats)) {
+        if (isIdle(mat)) {
+            idleMatBytes += matBytes(mat);
+        }
+    }
+    for (auto it = _mats.begin(); it != _mats.end() && _idleImageBytes + idleMatBytes > _capacity;) {
+        if (isIdle(it.value())) {
+            idleMatBytes -= matBytes(it.value());
+            it = _mats.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
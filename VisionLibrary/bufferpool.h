@@ -0,0 +1,76 @@
+﻿#pragma once
+
+#include <atomic>
+#include <QImage>
+#include <QMutex>
+#include <QMultiHash>
+#include <opencv2/opencv.hpp>
+
+namespace VisionLibrary {
+
+/*!
+ * \brief The BufferPool class 按(大小, 格式)回收复用的像素缓冲池, 用于消除显示流程中每帧的大块内存分配
+ * \note
+ * - acquireImage()返回的QImage的像素内存来自缓冲池, 最后一份QImage拷贝析构时(在QImage的cleanupFunction中)自动归还;
+ * - acquireMat()返回的cv::Mat由缓冲池保留一份引用, 当外面没有人再引用它时(引用计数回到1), 下次acquireMat()就会复用它;
+ * - 所有函数都是线程安全的. 稳定的视频流中, 每帧都能命中缓冲池, 不再分配像素内存
+ */
+class BufferPool
+{
+public:
+    // 默认闲置内存上限(MB)
+    static constexpr int DEFAULT_CAPACITY = 512;
+
+    // 显示流程共用的缓冲池. 故意不析构, 保证在程序退出时仍被持有的QImage能安全归还
+    static BufferPool &instance();
+
+    BufferPool();
+    ~BufferPool();
+    BufferPool(const BufferPool &) = delete;
+    BufferPool &operator=(const BufferPool &) = delete;
+
+    // 取得一块size大小, format格式的QImage, 内容未初始化
+    QImage acquireImage(const QSize &size, const QImage::Format format);
+    // 取得一块rows x cols, type类型的cv::Mat, 内容未初始化
+    cv::Mat acquireMat(const int rows, const int cols, const int type);
+
+    // 闲置内存的上限(MB), 归还时超过上限的缓冲直接释放
+    void setCapacity(const int megaBytes);
+    // 释放所有闲置的缓冲
+    void clear();
+
+    // 命中次数(复用了闲置缓冲)
+    quint64 hitCount() const;
+    // 未命中次数(分配了新缓冲)
+    quint64 missCount() const;
+    // 当前闲置的字节数
+    qint64 idleBytes() const;
+
+private:
+    // QImage的像素缓冲, 同时作为cleanupInfo, 自身也被复用
+    struct ImageBuffer {
+        BufferPool *pool;
+        quint64 key;
+        uchar *data;
+        qint64 bytes;
+    };
+
+    static quint64 makeKey(const int width, const int height, const int format);
+    // QImage的cleanupFunction
+    static void releaseImageBuffer(void *info);
+    void release(ImageBuffer *buffer);
+    // 在已加锁的情况下, 释放闲置的cv::Mat直到闲置内存不超过上限
+    void trimMats();
+
+    mutable QMutex _mutex;
+    QMultiHash<quint64, ImageBuffer *> _idleImages;
+    // 缓冲池持有的所有cv::Mat(包括正在被使用的)
+    QMultiHash<quint64, cv::Mat> _mats;
+    qint64 _idleImageBytes = 0;
+    qint64 _capacity = qint64(DEFAULT_CAPACITY) * 1024 * 1024;
+
+    std::atomic<quint64> _hitCount{0};
+    std::atomic<quint64> _missCount{0};
+};
+
+}
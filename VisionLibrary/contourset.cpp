@@ -0,0 +1,236 @@
+﻿#include "contourset.h"
+
+using namespace VisionLibrary;
+
+// 不拷贝的CV_32SC2的cv::Mat, OpenCV的轮廓函数都接受这种格式
+static cv::Mat pointsMat(const cv::Point *points, const size_t count)
+{
+    return cv::Mat(static_cast<int>(count), 1, CV_32SC2, const_cast<cv::Point *>(points));
+}
+
+ContourSet::Contour::Contour(const ContourSet *set, const size_t index) : _set(set), _index(index)
+{
+}
+
+size_t ContourSet::Contour::size() const
+{
+    return _set->_offsets[_index + 1] - _set->_offsets[_index];
+}
+
+bool ContourSet::Contour::empty() const
+{
+    return 0 == size();
+}
+
+const cv::Point *ContourSet::Contour::begin() const
+{
+    return _set->_points.data() + _set->_offsets[_index];
+}
+
+const cv::Point *ContourSet::Contour::end() const
+{
+    return _set->_points.data() + _set->_offsets[_index + 1];
+}
+
+const cv::Point &ContourSet::Contour::operator[](const size_t i) const
+{
+    return begin()[i];
+}
+
+const int *ContourSet::Contour::coordinates() const
+{
+    // cv::Point_<int>只有x, y两个成员, 连续的点就是连续的坐标
+    static_assert(sizeof(cv::Point) == 2 * sizeof(int), "cv::Point is not two packed ints");
+    return &begin()->x;
+}
+
+const cv::Rect &ContourSet::Contour::boundingRect() const
+{
+    return _set->_boundingRects[_index];
+}
+
+double ContourSet::Contour::area() const
+{
+    return _set->_areas[_index];
+}
+
+cv::Mat ContourSet::Contour::mat() const
+{
+    return pointsMat(begin(), size());
+}
+
+ContourSet::const_iterator::const_iterator(const ContourSet *set, const size_t index) : _set(set), _index(index)
+{
+}
+
+ContourSet::Contour ContourSet::const_iterator::operator*() const
+{
+    return Contour(_set, _index);
+}
+
+ContourSet::const_iterator &ContourSet::const_iterator::operator++()
+{
+    ++_index;
+    return *this;
+}
+
+ContourSet::const_iterator ContourSet::const_iterator::operator++(int)
+{
+    const const_iterator previous = *this;
+    ++_index;
+    return previous;
+}
+
+bool ContourSet::const_iterator::operator==(const const_iterator &other) const
+{
+    return _set == other._set && _index == other._index;
+}
+
+bool ContourSet::const_iterator::operator!=(const const_iterator &other) const
+{
+    return !(*this == other);
+}
+
+ContourSet::ContourSet() : _offsets(1, 0)
+{
+}
+
+ContourSet::ContourSet(const std::vector<std::vector<cv::Point>> &contours) : ContourSet()
+{
+    assign(contours);
+}
+
+size_t ContourSet::size() const
+{
+    return _offsets.size() - 1;
+}
+
+bool ContourSet::empty() const
+{
+    return 0 == size();
+}
+
+size_t ContourSet::pointCount() const
+{
+    return _points.size();
+}
+
+ContourSet::Contour ContourSet::operator[](const size_t i) const
+{
+    return Contour(this, i);
+}
+
+ContourSet::const_iterator ContourSet::begin() const
+{
+    return const_iterator(this, 0);
+}
+
+ContourSet::const_iterator ContourSet::end() const
+{
+    return const_iterator(this, size());
+}
+
+void ContourSet::clear()
+{
+    _points.clear();
+    _offsets.resize(1);
+    _boundingRects.clear();
+    _areas.clear();
+}
+
+void ContourSet::reserve(const size_t contourCount, const size_t pointCount)
+{
+    _points.reserve(pointCount);
+    _offsets.reserve(contourCount + 1);
+    _boundingRects.reserve(contourCount);
+    _areas.reserve(contourCount);
+}
+
+void ContourSet::shrinkToFit()
+{
+    _points.shrink_to_fit();
+    _offsets.shrink_to_fit();
+    _boundingRects.shrink_to_fit();
+    _areas.shrink_to_fit();
+    std::vector<std::vector<cv::Point>>().swap(_openCvContours);
+}
+
+void ContourSet::append(const cv::Point *points, const size_t count)
+{
+    _points.insert(_points.end(), points, points + count);
+    _offsets.push_back(_points.size());
+    if (0 == count) {
+        _boundingRects.emplace_back();
+        _areas.push_back(0.0);
+        return;
+    }
+    // 用刚拷贝进来的点, 不再访问调用者的内存
+    const cv::Mat mat = pointsMat(_points.data() + _points.size() - count, count);
+    _boundingRects.push_back(cv::boundingRect(mat));
+    _areas.push_back(cv::contourArea(mat));
+}
+
+void ContourSet::append(const std::vector<cv::Point> &contour)
+{
+    append(contour.data(), contour.size());
+}
+
+void ContourSet::assign(const std::vector<std::vector<cv::Point>> &contours)
+{
+    clear();
+    size_t total = 0;
+    for (const std::vector<cv::Point> &contour : contours) {
+        total += contour.size();
+    }
+    reserve(contours.size(), total);
+    for (const std::vector<cv::Point> &contour : contours) {
+        append(contour);
+    }
+}
+
+std::vector<std::vector<cv::Point>> ContourSet::toVector() const
+{
+    std::vector<std::vector<cv::Point>> contours;
+    contours.reserve(size());
+    for (const Contour &contour : *this) {
+        contours.emplace_back(contour.begin(), contour.end());
+    }
+    return contours;
+}
+
+const std::vector<cv::Point> &ContourSet::points() const
+{
+    return _points;
+}
+
+const std::vector<size_t> &ContourSet::offsets() const
+{
+    return _offsets;
+}
+
+const std::vector<cv::Rect> &ContourSet::boundingRects() const
+{
+    return _boundingRects;
+}
+
+const std::vector<double> &ContourSet::areas() const
+{
+    return _areas;
+}
+
+void ContourSet::draw(cv::Mat &image, const cv::Scalar &color, const int thickness, const int lineType) const
+{
+    // 直接用点数组画, 不用拷贝成std::vector<std::vector<cv::Point>>
+    for (const Contour &contour : *this) {
+        if (contour.empty()) {
+            continue;
+        }
+        const cv::Point *points = contour.begin();
+        const int count = static_cast<int>(contour.size());
+        if (thickness < 0) {
+            cv::fillPoly(image, &points, &count, 1, color, lineType);
+        } else {
+            cv::polylines(image, &points, &count, 1, true, color, thickness, lineType);
+        }
+    }
+}
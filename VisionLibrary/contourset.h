@@ -0,0 +1,133 @@
+﻿#pragma once
+
+#include <iterator>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+namespace VisionLibrary {
+
+/*!
+ * \brief The ContourSet class 扁平存储的轮廓集合, 代替std::vector<std::vector<cv::Point>>
+ * \note
+ * - 所有轮廓的点连续地存在一个数组中, 第i个轮廓是[offsets[i], offsets[i + 1]);
+ * - 每个轮廓的外接矩形和面积存在与轮廓平行的数组中, 添加轮廓时计算;
+ * - clear()只清空内容, 不释放内存. 每帧复用同一个ContourSet, 稳定之后就不再分配内存;
+ * - findSimpleExternalContours用的OpenCV格式的中间缓冲也属于ContourSet, 随它复用和释放(shrinkToFit());
+ * - Contour是轮廓的视图, 在ContourSet被修改之前有效
+ *
+ * 用法:
+ * \code
+ * VisionLibrary::ContourSet contours; // 跨帧复用
+ * VisionLibrary::findSimpleExternalContours(mask, contours);
+ * for (const VisionLibrary::ContourSet::Contour &contour : contours) {
+ *     if (contour.area() > minArea) {
+ *         writer.numberArray(contour.coordinates(), contour.size() * 2);
+ *     }
+ * }
+ * contours.draw(drawing, VisionLibrary::SCALAR_WHITE);
+ * \endcode
+ */
+class ContourSet
+{
+public:
+    class Contour
+    {
+    public:
+        size_t size() const;
+        bool empty() const;
+        const cv::Point *begin() const;
+        const cv::Point *end() const;
+        const cv::Point &operator[](const size_t i) const;
+        // 点的坐标x0, y0, x1, y1, ..., 共size() * 2个, 用于导出
+        const int *coordinates() const;
+        const cv::Rect &boundingRect() const;
+        // 同cv::contourArea(contour)
+        double area() const;
+        // 不拷贝的CV_32SC2的cv::Mat(size() x 1), 用于OpenCV的函数
+        cv::Mat mat() const;
+
+    private:
+        friend class ContourSet;
+        Contour(const ContourSet *set, const size_t index);
+
+        const ContourSet *_set;
+        size_t _index;
+    };
+
+    // 解引用返回Contour视图(值), 不是引用, 所以只是输入迭代器
+    class const_iterator
+    {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = Contour;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = Contour;
+
+        Contour operator*() const;
+        const_iterator &operator++();
+        const_iterator operator++(int);
+        bool operator==(const const_iterator &other) const;
+        bool operator!=(const const_iterator &other) const;
+
+    private:
+        friend class ContourSet;
+        const_iterator(const ContourSet *set, const size_t index);
+
+        const ContourSet *_set;
+        size_t _index;
+    };
+
+    ContourSet();
+    explicit ContourSet(const std::vector<std::vector<cv::Point>> &contours);
+
+    // 轮廓的个数
+    size_t size() const;
+    bool empty() const;
+    // 所有轮廓的点的总数
+    size_t pointCount() const;
+    Contour operator[](const size_t i) const;
+    const_iterator begin() const;
+    const_iterator end() const;
+
+    // 清空内容, 保留内存
+    void clear();
+    void reserve(const size_t contourCount, const size_t pointCount);
+    // 释放多余的内存(包括中间缓冲), 比如处理过一帧特别大的图像之后
+    void shrinkToFit();
+
+    // 添加一个轮廓, 同时计算它的外接矩形和面积
+    void append(const cv::Point *points, const size_t count);
+    void append(const std::vector<cv::Point> &contour);
+    // 替换为OpenCV格式的轮廓
+    void assign(const std::vector<std::vector<cv::Point>> &contours);
+    // 转换为OpenCV格式的轮廓, 每个轮廓分配一次内存, 只用于兼容旧接口
+    std::vector<std::vector<cv::Point>> toVector() const;
+
+    // 底层的数组. offsets()有size() + 1个元素
+    const std::vector<cv::Point> &points() const;
+    const std::vector<size_t> &offsets() const;
+    const std::vector<cv::Rect> &boundingRects() const;
+    const std::vector<double> &areas() const;
+
+    /*!
+     * \brief draw 逐个画出所有轮廓. 轮廓互不重叠时(比如外轮廓), 结果与cv::drawContours(image, contours, -1, color, thickness, lineType)相同
+     * \param image
+     * \param color
+     * \param thickness 小于0(cv::FILLED)时填充
+     * \param lineType
+     */
+    void draw(cv::Mat &image, const cv::Scalar &color, const int thickness = 1, const int lineType = cv::LINE_8) const;
+
+private:
+    friend void findSimpleExternalContours(const cv::Mat &srcImage, ContourSet &contours, const cv::Point &offset);
+
+    std::vector<cv::Point> _points;
+    std::vector<size_t> _offsets;
+    std::vector<cv::Rect> _boundingRects;
+    std::vector<double> _areas;
+    // cv::findContours的输出缓冲, 只是复用它的容量, 内容没有意义
+    std::vector<std::vector<cv::Point>> _openCvContours;
+};
+
+}
@@ -0,0 +1,350 @@
+﻿#include "imagefile.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QDebug>
+#include <QRegularExpression>
+#include "CommonLibrary/GlobalTools/globaltools.h"
+
+/*!
+ * \brief The MappedFileAllocator class 持有文件映射的cv::Mat所用的分配器
+ * \note cv::Mat的引用计数归零时调用unmap() -> deallocate(), 在这里解除映射并关闭文件.
+ * 对这种Mat调用create()重新分配时, 交给OpenCV默认的分配器
+ */
+class MappedFileAllocator : public cv::MatAllocator
+{
+public:
+    cv::UMatData *allocate(int dims, const int *sizes, int type, void *data, size_t *step,
+                           cv::AccessFlag flags, cv::UMatUsageFlags usageFlags) const override
+    {
+        return cv::Mat::getStdAllocator()->allocate(dims, sizes, type, data, step, flags, usageFlags);
+    }
+
+    bool allocate(cv::UMatData *data, cv::AccessFlag accessFlags, cv::UMatUsageFlags usageFlags) const override
+    {
+        return cv::Mat::getStdAllocator()->allocate(data, accessFlags, usageFlags);
+    }
+
+    void deallocate(cv::UMatData *u) const override
+    {
+        if (nullptr == u) {
+            return;
+        }
+        QFile *const file = static_cast<QFile *>(u->userdata);
+        file->unmap(u->origdata);
+        delete file;
+        delete u;
+    }
+
+    // 故意不析构, 保证程序退出时仍被持有的Mat能安全释放
+    static MappedFileAllocator *instance()
+    {
+        static MappedFileAllocator *const allocator = new MappedFileAllocator;
+        return allocator;
+    }
+};
+
+// 映射整个文件. 失败时返回nullptr
+static uchar *mapWholeFile(QFile &file)
+{
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning().noquote() << "Open file failed:" << file.fileName();
+        return nullptr;
+    }
+    if (file.size() <= 0) {
+        qWarning().noquote() << "Empty file:" << file.fileName();
+        return nullptr;
+    }
+    uchar *const mapped = file.map(0, file.size());
+    if (nullptr == mapped) {
+        qWarning().noquote() << "Map file failed:" << file.fileName() << file.errorString();
+    }
+    return mapped;
+}
+
+/*!
+ * \brief fitsInFile 文件是否放得下所描述的图像
+ * \param step 每行字节数, 为0时改为紧密排列的行字节数
+ */
+static bool fitsInFile(const QFile *file, const int rows, const int cols, const int type, const qint64 dataOffset, size_t &step)
+{
+    if (rows <= 0 || cols <= 0 || dataOffset < 0) {
+        qWarning().noquote() << "Invalid image header:" << file->fileName();
+        return false;
+    }
+    const size_t rowBytes = static_cast<size_t>(cols) * CV_ELEM_SIZE(type);
+    if (0 == step) {
+        step = rowBytes;
+    }
+    const qint64 requiredSize = dataOffset + qint64(step) * (rows - 1) + qint64(rowBytes);
+    if (step < rowBytes || file->size() < requiredSize) {
+        qWarning().noquote() << "File too small for the image:" << file->fileName()
+                             << NameValueOf(file->size()) << NameValueOf(requiredSize);
+        return false;
+    }
+    return true;
+}
+
+/*!
+ * \brief wrapMapping 在映射上构造cv::Mat, 并把映射的所有权交给它
+ * \return 文件太小放不下所描述的图像时返回空Mat, 此时映射仍归调用者所有
+ */
+static cv::Mat wrapMapping(QFile *file, uchar *mapped, const int rows, const int cols, const int type,
+                           const qint64 dataOffset, size_t step)
+{
+    if (!fitsInFile(file, rows, cols, type, dataOffset, step)) {
+        return cv::Mat();
+    }
+    MappedFileAllocator *const allocator = MappedFileAllocator::instance();
+    cv::Mat mat(rows, cols, type, mapped + dataOffset, step);
+    cv::UMatData *const u = new cv::UMatData(allocator);
+    u->data = u->origdata = mapped;
+    u->size = static_cast<size_t>(file->size());
+    u->refcount = 1;
+    u->userdata = file;
+    mat.allocator = allocator;
+    mat.u = u;
+    return mat;
+}
+
+// 跳过PGM头中的空白和注释
+static qint64 skipPgmSpaces(const uchar *data, const qint64 size, qint64 pos)
+{
+    while (pos < size) {
+        if ('#' == data[pos]) {
+            while (pos < size && '\n' != data[pos]) {
+                ++pos;
+            }
+        } else if (std::isspace(data[pos])) {
+            ++pos;
+        } else {
+            break;
+        }
+    }
+    return pos;
+}
+
+// 读PGM头中的一个十进制数
+static qint64 readPgmNumber(const uchar *data, const qint64 size, qint64 &pos)
+{
+    pos = skipPgmSpaces(data, size, pos);
+    qint64 value = -1;
+    while (pos < size && std::isdigit(data[pos])) {
+        value = (value < 0 ? 0 : value * 10) + (data[pos] - '0');
+        ++pos;
+    }
+    return value;
+}
+
+static cv::Mat mapPgm(QFile *file, uchar *mapped)
+{
+    const qint64 size = file->size();
+    if (size < 2 || 'P' != mapped[0] || '5' != mapped[1]) {
+        qWarning().noquote() << "Not a binary PGM(P5):" << file->fileName();
+        return cv::Mat();
+    }
+    qint64 pos = 2;
+    const qint64 width = readPgmNumber(mapped, size, pos);
+    const qint64 height = readPgmNumber(mapped, size, pos);
+    const qint64 maxValue = readPgmNumber(mapped, size, pos);
+    // 最大值后面恰好有一个空白字符, 之后就是像素数据
+    ++pos;
+    if (width <= 0 || height <= 0 || maxValue <= 0 || maxValue > 65535 || width > INT_MAX || height > INT_MAX) {
+        qWarning().noquote() << "Invalid PGM header:" << file->fileName();
+        return cv::Mat();
+    }
+    if (maxValue < 256) {
+        return wrapMapping(file, mapped, int(height), int(width), CV_8UC1, pos, 0);
+    }
+    // 16位PGM是大端存储的, 只能交换字节序之后拷贝出来. 映射只在这里读一下, 仍归mapImageFile所有,
+    // 所以用不持有映射的cv::Mat头, 不能用wrapMapping(否则这个临时的Mat析构时就会解除映射并删除file)
+    size_t step = 0;
+    if (!fitsInFile(file, int(height), int(width), CV_16UC1, pos, step)) {
+        return cv::Mat();
+    }
+    const cv::Mat bigEndian(int(height), int(width), CV_16UC1, mapped + pos, step);
+    cv::Mat mat(bigEndian.size(), CV_16UC1);
+    for (int i = 0; i < mat.rows; ++i) {
+        const uchar *const srcRow = bigEndian.ptr<uchar>(i);
+        ushort *const dstRow = mat.ptr<ushort>(i);
+        for (int j = 0; j < mat.cols; ++j) {
+            dstRow[j] = static_cast<ushort>((srcRow[2 * j] << 8) | srcRow[2 * j + 1]);
+        }
+    }
+    return mat;
+}
+
+// NPY的descr(例如"<u2")转换成OpenCV的深度, 不支持时返回-1
+static int npyDepth(const QString &descr)
+{
+    if (descr.size() != 3) {
+        return -1;
+    }
+    const QChar byteOrder = descr[0];
+    const QString kind = descr.mid(1);
+    // 单字节类型的字节序是'|', 多字节类型只支持小端
+    if (QStringLiteral("u1") == kind || QStringLiteral("b1") == kind) {
+        return CV_8U;
+    }
+    if (QStringLiteral("i1") == kind) {
+        return CV_8S;
+    }
+    if ('<' != byteOrder) {
+        return -1;
+    }
+    if (QStringLiteral("u2") == kind) {
+        return CV_16U;
+    }
+    if (QStringLiteral("i2") == kind) {
+        return CV_16S;
+    }
+    if (QStringLiteral("i4") == kind) {
+        return CV_32S;
+    }
+    if (QStringLiteral("f4") == kind) {
+        return CV_32F;
+    }
+    if (QStringLiteral("f8") == kind) {
+        return CV_64F;
+    }
+    return -1;
+}
+
+static cv::Mat mapNpy(QFile *file, uchar *mapped)
+{
+    const qint64 size = file->size();
+    static const char MAGIC[] = "\x93NUMPY";
+    if (size < 10 || 0 != std::memcmp(mapped, MAGIC, 6)) {
+        qWarning().noquote() << "Not a NPY file:" << file->fileName();
+        return cv::Mat();
+    }
+    // 1.0版本的头长度是2字节, 2.0及以上是4字节, 都是小端
+    const int majorVersion = mapped[6];
+    qint64 headerStart = 10;
+    qint64 headerLength = mapped[8] | (mapped[9] << 8);
+    if (majorVersion >= 2) {
+        if (size < 12) {
+            return cv::Mat();
+        }
+        headerStart = 12;
+        headerLength = qint64(mapped[8]) | (qint64(mapped[9]) << 8) | (qint64(mapped[10]) << 16) | (qint64(mapped[11]) << 24);
+    }
+    if (headerStart + headerLength > size) {
+        qWarning().noquote() << "Invalid NPY header:" << file->fileName();
+        return cv::Mat();
+    }
+    const QString header = QString::fromLatin1(reinterpret_cast<const char *>(mapped + headerStart), int(headerLength));
+
+    // 头是一个python字典, 例如{'descr': '<u2', 'fortran_order': False, 'shape': (1024, 2048), }
+    const QString descr = CaptureContent(header, R"('descr'\s*:\s*'([^']+)')");
+    const QString fortranOrder = CaptureContent(header, R"('fortran_order'\s*:\s*(\w+))");
+    const QString shape = CaptureContent(header, R"('shape'\s*:\s*\(([^\)]*)\))");
+    const int depth = npyDepth(descr);
+    if (depth < 0 || QStringLiteral("False") != fortranOrder) {
+        qWarning().noquote() << "Unsupported NPY layout:" << file->fileName() << header;
+        return cv::Mat();
+    }
+    // 任何一维不是整数都拒绝, 不能按截断的维数映射. 空的字段只允许是一维的元组末尾的逗号, 例如(1024,)
+    QStringList fields = shape.split(',');
+    if (2 == fields.size() && fields.last().trimmed().isEmpty()) {
+        fields.removeLast();
+    }
+    QVector<int> dims;
+    for (const QString &field : fields) {
+        bool ok = false;
+        const int value = field.trimmed().toInt(&ok);
+        if (!ok) {
+            qWarning().noquote() << "Invalid NPY shape:" << file->fileName() << shape;
+            return cv::Mat();
+        }
+        dims.append(value);
+    }
+    if (dims.size() < 2 || dims.size() > 3 || (3 == dims.size() && (dims[2] < 1 || dims[2] > CV_CN_MAX))) {
+        qWarning().noquote() << "Unsupported NPY shape:" << file->fileName() << shape;
+        return cv::Mat();
+    }
+    const int channels = 3 == dims.size() ? dims[2] : 1;
+    return wrapMapping(file, mapped, dims[0], dims[1], CV_MAKETYPE(depth, channels), headerStart + headerLength, 0);
+}
+
+// 类型名(例如"16UC1")转换成OpenCV的类型, 不支持时返回-1
+static int parseTypeName(const QString &typeName)
+{
+    const QRegularExpressionMatch match = QRegularExpression(R"(^(8U|8S|16U|16S|32S|32F|64F)C([1-4])$)")
+                                          .match(typeName.trimmed().toUpper());
+    if (!match.hasMatch()) {
+        return -1;
+    }
+    static const QHash<QString, int> DEPTHS{
+        {"8U", CV_8U}, {"8S", CV_8S}, {"16U", CV_16U}, {"16S", CV_16S},
+        {"32S", CV_32S}, {"32F", CV_32F}, {"64F", CV_64F},
+    };
+    return CV_MAKETYPE(DEPTHS.value(match.captured(1)), match.captured(2).toInt());
+}
+
+static cv::Mat mapRaw(QFile *file, uchar *mapped)
+{
+    const QFileInfo fileInfo(file->fileName());
+    const QString headerPath = fileInfo.dir().filePath(fileInfo.completeBaseName() + ".json");
+    QString content;
+    if (!ReadFile(content, headerPath)) {
+        qWarning().noquote() << "RAW header not found:" << headerPath;
+        return cv::Mat();
+    }
+    const QVariantHash header = ParseJson(content);
+    const int type = parseTypeName(header.value("type", "8UC1").toString());
+    if (type < 0) {
+        qWarning().noquote() << "Unsupported RAW type:" << headerPath << header.value("type").toString();
+        return cv::Mat();
+    }
+    return wrapMapping(file, mapped,
+                       header.value("height").toInt(), header.value("width").toInt(), type,
+                       header.value("offset", 0).toLongLong(),
+                       static_cast<size_t>(header.value("step", 0).toLongLong()));
+}
+
+bool VisionLibrary::isMappableImageFile(const QString &filePath)
+{
+    const QString suffix = QFileInfo(filePath).suffix().toLower();
+    return QStringLiteral("pgm") == suffix || QStringLiteral("npy") == suffix || QStringLiteral("raw") == suffix;
+}
+
+cv::Mat VisionLibrary::mapImageFile(const QString &filePath)
+{
+    QFile *const file = new QFile(filePath);
+    uchar *const mapped = mapWholeFile(*file);
+    if (nullptr == mapped) {
+        delete file;
+        return cv::Mat();
+    }
+    const QString suffix = QFileInfo(filePath).suffix().toLower();
+    cv::Mat mat;
+    if (QStringLiteral("pgm") == suffix) {
+        mat = mapPgm(file, mapped);
+    } else if (QStringLiteral("npy") == suffix) {
+        mat = mapNpy(file, mapped);
+    } else if (QStringLiteral("raw") == suffix) {
+        mat = mapRaw(file, mapped);
+    }
+    // 成功时映射归返回的Mat所有; 失败或者16位PGM(结果是拷贝)时在这里解除映射.
+    // 只有wrapMapping构造的Mat的分配器是MappedFileAllocator
+    if (nullptr == mat.u || mat.u->currAllocator != MappedFileAllocator::instance() || mat.u->userdata != file) {
+        file->unmap(mapped);
+        delete file;
+    }
+    return mat;
+}
+
+cv::Mat VisionLibrary::readImage(const QString &filePath, const int flags)
+{
+    if (!isMappableImageFile(filePath)) {
+        return cv::imread(utf8_to_gbk(filePath), flags);
+    }
+    const cv::Mat mat = mapImageFile(filePath);
+    if (cv::IMREAD_GRAYSCALE == flags && mat.channels() > 1) {
+        cv::Mat gray;
+        cv::cvtColor(mat, gray, 4 == mat.channels() ? cv::COLOR_BGRA2GRAY : cv::COLOR_BGR2GRAY);
+        return gray;
+    }
+    return mat;
+}
@@ -0,0 +1,40 @@
+﻿#pragma once
+
+#include <QString>
+#include <opencv2/opencv.hpp>
+
+namespace VisionLibrary {
+
+/*!
+ * \brief isMappableImageFile 按后缀判断是否是mapImageFile支持的格式(.pgm, .npy, .raw)
+ * \param filePath
+ * \return
+ */
+bool isMappableImageFile(const QString &filePath);
+
+/*!
+ * \brief mapImageFile 把未压缩的图像文件映射到内存, 直接在映射上构造cv::Mat, 不读入也不拷贝像素
+ * \param filePath
+ * \return 失败时返回空Mat
+ * \note
+ * ## 支持的格式
+ * - PGM(P5): 8位直接映射; 16位的PGM是大端存储的, 只能读出来交换字节序(拷贝)
+ * - NPY: C顺序, 小端, 2维(rows, cols)或3维(rows, cols, channels), 元素类型为u1/i1/u2/i2/i4/f4/f8
+ * - RAW: 同目录下要有同名的.json描述文件, 例如frame.raw对应frame.json:
+ *   {"width": 16384, "height": 16384, "type": "16UC1", "offset": 0, "step": 0}
+ *   type的写法同OpenCV的类型名去掉"CV_"; offset是像素数据在文件中的偏移, 默认0; step是每行字节数, 默认紧密排列
+ *
+ * 返回的cv::Mat持有映射, 最后一份引用释放时才解除映射, 哪些页常驻内存由操作系统的页缓存决定.
+ * 映射是只读的, 需要修改时先clone()
+ */
+cv::Mat mapImageFile(const QString &filePath);
+
+/*!
+ * \brief readImage 读图. 可映射的格式用mapImageFile(保留原始位深), 其他格式用cv::imread
+ * \param filePath utf-8路径
+ * \param flags 同cv::imread. 对可映射的格式只有cv::IMREAD_GRAYSCALE有意义: 多通道时转换成灰度图(需要拷贝)
+ * \return 失败时返回空Mat
+ */
+cv::Mat readImage(const QString &filePath, const int flags = cv::IMREAD_COLOR);
+
+}
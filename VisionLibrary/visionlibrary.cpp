@@ -1,86 +1,800 @@
 ﻿#include "visionlibrary.h"
+#include "bufferpool.h"
 #include <QDebug>
+#include <QMutex>
 #include <QPixmap>
+#include <opencv2/core/hal/intrin.hpp>
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <unordered_map>
+#include <utility>
 
-QImage toPremultiImage_helper1(const cv::Mat &srcImage, const QImage::Format format)
+/* toPremultiImage的转换核: 每个函数转换一行, 一次遍历直接写出ARGB32预乘的像素.
+ * 在小端机器上ARGB32在内存中的字节顺序是B, G, R, A.
+ * 用OpenCV的universal intrinsics实现SIMD, 编译时启用了哪个指令集(SSE/AVX2/NEON)就用哪个 */
+
+// 3通道 -> ARGB32. 不透明的像素预乘前后相同
+static void bgrRowToPremulti(const uchar *src, uchar *dst, const int width, const bool swapRG)
 {
-    return QImage(srcImage.data,
-                  srcImage.cols, srcImage.rows,
-                  static_cast<int>(srcImage.step),
-                  format);
+    int j = 0;
+#if CV_SIMD
+    const cv::v_uint8 alpha = cv::vx_setall_u8(255);
+    for (; j <= width - cv::v_uint8::nlanes; j += cv::v_uint8::nlanes) {
+        cv::v_uint8 c0, c1, c2;
+        cv::v_load_deinterleave(src + j * 3, c0, c1, c2);
+        if (swapRG) {
+            // 内存中是BGR, 正好对应B, G, R
+            cv::v_store_interleave(dst + j * 4, c0, c1, c2, alpha);
+        } else {
+            cv::v_store_interleave(dst + j * 4, c2, c1, c0, alpha);
+        }
+    }
+#endif
+    for (; j < width; ++j) {
+        const uchar *const s = src + j * 3;
+        uchar *const d = dst + j * 4;
+        d[0] = swapRG ? s[0] : s[2];
+        d[1] = s[1];
+        d[2] = swapRG ? s[2] : s[0];
+        d[3] = 255;
+    }
+}
+
+// 灰度 -> ARGB32
+static void grayRowToPremulti(const uchar *src, uchar *dst, const int width)
+{
+    int j = 0;
+#if CV_SIMD
+    const cv::v_uint8 alpha = cv::vx_setall_u8(255);
+    for (; j <= width - cv::v_uint8::nlanes; j += cv::v_uint8::nlanes) {
+        const cv::v_uint8 gray = cv::vx_load(src + j);
+        cv::v_store_interleave(dst + j * 4, gray, gray, gray, alpha);
+    }
+#endif
+    for (; j < width; ++j) {
+        uchar *const d = dst + j * 4;
+        d[0] = d[1] = d[2] = src[j];
+        d[3] = 255;
+    }
+}
+
+// BGRA(即内存中的ARGB32) -> ARGB32预乘. 与QImage::convertTo的结果相同
+static void bgraRowToPremulti(const uchar *src, uchar *dst, const int width)
+{
+    const QRgb *const s = reinterpret_cast<const QRgb *>(src);
+    QRgb *const d = reinterpret_cast<QRgb *>(dst);
+    for (int j = 0; j < width; ++j) {
+        const QRgb pixel = s[j];
+        const int alpha = qAlpha(pixel);
+        // 大多数像素是完全不透明或完全透明的, 不用做乘法
+        d[j] = (255 == alpha) ? pixel : (0 == alpha ? 0 : qPremultiply(pixel));
+    }
+}
+
+// float -> ARGB32, 灰度为src * scale + offset, 超出[0, 255]的值截断. 默认把[0, 1]映射到[0, 255]
+static void floatRowToPremulti(const float *src, uchar *dst, const int width,
+                        const float scale = 255.0f, const float offset = 0.0f)
+{
+    int j = 0;
+#if CV_SIMD
+    const cv::v_uint8 alpha = cv::vx_setall_u8(255);
+    const cv::v_float32 vScale = cv::vx_setall_f32(scale);
+    const cv::v_float32 vOffset = cv::vx_setall_f32(offset);
+    constexpr int FLOAT_LANES = cv::v_float32::nlanes;
+    for (; j <= width - cv::v_uint8::nlanes; j += cv::v_uint8::nlanes) {
+        const cv::v_int32 i0 = cv::v_round(cv::v_fma(cv::vx_load(src + j), vScale, vOffset));
+        const cv::v_int32 i1 = cv::v_round(cv::v_fma(cv::vx_load(src + j + FLOAT_LANES), vScale, vOffset));
+        const cv::v_int32 i2 = cv::v_round(cv::v_fma(cv::vx_load(src + j + FLOAT_LANES * 2), vScale, vOffset));
+        const cv::v_int32 i3 = cv::v_round(cv::v_fma(cv::vx_load(src + j + FLOAT_LANES * 3), vScale, vOffset));
+        // 两次饱和打包: 小于0的变成0, 大于255的变成255
+        const cv::v_uint8 gray = cv::v_pack(cv::v_pack_u(i0, i1), cv::v_pack_u(i2, i3));
+        cv::v_store_interleave(dst + j * 4, gray, gray, gray, alpha);
+    }
+#endif
+    for (; j < width; ++j) {
+        uchar *const d = dst + j * 4;
+        d[0] = d[1] = d[2] = cv::saturate_cast<uchar>(src[j] * scale + offset);
+        d[3] = 255;
+    }
 }
 
+// double -> ARGB32, 灰度为src * scale + offset, 超出[0, 255]的值截断. 默认把[0, 1]映射到[0, 255]
+static void doubleRowToPremulti(const double *src, uchar *dst, const int width,
+                         const double scale = 255.0, const double offset = 0.0)
+{
+    for (int j = 0; j < width; ++j) {
+        uchar *const d = dst + j * 4;
+        d[0] = d[1] = d[2] = cv::saturate_cast<uchar>(src[j] * scale + offset);
+        d[3] = 255;
+    }
+}
+
+/* 显示映射的转换核: 整数类型查表, lut的下标是原始值减去类型的最小值(lutOffset = -最小值) */
+
+// 单通道 -> ARGB32
 template <typename T>
-QImage toPremultiImage_helper2(const cv::Mat &srcImage)
+static void lutGrayRowToPremulti(const T *src, uchar *dst, const int width, const uchar *lut, const int lutOffset)
 {
-    QImage image(srcImage.cols, srcImage.rows, QImage::Format_ARGB32_Premultiplied);
-    for (int i = 0; i < srcImage.rows; ++i) {
-        const T *const srcRow = srcImage.ptr<T>(i);
-        QRgb *const destRow = reinterpret_cast<QRgb *>(image.scanLine(i));
-        for (int j = 0; j < srcImage.cols; ++j) {
-            const int color = qRound(srcRow[j] * 255.0);
-            destRow[j] = qRgba(color, color, color, 255);
-        }
+    QRgb *const d = reinterpret_cast<QRgb *>(dst);
+    for (int j = 0; j < width; ++j) {
+        const uchar gray = lut[src[j] + lutOffset];
+        d[j] = qRgb(gray, gray, gray);
     }
+}
+
+// 3通道 -> ARGB32
+template <typename T>
+static void lutBgrRowToPremulti(const T *src, uchar *dst, const int width, const uchar *lut, const int lutOffset,
+                         const bool swapRG)
+{
+    QRgb *const d = reinterpret_cast<QRgb *>(dst);
+    for (int j = 0; j < width; ++j) {
+        const T *const s = src + j * 3;
+        const uchar c0 = lut[s[0] + lutOffset];
+        const uchar c1 = lut[s[1] + lutOffset];
+        const uchar c2 = lut[s[2] + lutOffset];
+        d[j] = swapRG ? qRgb(c2, c1, c0) : qRgb(c0, c1, c2);
+    }
+}
+
+// 8位4通道 -> ARGB32预乘, alpha不查表
+static void lutBgraRowToPremulti(const uchar *src, uchar *dst, const int width, const uchar *lut, const bool swapRG)
+{
+    QRgb *const d = reinterpret_cast<QRgb *>(dst);
+    for (int j = 0; j < width; ++j) {
+        const uchar *const s = src + j * 4;
+        const QRgb pixel = swapRG ? qRgba(lut[s[2]], lut[s[1]], lut[s[0]], s[3]) :
+                           qRgba(lut[s[0]], lut[s[1]], lut[s[2]], s[3]);
+        d[j] = (255 == s[3]) ? pixel : (0 == s[3] ? 0 : qPremultiply(pixel));
+    }
+}
+
+// 浮点 -> ARGB32, 带gamma: 先线性映射到[0, 65535]的下标, 再查gamma的64K查找表
+template <typename T>
+static void gammaRowToPremulti(const T *src, uchar *dst, const int width, const double scale, const double offset,
+                        const uchar *gammaLut)
+{
+    QRgb *const d = reinterpret_cast<QRgb *>(dst);
+    for (int j = 0; j < width; ++j) {
+        const uchar gray = gammaLut[cv::saturate_cast<ushort>(src[j] * scale + offset)];
+        d[j] = qRgb(gray, gray, gray);
+    }
+}
+
+// 每个并行任务至少处理这么多像素, 小图就不拆分了, 免得线程调度的开销比转换本身还大
+constexpr double PIXELS_PER_STRIPE = 1 << 16;
+
+/*!
+ * \brief convertRows 从缓冲池取得ARGB32预乘的QImage, 然后把各行分给多个线程, 每行调用一次rowKernel(源行, 目标行)
+ */
+template <typename T, typename RowKernel>
+static QImage convertRows(const cv::Mat &srcImage, RowKernel rowKernel)
+{
+    // 像素内存来自缓冲池, QImage析构时自动归还, 连续的视频帧不会反复分配大块内存
+    QImage image = VisionLibrary::BufferPool::instance().acquireImage(QSize(srcImage.cols, srcImage.rows),
+                                                                      QImage::Format_ARGB32_Premultiplied);
+    if (image.isNull()) {
+        return image;
+    }
+    // 先在当前线程取得像素指针, 工作线程里不要调用QImage的非const函数
+    uchar *const bits = image.bits();
+    const qsizetype bytesPerLine = image.bytesPerLine();
+    const double stripes = std::max(1.0, double(srcImage.total()) / PIXELS_PER_STRIPE);
+    cv::parallel_for_(cv::Range(0, srcImage.rows), [&](const cv::Range &range) {
+        for (int i = range.start; i < range.end; ++i) {
+            rowKernel(srcImage.ptr<T>(i), bits + i * bytesPerLine);
+        }
+#if CV_SIMD
+        cv::vx_cleanup();
+#endif
+    }, stripes);
     return image;
 }
 
 QImage VisionLibrary::toPremultiImage(const cv::Mat &srcImage, const bool swapRG)
 {
+    const int width = srcImage.cols;
     switch ( srcImage.type() ) {
     // 8-bit, 4 channel
     case CV_8UC4: {
-        QImage image = toPremultiImage_helper1(srcImage, QImage::Format_ARGB32);
-        image.convertTo(QImage::Format_ARGB32_Premultiplied);
-        return image;
+        return convertRows<uchar>(srcImage, [width](const uchar *src, uchar *dst) {
+            bgraRowToPremulti(src, dst, width);
+        });
     }
 
     // 8-bit, 3 channel
     case CV_8UC3: {
-        QImage image = toPremultiImage_helper1(srcImage, QImage::Format_RGB888);
-        if (swapRG) {
-            image = image.rgbSwapped();
-        }
-        image.convertTo(QImage::Format_ARGB32_Premultiplied);
-        return image;
+        return convertRows<uchar>(srcImage, [width, swapRG](const uchar *src, uchar *dst) {
+            bgrRowToPremulti(src, dst, width, swapRG);
+        });
     }
 
     // 8-bit, 1 channel
     case CV_8UC1: {
-        QImage image = toPremultiImage_helper1(srcImage, QImage::Format_Grayscale8);
-        image.convertTo(QImage::Format_ARGB32_Premultiplied);
-        return image;
+        return convertRows<uchar>(srcImage, [width](const uchar *src, uchar *dst) {
+            grayRowToPremulti(src, dst, width);
+        });
     }
 
-    /* 下面元素是浮点数的图像未经测试, 等有机会再改 */
-    // float, 1 channel. 调用者请注意: 每个元素必须都在[0, 1]
+    // float, 1 channel. 每个元素应该在[0, 1], 超出的部分截断
     case CV_32FC1: {
-        return toPremultiImage_helper2<float>(srcImage);
+        return convertRows<float>(srcImage, [width](const float *src, uchar *dst) {
+            floatRowToPremulti(src, dst, width);
+        });
     }
 
-    // double, 1 channel. 调用者请注意: 每个元素必须都在[0, 1]
+    // double, 1 channel. 每个元素应该在[0, 1], 超出的部分截断
     case CV_64FC1: {
-        return toPremultiImage_helper2<double>(srcImage);
+        return convertRows<double>(srcImage, [width](const double *src, uchar *dst) {
+            doubleRowToPremulti(src, dst, width);
+        });
     }
     default:
-        qWarning() << QStringLiteral("%1失败! 不支持的cv::Mat类型:%2").arg(__FUNCTION__).arg(srcImage.type());
-        break;
+        // 其余类型(比如16位)按类型的惯例映射
+        return toPremultiImage(srcImage, DisplayMapping(), swapRG);
     }
+}
+
+// 整数类型的最小值, 即查找表下标0对应的原始值
+static int lutMinValue(const int depth)
+{
+    switch (depth) {
+    case CV_8S:
+        return SCHAR_MIN;
+    case CV_16S:
+        return SHRT_MIN;
+    default:
+        return 0;
+    }
+}
+
+// 类型的惯例显示范围, 不支持的类型返回恒等映射
+static VisionLibrary::DisplayMapping defaultDisplayMapping(const int depth)
+{
+    switch (depth) {
+    case CV_8U:
+        return VisionLibrary::DisplayMapping::fromRange(0.0, UCHAR_MAX);
+    case CV_8S:
+        return VisionLibrary::DisplayMapping::fromRange(SCHAR_MIN, SCHAR_MAX);
+    case CV_16U:
+        return VisionLibrary::DisplayMapping::fromRange(0.0, USHRT_MAX);
+    case CV_16S:
+        return VisionLibrary::DisplayMapping::fromRange(SHRT_MIN, SHRT_MAX);
+    case CV_32F:
+    case CV_64F:
+        return VisionLibrary::DisplayMapping::fromRange(0.0, 1.0);
+    default:
+        return VisionLibrary::DisplayMapping();
+    }
+}
 
+/*!
+ * \brief displayLut 整数类型depth在mapping下的查找表, 8位256项, 16位65536项
+ * \note 每种深度缓存最近用过的一张表. 延迟转换时每块瓦片都要查表, 拖动窗宽窗位时每个映射只建一次表
+ */
+static std::shared_ptr<const std::vector<uchar>> displayLut(const int depth, const VisionLibrary::DisplayMapping &mapping)
+{
+    static QMutex mutex;
+    static std::shared_ptr<const std::vector<uchar>> luts[CV_DEPTH_MAX];
+    static VisionLibrary::DisplayMapping lutMappings[CV_DEPTH_MAX];
+    QMutexLocker locker(&mutex);
+    if (luts[depth] && lutMappings[depth] == mapping) {
+        return luts[depth];
+    }
+    const int minValue = lutMinValue(depth);
+    const int size = CV_ELEM_SIZE1(depth) == 1 ? 256 : 65536;
+    const double low = mapping.low();
+    const double window = mapping.window;
+    const double inverseGamma = 1.0 / qMax(mapping.gamma, 1e-3);
+    std::vector<uchar> lut(static_cast<size_t>(size));
+    for (int i = 0; i < size; ++i) {
+        const double t = qBound(0.0, (i + minValue - low) / window, 1.0);
+        lut[i] = static_cast<uchar>(std::lround(255.0 * (1.0 == mapping.gamma ? t : std::pow(t, inverseGamma))));
+    }
+    luts[depth] = std::make_shared<const std::vector<uchar>>(std::move(lut));
+    lutMappings[depth] = mapping;
+    return luts[depth];
+}
+
+QImage VisionLibrary::toPremultiImage(const cv::Mat &srcImage, const DisplayMapping &mapping, const bool swapRG)
+{
+    DisplayMapping actualMapping = mapping;
+    if (mapping.isIdentity()) {
+        switch (srcImage.type()) {
+        case CV_8UC4:
+        case CV_8UC3:
+        case CV_8UC1:
+        case CV_32FC1:
+        case CV_64FC1:
+            // 有专门的转换核
+            return toPremultiImage(srcImage, swapRG);
+        default:
+            actualMapping = defaultDisplayMapping(srcImage.depth());
+            break;
+        }
+        if (actualMapping.isIdentity()) {
+            qWarning() << QStringLiteral("%1失败! 不支持的cv::Mat类型:%2").arg(__FUNCTION__).arg(srcImage.type());
+            return QImage();
+        }
+    }
+
+    const int width = srcImage.cols;
+    const int depth = srcImage.depth();
+    const int channels = srcImage.channels();
+    // 整数类型查表
+    if (CV_8U == depth || CV_8S == depth || CV_16U == depth || CV_16S == depth) {
+        const std::shared_ptr<const std::vector<uchar>> lutHolder = displayLut(depth, actualMapping);
+        const uchar *const lut = lutHolder->data();
+        const int lutOffset = -lutMinValue(depth);
+        switch (srcImage.type()) {
+        case CV_8UC1:
+            return convertRows<uchar>(srcImage, [=](const uchar *src, uchar *dst) {
+                lutGrayRowToPremulti(src, dst, width, lut, lutOffset);
+            });
+        case CV_8UC3:
+            return convertRows<uchar>(srcImage, [=](const uchar *src, uchar *dst) {
+                lutBgrRowToPremulti(src, dst, width, lut, lutOffset, swapRG);
+            });
+        case CV_8UC4:
+            return convertRows<uchar>(srcImage, [=](const uchar *src, uchar *dst) {
+                lutBgraRowToPremulti(src, dst, width, lut, swapRG);
+            });
+        case CV_8SC1:
+            return convertRows<schar>(srcImage, [=](const schar *src, uchar *dst) {
+                lutGrayRowToPremulti(src, dst, width, lut, lutOffset);
+            });
+        case CV_8SC3:
+            return convertRows<schar>(srcImage, [=](const schar *src, uchar *dst) {
+                lutBgrRowToPremulti(src, dst, width, lut, lutOffset, swapRG);
+            });
+        case CV_16UC1:
+            return convertRows<ushort>(srcImage, [=](const ushort *src, uchar *dst) {
+                lutGrayRowToPremulti(src, dst, width, lut, lutOffset);
+            });
+        case CV_16UC3:
+            return convertRows<ushort>(srcImage, [=](const ushort *src, uchar *dst) {
+                lutBgrRowToPremulti(src, dst, width, lut, lutOffset, swapRG);
+            });
+        case CV_16SC1:
+            return convertRows<short>(srcImage, [=](const short *src, uchar *dst) {
+                lutGrayRowToPremulti(src, dst, width, lut, lutOffset);
+            });
+        case CV_16SC3:
+            return convertRows<short>(srcImage, [=](const short *src, uchar *dst) {
+                lutBgrRowToPremulti(src, dst, width, lut, lutOffset, swapRG);
+            });
+        default:
+            break;
+        }
+    } else if (1 == channels && (CV_32F == depth || CV_64F == depth)) {
+        // 浮点类型: 先做仿射变换, 有gamma时再查表
+        const double low = actualMapping.low();
+        const double window = actualMapping.window;
+        if (1.0 == actualMapping.gamma) {
+            const double scale = 255.0 / window;
+            const double offset = -low * scale;
+            if (CV_32F == depth) {
+                return convertRows<float>(srcImage, [=](const float *src, uchar *dst) {
+                    floatRowToPremulti(src, dst, width, float(scale), float(offset));
+                });
+            }
+            return convertRows<double>(srcImage, [=](const double *src, uchar *dst) {
+                doubleRowToPremulti(src, dst, width, scale, offset);
+            });
+        }
+        const std::shared_ptr<const std::vector<uchar>> lutHolder =
+            displayLut(CV_16U, DisplayMapping::fromRange(0.0, USHRT_MAX, actualMapping.gamma));
+        const uchar *const gammaLut = lutHolder->data();
+        const double scale = USHRT_MAX / window;
+        const double offset = -low * scale;
+        if (CV_32F == depth) {
+            return convertRows<float>(srcImage, [=](const float *src, uchar *dst) {
+                gammaRowToPremulti(src, dst, width, scale, offset, gammaLut);
+            });
+        }
+        return convertRows<double>(srcImage, [=](const double *src, uchar *dst) {
+            gammaRowToPremulti(src, dst, width, scale, offset, gammaLut);
+        });
+    }
+    qWarning() << QStringLiteral("%1失败! 不支持的cv::Mat类型:%2").arg(__FUNCTION__).arg(srcImage.type());
     return QImage();
 }
 
+double VisionLibrary::displayIntensity(const double value, const int depth, const DisplayMapping &mapping)
+{
+    DisplayMapping actualMapping = mapping.isIdentity() ? defaultDisplayMapping(depth) : mapping;
+    if (actualMapping.isIdentity()) {
+        if (CV_32S != depth) {
+            return 0.0;
+        }
+        actualMapping = DisplayMapping::fromRange(INT_MIN, INT_MAX);
+    }
+    // NaN截断之后是1
+    const double t = qBound(0.0, (value - actualMapping.low()) / actualMapping.window, 1.0);
+    return 1.0 == actualMapping.gamma ? t : std::pow(t, 1.0 / qMax(actualMapping.gamma, 1e-3));
+}
+
+QImage VisionLibrary::toDisplayImage(const cv::Mat &srcImage, const DisplayMapping &mapping, const bool swapRG)
+{
+    if (mapping.isIdentity()) {
+        return toDisplayImage(srcImage, swapRG);
+    }
+    return toPremultiImage(srcImage, mapping, swapRG);
+}
+
+// 浮点类型直方图的区间数
+constexpr int FLOAT_HISTOGRAM_BINS = 4096;
+
+/*!
+ * \brief parallelHistogram 分块并行统计直方图, 每块先统计到自己的局部直方图, 最后加锁合并
+ * \param values 单通道
+ * \param binOf 原始值 -> 区间序号, 返回负数表示不统计(比如NaN)
+ */
+template <typename T, typename BinOf>
+static std::vector<qint64> parallelHistogram(const cv::Mat &values, const int binCount, BinOf binOf)
+{
+    std::vector<qint64> histogram(static_cast<size_t>(binCount), 0);
+    QMutex mutex;
+    // 合并的开销与区间数成正比, 16位有64K个区间, 所以块数不超过线程数
+    const double stripes = qBound(1.0, double(values.total()) / PIXELS_PER_STRIPE, double(cv::getNumThreads()));
+    cv::parallel_for_(cv::Range(0, values.rows), [&](const cv::Range &range) {
+        std::vector<qint64> local(static_cast<size_t>(binCount), 0);
+        for (int i = range.start; i < range.end; ++i) {
+            const T *const row = values.ptr<T>(i);
+            for (int j = 0; j < values.cols; ++j) {
+                const int bin = binOf(row[j]);
+                if (bin >= 0) {
+                    ++local[bin];
+                }
+            }
+        }
+        QMutexLocker locker(&mutex);
+        for (int bin = 0; bin < binCount; ++bin) {
+            histogram[bin] += local[bin];
+        }
+    }, stripes);
+    return histogram;
+}
+
+// 去掉两端各saturation比例的像素之后, 剩下的第一个和最后一个区间
+static std::pair<int, int> stretchBins(const std::vector<qint64> &histogram, const double saturation)
+{
+    const qint64 total = std::accumulate(histogram.begin(), histogram.end(), qint64(0));
+    const qint64 clipped = static_cast<qint64>(total * qBound(0.0, saturation, 0.499));
+    const int binCount = static_cast<int>(histogram.size());
+    int first = 0;
+    for (qint64 sum = 0; first < binCount - 1; ++first) {
+        sum += histogram[first];
+        if (sum > clipped) {
+            break;
+        }
+    }
+    int last = binCount - 1;
+    for (qint64 sum = 0; last > first; --last) {
+        sum += histogram[last];
+        if (sum > clipped) {
+            break;
+        }
+    }
+    return std::make_pair(first, last);
+}
+
+template <typename T>
+static VisionLibrary::DisplayMapping integerStretch(const cv::Mat &values, const double saturation)
+{
+    const int minValue = std::numeric_limits<T>::min();
+    const int binCount = int(std::numeric_limits<T>::max()) - minValue + 1;
+    const std::vector<qint64> histogram = parallelHistogram<T>(values, binCount, [minValue](const T value) {
+        return value - minValue;
+    });
+    const std::pair<int, int> bins = stretchBins(histogram, saturation);
+    // 至少留一个灰度的窗宽
+    return VisionLibrary::DisplayMapping::fromRange(bins.first + minValue,
+                                                    qMax(bins.second, bins.first + 1) + minValue);
+}
+
+template <typename T>
+static VisionLibrary::DisplayMapping floatStretch(const cv::Mat &values, const double saturation)
+{
+    double minValue = 0.0;
+    double maxValue = 0.0;
+    cv::minMaxIdx(values, &minValue, &maxValue);
+    if (!(maxValue > minValue)) {
+        return VisionLibrary::DisplayMapping::fromRange(minValue, minValue + 1.0);
+    }
+    const double binWidth = (maxValue - minValue) / FLOAT_HISTOGRAM_BINS;
+    const auto binOf = [minValue, binWidth](const T value) {
+        // NaN的比较总是false, 不统计
+        if (!(value >= minValue)) {
+            return -1;
+        }
+        return qMin(static_cast<int>((value - minValue) / binWidth), FLOAT_HISTOGRAM_BINS - 1);
+    };
+    const std::vector<qint64> histogram = parallelHistogram<T>(values, FLOAT_HISTOGRAM_BINS, binOf);
+    const std::pair<int, int> bins = stretchBins(histogram, saturation);
+    return VisionLibrary::DisplayMapping::fromRange(minValue + bins.first * binWidth,
+                                                    minValue + (bins.second + 1) * binWidth);
+}
+
+VisionLibrary::DisplayMapping VisionLibrary::autoStretch(const cv::Mat &srcImage, const double saturation)
+{
+    if (srcImage.empty()) {
+        return DisplayMapping();
+    }
+    // 所有通道一起统计
+    const cv::Mat values = srcImage.reshape(1);
+    switch (values.depth()) {
+    case CV_8U:
+        return integerStretch<uchar>(values, saturation);
+    case CV_8S:
+        return integerStretch<schar>(values, saturation);
+    case CV_16U:
+        return integerStretch<ushort>(values, saturation);
+    case CV_16S:
+        return integerStretch<short>(values, saturation);
+    case CV_32F:
+        return floatStretch<float>(values, saturation);
+    case CV_64F:
+        return floatStretch<double>(values, saturation);
+    default: {
+        double minValue = 0.0;
+        double maxValue = 0.0;
+        cv::minMaxIdx(values, &minValue, &maxValue);
+        return DisplayMapping::fromRange(minValue, qMax(maxValue, minValue + 1.0));
+    }
+    }
+}
+
+// wrapMat的cleanupFunction, QImage的最后一份拷贝析构时调用
+static void releaseWrappedMat(void *info)
+{
+    delete static_cast<cv::Mat *>(info);
+}
+
+// 零拷贝包装: QImage直接引用srcImage的内存, 并在cleanupInfo中持有一份cv::Mat(浅拷贝), 保证内存不会被提前释放.
+// 用const uchar *构造, 所以QImage是只读的, 对它调用bits()会先深拷贝, 不会改到srcImage
+static QImage wrapMat(const cv::Mat &srcImage, const QImage::Format format)
+{
+    return QImage(static_cast<const uchar *>(srcImage.data),
+                  srcImage.cols, srcImage.rows,
+                  static_cast<int>(srcImage.step),
+                  format,
+                  releaseWrappedMat,
+                  new cv::Mat(srcImage));
+}
+
+// 4通道图像的alpha是否全为255
+static bool isOpaque(const cv::Mat &srcImage)
+{
+    for (int i = 0; i < srcImage.rows; ++i) {
+        const uchar *const srcRow = srcImage.ptr<uchar>(i);
+        for (int j = 3; j < srcImage.cols * 4; j += 4) {
+            if (srcRow[j] != 255) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+QImage VisionLibrary::toDisplayImage(const cv::Mat &srcImage, const bool swapRG, const bool opaque)
+{
+    switch ( srcImage.type() ) {
+    // 8-bit, 4 channel. 在小端机器上, 内存中的BGRA就是QImage::Format_RGB32
+    case CV_8UC4: {
+        if (opaque || isOpaque(srcImage)) {
+            return wrapMat(srcImage, swapRG ? QImage::Format_RGB32 : QImage::Format_RGBX8888);
+        }
+        break;
+    }
+
+    // 8-bit, 3 channel
+    case CV_8UC3: {
+        return wrapMat(srcImage, swapRG ? QImage::Format_BGR888 : QImage::Format_RGB888);
+    }
+
+    // 8-bit, 1 channel
+    case CV_8UC1: {
+        return wrapMat(srcImage, QImage::Format_Grayscale8);
+    }
+    default:
+        break;
+    }
+
+    // 不能零拷贝, 只能转换
+    return toPremultiImage(srcImage, swapRG);
+}
+
 QPixmap VisionLibrary::toQPixmap(const cv::Mat &srcImage)
 {
     return QPixmap::fromImage(toPremultiImage(srcImage));
 }
 
-cv::Mat VisionLibrary::threshold(const cv::Mat &srcImage, const int kSize, const int minDiff)
+/*!
+ * \brief compareRow 动态阈值的比较核, 结果写入掩膜的一行. 背景g = round(S / area)与cv::blur取整之后的均值相同
+ * (kSize为奇数时area是奇数, S / area不会恰好是.5), 所以用整数比较:
+ * - f - g >= minDiff 等价于 2S < (2 * (f - minDiff) + 1) * area;
+ * - g - f >= minDiff 等价于 2S > (2 * (f + minDiff) - 1) * area.
+ * f - minDiff截断到[-1, 255], f + minDiff截断到[0, 256], 结果不变, 乘area也不会溢出
+ * \param boxSums 每个像素的邻域和S
+ * \param minDiff 已截断到[-256, 256]
+ */
+static void compareRow(const uchar *src, const int *boxSums, uchar *dst, const int width,
+                       const int area, const int minDiff, const VisionLibrary::ThresholdPolarity polarity)
+{
+    const bool light = VisionLibrary::ThresholdPolarity::Dark != polarity;
+    const bool dark = VisionLibrary::ThresholdPolarity::Light != polarity;
+    int j = 0;
+#if CV_SIMD
+    const cv::v_int32 vArea = cv::vx_setall_s32(area);
+    const cv::v_int32 vMinDiff = cv::vx_setall_s32(minDiff);
+    const cv::v_int32 vMinusOne = cv::vx_setall_s32(-1);
+    const cv::v_int32 vZero = cv::vx_setzero_s32();
+    const cv::v_int32 vOne = cv::vx_setall_s32(1);
+    const cv::v_int32 v255 = cv::vx_setall_s32(255);
+    const cv::v_int32 v256 = cv::vx_setall_s32(256);
+    constexpr int INT_LANES = cv::v_int32::nlanes;
+    const auto compare = [&](const cv::v_int32 &f, const cv::v_int32 &sum) {
+        const cv::v_int32 twiceSum = sum + sum;
+        // 比较结果是全1(-1)或全0, 饱和打包之后仍然是-1或0, 即255或0
+        cv::v_int32 mask = vZero;
+        if (light) {
+            const cv::v_int32 k = cv::v_min(cv::v_max(f - vMinDiff, vMinusOne), v255);
+            mask = mask | cv::v_int32(twiceSum < (k + k + vOne) * vArea);
+        }
+        if (dark) {
+            const cv::v_int32 k = cv::v_min(cv::v_max(f + vMinDiff, vZero), v256);
+            mask = mask | cv::v_int32(twiceSum > (k + k - vOne) * vArea);
+        }
+        return mask;
+    };
+    for (; j <= width - cv::v_uint8::nlanes; j += cv::v_uint8::nlanes) {
+        cv::v_uint16 s0, s1;
+        cv::v_expand(cv::vx_load(src + j), s0, s1);
+        cv::v_uint32 s00, s01, s10, s11;
+        cv::v_expand(s0, s00, s01);
+        cv::v_expand(s1, s10, s11);
+        const cv::v_int32 m0 = compare(cv::v_reinterpret_as_s32(s00), cv::vx_load(boxSums + j));
+        const cv::v_int32 m1 = compare(cv::v_reinterpret_as_s32(s01), cv::vx_load(boxSums + j + INT_LANES));
+        const cv::v_int32 m2 = compare(cv::v_reinterpret_as_s32(s10), cv::vx_load(boxSums + j + INT_LANES * 2));
+        const cv::v_int32 m3 = compare(cv::v_reinterpret_as_s32(s11), cv::vx_load(boxSums + j + INT_LANES * 3));
+        const cv::v_int8 mask = cv::v_pack(cv::v_pack(m0, m1), cv::v_pack(m2, m3));
+        cv::v_store(dst + j, cv::v_reinterpret_as_u8(mask));
+    }
+#endif
+    for (; j < width; ++j) {
+        const int twiceSum = boxSums[j] * 2;
+        const int lightLimit = qBound(-1, src[j] - minDiff, 255);
+        const int darkLimit = qBound(0, src[j] + minDiff, 256);
+        dst[j] = ((light && twiceSum < (lightLimit * 2 + 1) * area)
+                  || (dark && twiceSum > (darkLimit * 2 - 1) * area)) ? 255 : 0;
+    }
+}
+
+// 列方向的滑动和加上一行(sign为1)或减去一行(sign为-1)
+static void updateColumnSums(int *columnSums, const uchar *row, const int width, const int sign)
+{
+    int j = 0;
+#if CV_SIMD
+    constexpr int INT_LANES = cv::v_int32::nlanes;
+    for (; j <= width - cv::v_uint8::nlanes; j += cv::v_uint8::nlanes) {
+        cv::v_uint16 r0, r1;
+        cv::v_expand(cv::vx_load(row + j), r0, r1);
+        cv::v_uint32 r00, r01, r10, r11;
+        cv::v_expand(r0, r00, r01);
+        cv::v_expand(r1, r10, r11);
+        const cv::v_int32 values[4] = {
+            cv::v_reinterpret_as_s32(r00), cv::v_reinterpret_as_s32(r01),
+            cv::v_reinterpret_as_s32(r10), cv::v_reinterpret_as_s32(r11),
+        };
+        for (int k = 0; k < 4; ++k) {
+            int *const sums = columnSums + j + INT_LANES * k;
+            const cv::v_int32 sum = cv::vx_load(sums);
+            cv::v_store(sums, sign > 0 ? sum + values[k] : sum - values[k]);
+        }
+    }
+#endif
+    for (; j < width; ++j) {
+        columnSums[j] += sign * row[j];
+    }
+}
+
+// 动态阈值每块至少这么多行. 每块开头要先累加kSize行, 块太小时这部分开销就不能忽略了
+constexpr int MIN_THRESHOLD_BAND_ROWS = 64;
+// 邻域和用int计算, 511 * kSize * kSize不能溢出
+constexpr int MAX_FUSED_THRESHOLD_KSIZE = 2047;
+
+// CV_8UC1的一次遍历动态阈值, 见VisionLibrary::threshold的说明
+static cv::Mat fusedThreshold(const cv::Mat &srcImage, const int kSize, const int minDiff,
+                       const VisionLibrary::ThresholdPolarity polarity)
+{
+    const int rows = srcImage.rows;
+    const int cols = srcImage.cols;
+    const int anchor = kSize / 2; // 同cv::blur的默认锚点
+    const int area = kSize * kSize;
+    // |f - g|不超过255, 截断之后结果不变
+    const int clampedMinDiff = qBound(-256, minDiff, 256);
+    cv::Mat dstImage(rows, cols, CV_8UC1);
+
+    // 行方向延拓之后的列号 -> 原图列号
+    std::vector<int> borderColumns(static_cast<size_t>(cols + kSize - 1));
+    for (int p = 0; p < cols + kSize - 1; ++p) {
+        borderColumns[p] = cv::borderInterpolate(p - anchor, cols, cv::BORDER_REFLECT_101);
+    }
+
+    const int bandRows = std::max(MIN_THRESHOLD_BAND_ROWS, kSize * 4);
+    const int bandCount = (rows + bandRows - 1) / bandRows;
+    cv::parallel_for_(cv::Range(0, bandCount), [&](const cv::Range &range) {
+        // 列方向的滑动和, 以及每个像素的邻域和. 每个线程一份, 各块复用
+        std::vector<int> columnSums(static_cast<size_t>(cols));
+        std::vector<int> boxSums(static_cast<size_t>(cols));
+        for (int band = range.start; band < range.end; ++band) {
+            const int firstRow = band * bandRows;
+            const int lastRow = std::min(rows, firstRow + bandRows);
+            // 块的第一行: 直接累加kSize行
+            std::fill(columnSums.begin(), columnSums.end(), 0);
+            for (int k = 0; k < kSize; ++k) {
+                const int row = cv::borderInterpolate(firstRow - anchor + k, rows, cv::BORDER_REFLECT_101);
+                updateColumnSums(columnSums.data(), srcImage.ptr<uchar>(row), cols, 1);
+            }
+            for (int i = firstRow; i < lastRow; ++i) {
+                if (i > firstRow) {
+                    // 窗口下移一行: 加上新进入的行, 减去移出的行
+                    const int entering = cv::borderInterpolate(i - anchor + kSize - 1, rows, cv::BORDER_REFLECT_101);
+                    const int leaving = cv::borderInterpolate(i - anchor - 1, rows, cv::BORDER_REFLECT_101);
+                    updateColumnSums(columnSums.data(), srcImage.ptr<uchar>(entering), cols, 1);
+                    updateColumnSums(columnSums.data(), srcImage.ptr<uchar>(leaving), cols, -1);
+                }
+                // 行方向滑动求邻域和
+                int sum = 0;
+                for (int p = 0; p < kSize; ++p) {
+                    sum += columnSums[borderColumns[p]];
+                }
+                boxSums[0] = sum;
+                for (int j = 1; j < cols; ++j) {
+                    sum += columnSums[borderColumns[j + kSize - 1]] - columnSums[borderColumns[j - 1]];
+                    boxSums[j] = sum;
+                }
+                compareRow(srcImage.ptr<uchar>(i), boxSums.data(), dstImage.ptr<uchar>(i), cols,
+                           area, clampedMinDiff, polarity);
+            }
+        }
+#if CV_SIMD
+        cv::vx_cleanup();
+#endif
+    }, bandCount);
+    return dstImage;
+}
+
+cv::Mat VisionLibrary::threshold(const cv::Mat &srcImage, const int kSize, const int minDiff,
+                                 const ThresholdPolarity polarity)
 {
+    if (srcImage.empty()) {
+        return cv::Mat();
+    }
+    // kSize为偶数时cv::blur的取整方式与实现有关(有的用定点数近似), 只能用cv::blur
+    if (CV_8UC1 == srcImage.type() && 1 == kSize % 2 && kSize <= MAX_FUSED_THRESHOLD_KSIZE) {
+        return fusedThreshold(srcImage, kSize, minDiff, polarity);
+    }
     cv::Mat background;
     // 用滤波估计背景
     cv::blur(srcImage, background, cv::Size(kSize, kSize));
-    return srcImage - background >= minDiff;
+    // 有符号的差, 暗于背景的像素不会被截断成0
+    cv::Mat diff;
+    cv::subtract(srcImage, background, diff, cv::noArray(), CV_32F);
+    switch (polarity) {
+    case ThresholdPolarity::Dark:
+        return diff <= -minDiff;
+    case ThresholdPolarity::Both:
+        return cv::abs(diff) >= minDiff;
+    default:
+        return diff >= minDiff;
+    }
 }
 
 cv::Mat VisionLibrary::otsuThreshold(const cv::Mat &srcImage)
@@ -97,6 +811,191 @@ std::vector<std::vector<cv::Point>> VisionLibrary::findSimpleExternalContours(co
     return contours;
 }
 
+void VisionLibrary::findSimpleExternalContours(const cv::Mat &srcImage, ContourSet &contours, const cv::Point &offset)
+{
+    // cv::findContours按需resize外层和每个轮廓的std::vector, 缓冲在contours里, 复用时已有的容量不再分配
+    std::vector<std::vector<cv::Point>> &buffer = contours._openCvContours;
+    cv::findContours(srcImage, buffer, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE, offset);
+    contours.assign(buffer);
+}
+
+// 分块提取轮廓时每块至少这么多行. 块越小, 跨接缝要重新提取的连通域越多
+constexpr int MIN_CONTOUR_BAND_ROWS = 256;
+// 查找完整轮廓所在区域的网格的边长
+constexpr int CONTOUR_REGION_GRID = 256;
+
+// 按行分块时的接缝
+struct ContourBands {
+    int bandRows;
+    int bandCount;
+
+    // 外接矩形为rect的连通域是否接触接缝: 跨块, 或者在块的第一行/最后一行(图像的上下边界除外)
+    bool touchesSeam(const cv::Rect &rect) const
+    {
+        const int first = rect.y / bandRows;
+        if ((rect.y + rect.height - 1) / bandRows != first) {
+            return true;
+        }
+        return (first > 0 && rect.y == first * bandRows)
+               || (first < bandCount - 1 && rect.y + rect.height == (first + 1) * bandRows);
+    }
+};
+
+// 把相交或相邻(包括对角相邻)的矩形合并成它们的外接矩形, 直到任意两个都不相邻
+static std::vector<cv::Rect> mergeTouchingRects(std::vector<cv::Rect> rects)
+{
+    bool merged = true;
+    while (merged) {
+        merged = false;
+        std::sort(rects.begin(), rects.end(), [](const cv::Rect &lhs, const cv::Rect &rhs) {
+            return lhs.x < rhs.x;
+        });
+        std::vector<cv::Rect> result;
+        std::vector<bool> absorbed(rects.size(), false);
+        for (size_t i = 0; i < rects.size(); ++i) {
+            if (absorbed[i]) {
+                continue;
+            }
+            cv::Rect current = rects[i];
+            // 按x排序, 左边界超过current右边一列的矩形不可能与它相邻
+            for (size_t j = i + 1; j < rects.size() && rects[j].x <= current.x + current.width; ++j) {
+                if (!absorbed[j] && rects[j].y <= current.y + current.height && current.y <= rects[j].y + rects[j].height) {
+                    current |= rects[j];
+                    absorbed[j] = true;
+                    merged = true;
+                }
+            }
+            result.push_back(current);
+        }
+        rects.swap(result);
+    }
+    return rects;
+}
+
+// 轮廓起点的键. 起点是连通域按行扫描的第一个像素, 不同的连通域起点不同
+static qint64 contourStartKey(const std::vector<cv::Point> &contour)
+{
+    return (qint64(contour.front().y) << 32) | quint32(contour.front().x);
+}
+
+std::vector<std::vector<cv::Point>> VisionLibrary::findSimpleExternalContoursParallel(const cv::Mat &srcImage, const cv::Point &offset,
+                                                                                      const int bandRows)
+{
+    const int rows = srcImage.rows;
+    const int rowsPerBand = bandRows > 0 ? bandRows
+                            : std::max(MIN_CONTOUR_BAND_ROWS, rows / std::max(1, cv::getNumThreads() * 2));
+    const ContourBands bands{rowsPerBand, (rows + rowsPerBand - 1) / rowsPerBand};
+    if (bands.bandCount <= 1) {
+        return findSimpleExternalContours(srcImage, offset);
+    }
+
+    // 1. 各块并行提取, 坐标都是整图的坐标, 最后再加offset
+    std::vector<std::vector<std::vector<cv::Point>>> bandContours(static_cast<size_t>(bands.bandCount));
+    cv::parallel_for_(cv::Range(0, bands.bandCount), [&](const cv::Range &range) {
+        for (int band = range.start; band < range.end; ++band) {
+            const int firstRow = band * rowsPerBand;
+            const int lastRow = std::min(rows, firstRow + rowsPerBand);
+            cv::findContours(srcImage.rowRange(firstRow, lastRow), bandContours[band], cv::RETR_EXTERNAL,
+                             cv::CHAIN_APPROX_SIMPLE, cv::Point(0, firstRow));
+        }
+    }, bands.bandCount);
+
+    // 2. 分出完整的轮廓和被接缝截断的轮廓
+    std::vector<std::vector<cv::Point>> contours;
+    std::vector<cv::Rect> completeRects;
+    std::vector<cv::Rect> cutRects;
+    for (std::vector<std::vector<cv::Point>> &band : bandContours) {
+        for (std::vector<cv::Point> &contour : band) {
+            const cv::Rect rect = cv::boundingRect(contour);
+            if (bands.touchesSeam(rect)) {
+                cutRects.push_back(rect);
+            } else {
+                contours.push_back(std::move(contour));
+                completeRects.push_back(rect);
+            }
+        }
+        std::vector<std::vector<cv::Point>>().swap(band);
+    }
+
+    if (!cutRects.empty()) {
+        // 3. 合并成互不相邻的区域, 在各区域内重新提取
+        const std::vector<cv::Rect> regions = mergeTouchingRects(std::move(cutRects));
+        std::vector<std::vector<std::vector<cv::Point>>> regionContours(regions.size());
+        cv::parallel_for_(cv::Range(0, int(regions.size())), [&](const cv::Range &range) {
+            for (int i = range.start; i < range.end; ++i) {
+                cv::findContours(srcImage(regions[i]), regionContours[i], cv::RETR_EXTERNAL,
+                                 cv::CHAIN_APPROX_SIMPLE, regions[i].tl());
+            }
+        });
+
+        // 4. 完整的轮廓在哪个区域内. 区域互不相交, 所以最多只有一个; 用网格找候选区域
+        const int gridCols = (srcImage.cols + CONTOUR_REGION_GRID - 1) / CONTOUR_REGION_GRID;
+        const int gridRows = (rows + CONTOUR_REGION_GRID - 1) / CONTOUR_REGION_GRID;
+        std::vector<std::vector<int>> grid(static_cast<size_t>(gridCols * gridRows));
+        for (size_t r = 0; r < regions.size(); ++r) {
+            for (int gy = regions[r].y / CONTOUR_REGION_GRID; gy <= (regions[r].br().y - 1) / CONTOUR_REGION_GRID; ++gy) {
+                for (int gx = regions[r].x / CONTOUR_REGION_GRID; gx <= (regions[r].br().x - 1) / CONTOUR_REGION_GRID; ++gx) {
+                    grid[gy * gridCols + gx].push_back(int(r));
+                }
+            }
+        }
+        std::vector<int> regionOf(contours.size(), -1);
+        std::unordered_map<qint64, size_t> startInRegion;
+        for (size_t i = 0; i < contours.size(); ++i) {
+            const cv::Rect &rect = completeRects[i];
+            for (const int r : grid[(rect.y / CONTOUR_REGION_GRID) * gridCols + rect.x / CONTOUR_REGION_GRID]) {
+                if ((regions[r] & rect) == rect) {
+                    regionOf[i] = r;
+                    startInRegion.emplace(contourStartKey(contours[i]), i);
+                    break;
+                }
+            }
+        }
+
+        // 5. 区域内重新提取的轮廓: 接触接缝的是跨接缝的连通域; 其他的如果是区域内的完整轮廓, 说明它确实是外轮廓
+        std::vector<bool> keep(contours.size());
+        for (size_t i = 0; i < contours.size(); ++i) {
+            keep[i] = regionOf[i] < 0;
+        }
+        std::vector<std::vector<cv::Point>> seamContours;
+        for (size_t r = 0; r < regions.size(); ++r) {
+            for (std::vector<cv::Point> &contour : regionContours[r]) {
+                if (bands.touchesSeam(cv::boundingRect(contour))) {
+                    seamContours.push_back(std::move(contour));
+                    continue;
+                }
+                // 否则是完整的轮廓, 或者被区域边界截断的其他连通域
+                const auto found = startInRegion.find(contourStartKey(contour));
+                if (found != startInRegion.end() && regionOf[found->second] == int(r)) {
+                    keep[found->second] = true;
+                }
+            }
+        }
+        // 去掉在跨接缝的连通域的洞里的轮廓
+        size_t kept = 0;
+        for (size_t i = 0; i < contours.size(); ++i) {
+            if (keep[i]) {
+                contours[kept++] = std::move(contours[i]);
+            }
+        }
+        contours.resize(kept);
+        std::move(seamContours.begin(), seamContours.end(), std::back_inserter(contours));
+    }
+
+    // cv::findContours的顺序: 起点按行扫描的逆序
+    std::sort(contours.begin(), contours.end(), [](const std::vector<cv::Point> &lhs, const std::vector<cv::Point> &rhs) {
+        return contourStartKey(lhs) > contourStartKey(rhs);
+    });
+    if (offset != POINT_ZEROS) {
+        for (std::vector<cv::Point> &contour : contours) {
+            for (cv::Point &point : contour) {
+                point += offset;
+            }
+        }
+    }
+    return contours;
+}
+
 void VisionLibrary::drawText(cv::Mat &srcImage, const cv::Point &center, const std::string &text, const int fontFace, const double fontScale, const int thickness,
                              const cv::Scalar &color)
 {
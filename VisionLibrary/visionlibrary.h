@@ -2,6 +2,7 @@
 
 #include <QImage>
 #include <opencv2/opencv.hpp>
+#include "VisionLibrary/contourset.h"
 
 namespace VisionLibrary {
 
@@ -35,16 +36,122 @@ const cv::Point2f POINT2F_MINUS_ONES(-1.0f, -1.0f);
  */
 QImage toPremultiImage(const cv::Mat &srcImage, const bool swapRG = true);
 
+/*!
+ * \brief toDisplayImage cv::Mat转换成用于显示的QImage, 格式允许时不拷贝像素
+ * \param srcImage
+ * \param swapRG 同toPremultiImage
+ * \param opaque 为true表示调用者保证CV_8UC4的alpha全为255(比如相机的BGRA帧), 直接零拷贝, 不再逐像素检查alpha.
+ * 检查alpha要读一遍整幅图像, 开销与拷贝相当, 所以在GUI线程中逐帧调用时应当由调用者声明
+ * \return
+ * \note
+ * 以下情况返回的QImage直接引用srcImage的内存(零拷贝), 并通过QImage的cleanupFunction持有srcImage的引用计数,
+ * 所以即使调用者释放了srcImage, 返回的QImage仍然有效:
+ * - CV_8UC1 -> QImage::Format_Grayscale8
+ * - CV_8UC3 -> QImage::Format_BGR888(swapRG)或QImage::Format_RGB888
+ * - CV_8UC4且opaque为true或alpha全为255 -> QImage::Format_RGB32(swapRG)或QImage::Format_RGBX8888
+ *
+ * 其余情况等同于toPremultiImage.
+ * 零拷贝的QImage与srcImage共享像素, 之后修改srcImage的像素会直接反映到QImage上;
+ * 返回的QImage是只读的, 对它调用bits()会先深拷贝
+ */
+QImage toDisplayImage(const cv::Mat &srcImage, const bool swapRG = true, const bool opaque = false);
+
+/*!
+ * \brief The DisplayMapping struct 显示映射(窗宽/窗位, 即对比度/亮度), 把原始值映射为显示的灰度
+ * \note 原始值v显示为255 * t^(1 / gamma), 其中t = (v - low) / (high - low)截断到[0, 1], low和high = level -/+ window / 2.
+ * window不大于0表示不映射, 按toPremultiImage中各类型的惯例显示
+ */
+struct DisplayMapping {
+    double window = 0.0; // 窗宽
+    double level = 0.0; // 窗位, 即窗的中心
+    double gamma = 1.0;
+
+    // 把[low, high]映射到[0, 255]
+    static DisplayMapping fromRange(const double low, const double high, const double gamma = 1.0)
+    {
+        return DisplayMapping{high - low, (low + high) * 0.5, gamma};
+    }
+    bool isIdentity() const
+    {
+        return window <= 0.0;
+    }
+    double low() const
+    {
+        return level - window * 0.5;
+    }
+    double high() const
+    {
+        return level + window * 0.5;
+    }
+    bool operator==(const DisplayMapping &other) const
+    {
+        return window == other.window && level == other.level && gamma == other.gamma;
+    }
+    bool operator!=(const DisplayMapping &other) const
+    {
+        return !(*this == other);
+    }
+};
+
+/*!
+ * \brief toPremultiImage 按显示映射转换成ARGB32预乘的QImage
+ * \param srcImage 支持8U/8S/16U/16S的1或3通道, 8U的4通道(alpha不参与映射), 32F/64F的单通道
+ * \param mapping 为恒等映射时等同于toPremultiImage(srcImage, swapRG)
+ * \param swapRG 同toPremultiImage
+ * \return
+ * \note 整数类型通过查找表转换(16位是64K项), 查找表按映射缓存, 所以对同一映射分块转换时只建一次表;
+ * 浮点类型在gamma为1时用SIMD做仿射变换
+ */
+QImage toPremultiImage(const cv::Mat &srcImage, const DisplayMapping &mapping, const bool swapRG = true);
+
+/*!
+ * \brief displayIntensity 原始值value在mapping下显示的灰度, 范围[0, 1], 与toPremultiImage的映射相同
+ * \param value
+ * \param depth 恒等映射时按这个类型的惯例显示范围. CV_32S按它的取值范围
+ * \param mapping
+ * \return 不支持的类型返回0
+ */
+double displayIntensity(const double value, const int depth, const DisplayMapping &mapping);
+
+// 同toDisplayImage, 但按mapping映射. 恒等映射时格式允许就零拷贝, 否则等同于toPremultiImage(srcImage, mapping, swapRG)
+QImage toDisplayImage(const cv::Mat &srcImage, const DisplayMapping &mapping, const bool swapRG = true);
+
+/*!
+ * \brief autoStretch 根据直方图自动拉伸: 去掉最暗和最亮的各saturation比例的像素, 其余的范围映射到[0, 255]
+ * \param srcImage 多通道时所有通道一起统计
+ * \param saturation 范围[0, 0.5)
+ * \return 图像为空时返回恒等映射
+ * \note 直方图分块并行统计. 整数类型每个值一个区间, 浮点类型在[最小值, 最大值]上均分4096个区间
+ */
+DisplayMapping autoStretch(const cv::Mat &srcImage, const double saturation = 0.005);
+
 QPixmap toQPixmap(const cv::Mat &srcImage);
 
+// 动态阈值选取的是比局部背景亮的像素, 暗的像素, 还是两者都要
+enum class ThresholdPolarity : int {
+    Light, // f - g >= minDiff
+    Dark, // g - f >= minDiff
+    Both, // |f - g| >= minDiff
+};
+
 /*!
  * \brief threshold 动态阈值二值化. 由于不均匀的光照或噪声太大, (直方图中不存在双峰), 无法找出一个对整幅图像都适用的固定阈值. 将图像与其局部背景进行比较的操作被称为动态阈值分割处理.
  * 1. 看图像与局部背景亮多少: S = {(r, c)^T \in R | f_{r, c} - g_{r, c} \ge g_{diff}}
+ * 2. 看图像与局部背景暗多少: S = {(r, c)^T \in R | g_{r, c} - f_{r, c} \ge g_{diff}}
  * \param srcImage
- * \return
+ * \param kSize 局部背景g是kSize x kSize邻域的均值, 边界按BORDER_REFLECT_101延拓(同cv::blur)
+ * \param minDiff 应大于0
+ * \param polarity
+ * \return 与srcImage同样大小的CV_8U掩膜, 选中的像素为255
  * \note 此方法比较适合字符的分割(因为字符笔划比较细)
+ *
+ * CV_8UC1且kSize为奇数时一次遍历完成: 按行分块并行, 每块维护一行列方向的滑动和(SIMD更新), 再沿行方向滑动求邻域和,
+ * 直接与(2 * (f - minDiff) + 1) * kSize * kSize这样的整数比较后写入掩膜, 不生成背景图, 也不做除法.
+ * 每个像素的代价与kSize无关. 比较的是取整之后的均值, 结果与cv::blur估计背景的做法(以及其他类型)完全相同.
+ * 其他类型和偶数的kSize用cv::blur估计背景
  */
-cv::Mat threshold(const cv::Mat &srcImage, const int kSize = 3, const int minDiff = 5);
+cv::Mat threshold(const cv::Mat &srcImage, const int kSize = 3, const int minDiff = 5,
+                  const ThresholdPolarity polarity = ThresholdPolarity::Light);
 
 /*!
  * \brief otsuThreshold 用大津法(OSTU)进行阈值分割
@@ -63,6 +170,34 @@ cv::Mat otsuThreshold(const cv::Mat &srcImage);
  */
 std::vector<std::vector<cv::Point>> findSimpleExternalContours(const cv::Mat &srcImage, const cv::Point &offset = POINT_ZEROS);
 
+/*!
+ * \brief findSimpleExternalContours 同上, 结果存入扁平的contours(先清空), 用于每帧都要提取轮廓的流程
+ * \param srcImage
+ * \param contours 跨帧复用, 稳定之后不再分配内存
+ * \param offset
+ * \note cv::findContours的输出放在contours自己的缓冲中, 其中每个轮廓的内存也被复用, 由contours.shrinkToFit()释放.
+ * 轮廓数变少时OpenCV会释放多出来的轮廓的内存, cv::findContours内部补边的拷贝也无法避免
+ */
+void findSimpleExternalContours(const cv::Mat &srcImage, ContourSet &contours, const cv::Point &offset = POINT_ZEROS);
+
+/*!
+ * \brief findSimpleExternalContoursParallel 分块并行的findSimpleExternalContours, 用于很大的掩膜
+ * \param srcImage 同findSimpleExternalContours
+ * \param offset 同findSimpleExternalContours
+ * \param bandRows 每块的行数. 不大于0时按OpenCV的线程数自动选择
+ * \return 与findSimpleExternalContours完全相同: 轮廓的个数, 顺序和每个轮廓的点都一样
+ * \note
+ * 1. 图像按行分成整行宽的块, 各块并行地cv::findContours;
+ * 2. 不接触接缝(块的第一行和最后一行, 图像的上下边界除外)的轮廓就是完整的连通域;
+ * 3. 接触接缝的轮廓是被截断的连通域, 把它们的外接矩形中相交或相邻的合并, 得到互不相邻的区域,
+ *    每个跨接缝的连通域都完整地落在一个区域内, 在各区域内(也并行)重新提取得到它们的完整轮廓;
+ * 4. 第2步的轮廓如果在某个区域内, 而区域内重新提取时没有它, 说明它在跨接缝的连通域的洞里, 不是外轮廓, 去掉;
+ * 5. 按cv::findContours的顺序(起点按行扫描的逆序)排序.
+ * 前景连成一大片时第3步的区域接近整图, 退化为单线程
+ */
+std::vector<std::vector<cv::Point>> findSimpleExternalContoursParallel(const cv::Mat &srcImage, const cv::Point &offset = POINT_ZEROS,
+                                                                       const int bandRows = 0);
+
 void drawText(cv::Mat &srcImage,
               const cv::Point &center,
               const std::string &text,
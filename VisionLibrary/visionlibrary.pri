@@ -0,0 +1,19 @@
+# VisionLibrary及其依赖(GlobalTools, OpenCV). GUI程序和命令行程序共用
+QT += gui concurrent
+
+INCLUDEPATH += $$PWD/..
+
+SOURCES += \
+    $$PWD/bufferpool.cpp \
+    $$PWD/contourset.cpp \
+    $$PWD/imagefile.cpp \
+    $$PWD/visionlibrary.cpp
+
+HEADERS += \
+    $$PWD/bufferpool.h \
+    $$PWD/contourset.h \
+    $$PWD/imagefile.h \
+    $$PWD/visionlibrary.h
+
+include($$PWD/../CommonLibrary/GlobalTools/globaltools.pri)
+include($$PWD/../opencv.pri)
@@ -6,6 +6,10 @@ MainWindow::MainWindow(QWidget *parent)
     , ui(new Ui::MainWindow)
 {
     ui->setupUi(this);
+    // 导入失败只在状态栏提示, 不弹出模态对话框
+    connect(ui->imageView, &ImageView1::signal_loadFailed, this, [this](const QString &path) {
+        statusBar()->showMessage(QStringLiteral("导入图片{%1}失败!").arg(path));
+    });
     const cv::Mat image = cv::imread("./cat.jpg");
     ui->imageView->setMat(image);
 }
@@ -0,0 +1,5 @@
+# 使用OpenCV 4.5.0 world
+OPENCV450_BUILD = G:/OpenSource/OpenCV/4_5_0/install/opencv/build
+win32:CONFIG(release, debug|release): LIBS += -L$$OPENCV450_BUILD/x64/vc15/lib/ -lopencv_world450
+else:win32:CONFIG(debug, debug|release): LIBS += -L$$OPENCV450_BUILD/x64/vc15/lib/ -lopencv_world450d
+INCLUDEPATH += $$OPENCV450_BUILD/include